@@ -0,0 +1,55 @@
+// ActualPhongInstanced.frag
+// Phong fragment shader with a material per instance - matched with ActualPhongInstanced.vert
+#version 330
+
+// Some drivers require the following
+precision highp float;
+
+layout(std140) uniform lightBlock
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 position;
+} light;
+
+struct materialStruct
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+};
+
+// size must match RT3D_MAX_INSTANCE_MATERIALS
+layout(std140) uniform materialArrayBlock
+{
+	materialStruct materials[16];
+};
+
+in vec3 ex_N;
+in vec3 ex_V;
+in vec3 ex_L;
+flat in uint ex_MaterialIndex;
+out vec4 out_Color;
+ 
+void main(void) {
+	materialStruct material = materials[ex_MaterialIndex];
+
+	// Ambient intensity
+	vec4 ambientI = light.ambient * material.ambient;
+
+	// Diffuse intensity
+	vec4 diffuseI = light.diffuse * material.diffuse;
+	diffuseI = diffuseI * max(dot(normalize(ex_N),normalize(ex_L)),0);
+
+	// Specular intensity
+	// Calculate R - reflection of light
+	vec3 R = normalize(reflect(normalize(-ex_L),normalize(ex_N)));
+
+	vec4 specularI = light.specular * material.specular;
+	specularI = specularI * pow(max(dot(R,ex_V),0), material.shininess);
+
+	// Fragment colour
+	out_Color = (ambientI + diffuseI + specularI);
+}
@@ -0,0 +1,51 @@
+// ActualPhongInstanced.vert
+// Instanced version of ActualPhong.vert, for use with rt3d::drawIndexedMeshInstanced
+// Each instance has its own model matrix and material index, matched with ActualPhongInstanced.frag
+#version 330
+
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
+layout(std140) uniform lightBlock
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 position;
+} light;
+
+uniform mat4 view;
+
+in  vec3 in_Position;
+in  vec3 in_Normal;
+in  mat4 in_ModelMatrix;
+in  uint in_MaterialIndex;
+out vec3 ex_N;
+out vec3 ex_V;
+out vec3 ex_L;
+flat out uint ex_MaterialIndex;
+
+void main(void) {
+	mat4 modelview = view * in_ModelMatrix;
+
+	// vertex into eye coordinates
+	vec4 vertexPosition = modelview * vec4(in_Position,1.0);
+
+	// Find V - in eye coordinates, eye is at (0,0,0)
+	ex_V = normalize(-vertexPosition).xyz;
+
+	// surface normal in eye coordinates
+	mat3 normalmatrix = transpose(inverse(mat3(modelview)));
+	ex_N = normalize(normalmatrix * in_Normal);
+
+	// L - to light source from vertex
+	ex_L = normalize(light.position.xyz - vertexPosition.xyz);
+
+	ex_MaterialIndex = in_MaterialIndex;
+
+    gl_Position = projection * vertexPosition;
+}
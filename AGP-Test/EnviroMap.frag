@@ -4,28 +4,27 @@
 // Some drivers require the following
 precision highp float;
 
-struct lightStruct
+layout(std140) uniform lightBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
-};
+	vec4 position;
+} light;
 
-struct materialStruct
+layout(std140) uniform materialBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
 	float shininess;
-};
+} material;
 
 in vec3 ex_WorldNorm;
 in vec3 ex_WorldView;
 uniform samplerCube cubeMap;
 uniform sampler2D texMap;
 
-uniform lightStruct light;
-uniform materialStruct material;
 uniform sampler2D textureUnit0;
 
 uniform float attConst;
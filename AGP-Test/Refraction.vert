@@ -1,14 +1,26 @@
 // Calculates and passes on V, L, N vectors for use in fragment shader, phong2.frag
 #version 330
 
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
+layout(std140) uniform lightBlock
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 position;
+} light;
+
 uniform mat4 modelMatrix;
-uniform vec3 cameraPos;
 out vec3 ex_WorldNorm;
 out vec3 ex_WorldView;
 
 uniform mat4 modelview;
-uniform mat4 projection;
-uniform vec4 lightPosition;
 //uniform mat3 normalmatrix;
 
 in  vec3 in_Position;
@@ -28,7 +40,7 @@ void main(void) {
 
 	// vertex into eye coordinates
 	vec4 vertexPosition = modelview * vec4(in_Position,1.0);
-	ex_D = distance(vertexPosition,lightPosition);
+	ex_D = distance(vertexPosition,light.position);
 	// Find V - in eye coordinates, eye is at (0,0,0)
 	ex_V = normalize(-vertexPosition).xyz;
 
@@ -41,7 +53,7 @@ void main(void) {
 	ex_N = normalize(normalmatrix * in_Normal);
 
 	// L - to light source from vertex
-	ex_L = normalize(lightPosition.xyz - vertexPosition.xyz);
+	ex_L = normalize(light.position.xyz - vertexPosition.xyz);
 
 	ex_TexCoord = in_TexCoord;
 
@@ -52,7 +64,7 @@ void main(void) {
 	mat3 normalworldmatrix=transpose(inverse(mat3(modelMatrix))); 
 	ex_WorldNorm = normalworldmatrix * in_Normal;
 
-	ex_WorldView = cameraPos - worldPos;
+	ex_WorldView = cameraPos.xyz - worldPos;
 
 
 }
@@ -2,8 +2,14 @@
 // Vertex shader for cubemap for e.g. sky box, with no lights
 #version 330
 
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
 uniform mat4 modelview;
-uniform mat4 projection;
 
 in  vec3 in_Position;
 smooth out vec3 cubeTexCoord;
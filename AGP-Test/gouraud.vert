@@ -4,26 +4,30 @@
 // default smooth shading interpolation on fragments
 #version 330
 
-struct lightStruct
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
+layout(std140) uniform lightBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
-};
+	vec4 position;
+} light;
 
-struct materialStruct
+layout(std140) uniform materialBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
 	float shininess;
-};
+} material;
 
 uniform mat4 modelview;
-uniform mat4 projection;
-uniform lightStruct light;
-uniform materialStruct material;
-uniform vec4 lightPosition;
 
 
 layout(location = 0) in vec3 in_Position;
@@ -53,7 +57,7 @@ void main(void) {
 	vec4 ambientI = light.ambient * material.ambient;
 
 	// L - to light source from vertex
-	vec3 L = normalize(lightPosition.xyz - vertexPosition.xyz);
+	vec3 L = normalize(light.position.xyz - vertexPosition.xyz);
 
 	// Diffuse intensity
 	vec4 diffuseI = light.diffuse * material.diffuse * max(dot(N,L),0);
@@ -1,635 +1,1774 @@
-// MD2 animation renderer
-// This demo will load and render an animated MD2 model, an OBJ model and a skybox
-// Most of the OpenGL code for dealing with buffer objects, etc has been moved to a 
-// utility library, to make creation and display of mesh objects as simple as possible
-
-
-// Windows specific: Uncomment the following line to open a console window for debug output
-#if _DEBUG
-#pragma comment(linker, "/subsystem:\"console\" /entry:\"WinMainCRTStartup\"")
-#endif
-
-#include "rt3d.h"
-#include "rt3dObjLoader.h"
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <stack>
-
-using namespace std;
-
-#define DEG_TO_RADIAN 0.017453293
-
-// Globals are being used (for now...)
-
-GLuint cubeIndexCount = 0;
-GLuint bunnyIndexCount = 0;
-GLuint meshObjects[3];
-
-// Rotates the Camera
-GLfloat r = 0.0f;
-
-// Vectors applied to camera
-glm::vec3 eye(-2.0f, 1.0f, 8.0f);
-glm::vec3 at(0.0f, 1.0f, -1.0f);
-glm::vec3 up(0.0f, 1.0f, 0.0f);
-
-// Shader programs (in the same order of the specification)
-
-// Gouraud
-GLuint gouraudProgram;
-
-// Phong
-GLuint actualPhongProgram;
-
-// Refraction
-GLuint refractionProgram;
-
-// Environment mapping (reflection)
-GLuint EnviroMapProgram;
-
-// Cartoon
-GLuint toonProgram;
-
-// Skybox
-GLuint skyboxProgram;
-
-GLuint textureProgram;
-GLuint shaderProgram;
-
-stack<glm::mat4> mvStack;
-
-GLuint uniformIndex;
-
-// TEXTURE STUFF
-GLuint textures[3];
-GLuint skybox[5];
-
-rt3d::lightStruct light0 = {
-	{ 0.4f, 0.4f, 0.4f, 1.0f }, // ambient
-	{ 1.0f, 1.0f, 1.0f, 1.0f }, // diffuse
-	{ 1.0f, 1.0f, 1.0f, 1.0f }, // specular
-	{ -5.0f, 2.0f, 2.0f, 1.0f }  // position
-};
-glm::vec4 lightPos(-5.0f, 2.0f, 2.0f, 1.0f); //light position
-
-rt3d::materialStruct material0 = {
-	{ 0.2f, 0.4f, 0.2f, 1.0f }, // ambient
-	{ 0.5f, 1.0f, 0.5f, 1.0f }, // diffuse
-	{ 0.0f, 0.1f, 0.0f, 1.0f }, // specular
-	2.0f  // shininess
-};
-rt3d::materialStruct material1 = {
-	{ 0.4f, 0.4f, 1.0f, 1.0f }, // ambient
-	{ 0.8f, 0.8f, 1.0f, 1.0f }, // diffuse
-	{ 0.8f, 0.8f, 0.8f, 1.0f }, // specular
-	1.0f  // shininess
-};
-
-// For cycling through the shaders
-int shaderController = 1;
-
-// Light attenuation (Taken from Lab4 base code)
-float attConstant = 1.0f;
-float attLinear = 0.0f;
-float attQuadratic = 0.0f;
-
-// Set up rendering context using SDL
-SDL_Window * setupRC(SDL_GLContext &context) {
-	SDL_Window * window;
-	if (SDL_Init(SDL_INIT_VIDEO) < 0) // Initialize video
-		rt3d::exitFatalError("Unable to initialize SDL");
-
-	// Request an OpenGL 3.0 context.
-
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);  // double buffering on
-	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8); // 8 bit alpha buffering
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4); // Turn on x4 multisampling anti-aliasing (MSAA)
-
-													   // Create 800x600 window
-	window = SDL_CreateWindow("SDL/GLM/OpenGL Demo", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-		800, 600, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
-	if (!window) // Check window was created OK
-		rt3d::exitFatalError("Unable to create window");
-
-	context = SDL_GL_CreateContext(window); // Create opengl context and attach to window
-	SDL_GL_SetSwapInterval(1); // set swap buffers to sync with monitor's vertical refresh rate
-	return window;
-}
-
-// A simple texture loading function to load from bitmap files
-
-GLuint loadBitmap(const char *fname) {
-	GLuint texID;
-	glGenTextures(1, &texID); // generate texture ID
-
-							  // load file - using core SDL library
-	SDL_Surface *tmpSurface;
-	tmpSurface = SDL_LoadBMP(fname);
-	if (!tmpSurface) {
-		std::cout << "Error loading bitmap" << std::endl;
-	}
-
-	// bind texture and set parameters
-	glBindTexture(GL_TEXTURE_2D, texID);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	SDL_PixelFormat *format = tmpSurface->format;
-
-	GLuint externalFormat, internalFormat;
-	if (format->Amask) {
-		internalFormat = GL_RGBA;
-		externalFormat = (format->Rmask < format->Bmask) ? GL_RGBA : GL_BGRA;
-	}
-	else {
-		internalFormat = GL_RGB;
-		externalFormat = (format->Rmask < format->Bmask) ? GL_RGB : GL_BGR;
-	}
-
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, tmpSurface->w, tmpSurface->h, 0,
-		externalFormat, GL_UNSIGNED_BYTE, tmpSurface->pixels);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	SDL_FreeSurface(tmpSurface); // texture loaded, free the temporary buffer
-	return texID;	// return value of texture ID
-}
-
-
-// A simple cubemap loading function
-GLuint loadCubeMap(const char *fname[6], GLuint *texID)
-{
-	glGenTextures(1, texID); // generate texture ID
-	GLenum sides[6] = { GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-		GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_X,
-		GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-		GL_TEXTURE_CUBE_MAP_NEGATIVE_Y };
-	SDL_Surface *tmpSurface;
-
-	glBindTexture(GL_TEXTURE_CUBE_MAP, *texID); // bind texture and set parameters
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	GLuint externalFormat;
-	for (int i = 0; i<6; i++)
-	{
-		// load file - using core SDL library
-		tmpSurface = SDL_LoadBMP(fname[i]);
-		if (!tmpSurface)
-		{
-			std::cout << "Error loading bitmap" << std::endl;
-			return *texID;
-		}
-
-		// skybox textures should not have alpha (assuming this is true!)
-		SDL_PixelFormat *format = tmpSurface->format;
-		externalFormat = (format->Rmask < format->Bmask) ? GL_RGB : GL_BGR;
-
-		glTexImage2D(sides[i], 0, GL_RGB, tmpSurface->w, tmpSurface->h, 0,
-			externalFormat, GL_UNSIGNED_BYTE, tmpSurface->pixels);
-		// texture loaded, free the temporary buffer
-		SDL_FreeSurface(tmpSurface);
-	}
-	return *texID;	// return value of texure ID, redundant really
-}
-
-
-void init(void) {
-
-	// Initialising shaders
-
-	// For Gouraud
-	gouraudProgram = rt3d::initShaders("gouraud.vert", "simple.frag");
-	rt3d::setLight(gouraudProgram, light0);
-	rt3d::setMaterial(gouraudProgram, material0);
-
-	// For Phong
-	actualPhongProgram = rt3d::initShaders("ActualPhong.vert", "ActualPhong.frag");
-	rt3d::setLight(actualPhongProgram, light0);
-	rt3d::setMaterial(actualPhongProgram, material0);
-
-	// For Refraction
-	refractionProgram = rt3d::initShaders("Refraction.vert", "Refraction.frag");
-	rt3d::setLight(shaderProgram, light0);
-	rt3d::setMaterial(shaderProgram, material0);
-
-	// set light attenuation shader uniforms
-	// Code below was taken from the Lab 4 base code during week 5
-
-	uniformIndex = glGetUniformLocation(refractionProgram, "attConst");
-	glUniform1f(uniformIndex, attConstant);
-	uniformIndex = glGetUniformLocation(refractionProgram, "attLinear");
-	glUniform1f(uniformIndex, attLinear);
-	uniformIndex = glGetUniformLocation(refractionProgram, "attQuadratic");
-	glUniform1f(uniformIndex, attQuadratic);
-
-
-	shaderProgram = rt3d::initShaders("EnviroMap.vert", "EnviroMap.frag");
-	rt3d::setLight(shaderProgram, light0);
-	rt3d::setMaterial(shaderProgram, material0);
-
-	// set light attenuation shader uniforms
-	// Code below was taken from the Lab 4 base code during week 5
-
-	uniformIndex = glGetUniformLocation(shaderProgram, "attConst");
-	glUniform1f(uniformIndex, attConstant);
-	uniformIndex = glGetUniformLocation(shaderProgram, "attLinear");
-	glUniform1f(uniformIndex, attLinear);
-	uniformIndex = glGetUniformLocation(shaderProgram, "attQuadratic");
-	glUniform1f(uniformIndex, attQuadratic);
-
-	// For Environment mapping (Reflection)
-	EnviroMapProgram = rt3d::initShaders("EnviroMap.vert", "EnviroMap.frag");
-	rt3d::setLight(EnviroMapProgram, light0);
-	rt3d::setMaterial(EnviroMapProgram, material0);
-
-	// set light attenuation shader uniforms
-	// Code below was taken from the Lab 4 base code during week 5
-
-	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attConst");
-	glUniform1f(uniformIndex, attConstant);
-	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attLinear");
-	glUniform1f(uniformIndex, attLinear);
-	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attQuadratic");
-	glUniform1f(uniformIndex, attQuadratic);
-	uniformIndex = glGetUniformLocation(EnviroMapProgram, "cameraPos");
-	glUniform3fv(uniformIndex, 1, glm::value_ptr(eye));
-
-	// For Cartoon (toon)
-	toonProgram = rt3d::initShaders("toon.vert", "toon.frag");
-	rt3d::setLight(toonProgram, light0);
-	rt3d::setMaterial(toonProgram, material0);
-
-	// set light attenuation shader uniforms
-	// Code below was taken from the Lab 4 base code during week 5
-
-	uniformIndex = glGetUniformLocation(toonProgram, "attConst");
-	glUniform1f(uniformIndex, attConstant);
-	uniformIndex = glGetUniformLocation(toonProgram, "attLinear");
-	glUniform1f(uniformIndex, attLinear);
-	uniformIndex = glGetUniformLocation(toonProgram, "attQuadratic");
-	glUniform1f(uniformIndex, attQuadratic);
-
-	textureProgram = rt3d::initShaders("textured.vert", "textured.frag");
-	
-	// Cube mape shaders/texture for skybox
-	skyboxProgram = rt3d::initShaders("cubeMap.vert", "cubeMap.frag");
-
-	// 6 BMPs for Skybox, one BMP for each face of the cube
-	// Again, taken from Lab 4 base code during week 5
-
-	const char *cubeTexFiles[6] =
-
-	{
-		"Town-skybox/Town_bk.bmp", "Town-skybox/Town_ft.bmp", "Town-skybox/Town_rt.bmp", "Town-skybox/Town_lf.bmp", "Town-skybox/Town_up.bmp", "Town-skybox/Town_dn.bmp"
-	};
-
-	loadCubeMap(cubeTexFiles, &skybox[0]);
-
-
-	vector<GLfloat> verts;
-	vector<GLfloat> norms;
-	vector<GLfloat> tex_coords;
-	vector<GLuint> indices;
-	rt3d::loadObj("cube.obj", verts, norms, tex_coords, indices);
-	cubeIndexCount = indices.size();
-	textures[0] = loadBitmap("fabric.bmp");
-	meshObjects[0] = rt3d::createMesh(verts.size() / 3, verts.data(), nullptr, norms.data(), tex_coords.data(), cubeIndexCount, indices.data());
-
-	textures[2] = loadBitmap("studdedmetal.bmp");
-
-
-	verts.clear(); norms.clear(); tex_coords.clear(); indices.clear();
-	rt3d::loadObj("bunny-5000.obj", verts, norms, tex_coords, indices);
-	bunnyIndexCount = indices.size();
-	meshObjects[2] = rt3d::createMesh(verts.size() / 3, verts.data(), nullptr, norms.data(), nullptr, bunnyIndexCount, indices.data());
-
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-}
-
-glm::vec3 moveForward(glm::vec3 pos, GLfloat angle, GLfloat d) {
-	return glm::vec3(pos.x + d * std::sin(r*DEG_TO_RADIAN), pos.y, pos.z - d * std::cos(r*DEG_TO_RADIAN));
-}
-
-glm::vec3 moveRight(glm::vec3 pos, GLfloat angle, GLfloat d) {
-	return glm::vec3(pos.x + d * std::cos(r*DEG_TO_RADIAN), pos.y, pos.z + d * std::sin(r*DEG_TO_RADIAN));
-}
-
-void update(void) {
-	const Uint8 *keys = SDL_GetKeyboardState(NULL);
-
-	// Controls for moving the camera:
-	// Back and Forth 
-	// Left and Right
-	// Up and Down
-
-	if (keys[SDL_SCANCODE_W]) eye = moveForward(eye, r, 0.1f);
-	if (keys[SDL_SCANCODE_S]) eye = moveForward(eye, r, -0.1f);
-	if (keys[SDL_SCANCODE_A]) eye = moveRight(eye, r, -0.1f);
-	if (keys[SDL_SCANCODE_D]) eye = moveRight(eye, r, 0.1f);
-	if (keys[SDL_SCANCODE_R]) eye.y += 0.1;
-	if (keys[SDL_SCANCODE_F]) eye.y -= 0.1;
-
-	// Controls for moving the light:
-	// Taken from the base code of Lab 4 during Week 5
-
-	if (keys[SDL_SCANCODE_I]) lightPos[2] -= 0.1;
-	if (keys[SDL_SCANCODE_J]) lightPos[0] -= 0.1;
-	if (keys[SDL_SCANCODE_K]) lightPos[2] += 0.1;
-	if (keys[SDL_SCANCODE_L]) lightPos[0] += 0.1;
-	if (keys[SDL_SCANCODE_U]) lightPos[1] += 0.1;
-	if (keys[SDL_SCANCODE_H]) lightPos[1] -= 0.1;
-
-	// Controls to cycle through the 5 shaders (In order of specification)
-
-	if (keys[SDL_SCANCODE_1]) shaderController = 1; // Gouraud Shader
-	if (keys[SDL_SCANCODE_2]) shaderController = 2; // Phong Shader
-	if (keys[SDL_SCANCODE_3]) shaderController = 3; // Refraction Map Shader
-	if (keys[SDL_SCANCODE_4]) shaderController = 4; // Environment Map Shader
-	if (keys[SDL_SCANCODE_5]) shaderController = 5; // Cartoon Shader
-
-}
-
-// Draw function for Gouraud shader
-
-void drawGouraud(glm::vec4 tmp, glm::mat4 projection)
-{
-
-	glUseProgram(gouraudProgram);
-
-	rt3d::setLightPos(gouraudProgram, glm::value_ptr(tmp));
-	rt3d::setUniformMatrix4fv(gouraudProgram, "projection", glm::value_ptr(projection));
-
-	//set modelview
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0, 20.0, 20.0));
-	rt3d::setUniformMatrix4fv(gouraudProgram, "modelview", glm::value_ptr(mvStack.top()));
-
-	// Method to apply shader
-	rt3d::setMaterial(gouraudProgram, material0);
-
-	// Method to draw object
-	rt3d::drawIndexedMesh(meshObjects[2], bunnyIndexCount, GL_TRIANGLES);
-	
-	mvStack.pop();
-}
-
-// Draw function for Phong shader
-
-void drawActPhong(glm::vec4 tmp, glm::mat4 projection)
-{
-
-	glUseProgram(actualPhongProgram);
-
-	// Function for setting light on the shader
-	rt3d::setLightPos(actualPhongProgram, glm::value_ptr(tmp));
-
-	// Function for setting projection matrices to the shader
-	rt3d::setUniformMatrix4fv(actualPhongProgram, "projection", glm::value_ptr(projection));
-
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0, 20.0, 20.0));
-	rt3d::setUniformMatrix4fv(actualPhongProgram, "modelview", glm::value_ptr(mvStack.top()));
-
-	// Method to apply shader
-	rt3d::setMaterial(actualPhongProgram, material0);
-
-	// Method to draw object
-	rt3d::drawIndexedMesh(meshObjects[2], bunnyIndexCount, GL_TRIANGLES);
-	
-	mvStack.pop();
-
-}
-
-// Draw function for Environment mapping (Reflection)
-
-void drawReflection(glm::vec4 tmp, glm::mat4 projection)
-{
-
-	glUseProgram(EnviroMapProgram);
-	rt3d::setUniformMatrix4fv(EnviroMapProgram, "projection", glm::value_ptr(projection));
-
-	// Function for setting light through the shader
-	rt3d::setLightPos(EnviroMapProgram, glm::value_ptr(tmp));
-
-	glBindTexture(GL_TEXTURE_2D, textures[2]);
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0f, 20.0f, 20.0f));
-	rt3d::setUniformMatrix4fv(EnviroMapProgram, "modelview", glm::value_ptr(mvStack.top()));
-	rt3d::setMaterial(EnviroMapProgram, material1);
-
-	glm::mat4 modelMatrix(1.0);
-	mvStack.push(mvStack.top());
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-2.0f, 1.0f, -3.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(20.0f, 20.0f, 20.0f));
-	mvStack.top() = mvStack.top() * modelMatrix;
-	
-	// Method to apply shader
-	rt3d::setUniformMatrix4fv(EnviroMapProgram, "modelMatrix", glm::value_ptr(mvStack.top()));
-
-	// Method to draw object
-	rt3d::drawIndexedMesh(meshObjects[2], bunnyIndexCount, GL_TRIANGLES);
-
-	mvStack.pop();
-	mvStack.pop();
-}
-
-// Draw function for Refraction
-
-void drawRefraction(glm::vec4 tmp, glm::mat4 projection)
-{
-
-	glUseProgram(refractionProgram);
-	rt3d::setUniformMatrix4fv(refractionProgram, "projection", glm::value_ptr(projection));
-
-	// Function for setting light through the shader
-	rt3d::setLightPos(refractionProgram, glm::value_ptr(tmp));
-
-	glBindTexture(GL_TEXTURE_2D, textures[2]);
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0f, 20.0f, 20.0f));
-	rt3d::setUniformMatrix4fv(refractionProgram, "modelview", glm::value_ptr(mvStack.top()));
-	rt3d::setMaterial(refractionProgram, material1);
-
-	glm::mat4 modelMatrix(1.0);
-	mvStack.push(mvStack.top());
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-2.0f, 1.0f, -3.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(20.0f, 20.0f, 20.0f));
-	mvStack.top() = mvStack.top() * modelMatrix;
-
-	// Method to apply shader
-	rt3d::setUniformMatrix4fv(refractionProgram, "modelMatrix", glm::value_ptr(mvStack.top()));
-
-	// Method to draw object
-	rt3d::drawIndexedMesh(meshObjects[2], bunnyIndexCount, GL_TRIANGLES);
-
-	mvStack.pop();
-	mvStack.pop();
-
-}
-
-// Draw function for Cartoon shading
-
-void drawCartoon(glm::vec4 tmp, glm::mat4 projection)
-{
-	
-	glUseProgram(toonProgram);
-
-	// Function for setting light through the shader
-	rt3d::setLightPos(toonProgram, glm::value_ptr(tmp));
-
-	// Function for setting projection matrices to the shader
-	rt3d::setUniformMatrix4fv(toonProgram, "projection", glm::value_ptr(projection));
-
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0, 20.0, 20.0));
-	rt3d::setUniformMatrix4fv(toonProgram, "modelview", glm::value_ptr(mvStack.top()));
-
-	// Method to apply shader
-	rt3d::setMaterial(toonProgram, material0);
-
-	// Method to draw object
-	rt3d::drawIndexedMesh(meshObjects[2], bunnyIndexCount, GL_TRIANGLES);
-
-	mvStack.pop();
-
-}
-
-void draw(SDL_Window * window) {
-	
-	// clear the screen
-	glEnable(GL_CULL_FACE);
-	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glm::mat4 projection(1.0);
-	projection = glm::perspective(float(60.0f*DEG_TO_RADIAN), 800.0f / 600.0f, 1.0f, 150.0f);
-
-	glm::mat4 modelview(1.0); // set base position for scene
-	mvStack.push(modelview);
-
-	at = moveForward(eye, r, 1.0f);
-	mvStack.top() = glm::lookAt(eye, at, up);
-
-	// We will be using the cube map for the skybox
-	glUseProgram(skyboxProgram);
-	rt3d::setUniformMatrix4fv(skyboxProgram, "projection", glm::value_ptr(projection));
-
-	glDepthMask(GL_FALSE); // make sure writing to update depth test is off
-	glm::mat3 mvRotOnlyMat3 = glm::mat3(mvStack.top());
-	mvStack.push(glm::mat4(mvRotOnlyMat3));
-
-	glCullFace(GL_FRONT); // drawing inside of cube!
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox[0]);
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(1.5f, 1.5f, 1.5f));
-	rt3d::setUniformMatrix4fv(skyboxProgram, "modelview", glm::value_ptr(mvStack.top()));
-	rt3d::drawIndexedMesh(meshObjects[0], cubeIndexCount, GL_TRIANGLES);
-	mvStack.pop();
-	glCullFace(GL_BACK); // We're drawing inside the cube
-
-	glDepthMask(GL_TRUE); // Make sure depth test is on
-
-	glUseProgram(shaderProgram);
-	rt3d::setUniformMatrix4fv(shaderProgram, "projection", glm::value_ptr(projection));
-
-	glm::vec4 tmp = mvStack.top()*lightPos;
-	light0.position[0] = tmp.x;
-	light0.position[1] = tmp.y;
-	light0.position[2] = tmp.z;
-	rt3d::setLightPos(shaderProgram, glm::value_ptr(tmp));
-
-	// Draws ground plane
-	glBindTexture(GL_TEXTURE_2D, textures[0]);
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-10.0f, -0.1f, -10.0f));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0f, 0.1f, 20.0f));
-	rt3d::setUniformMatrix4fv(shaderProgram, "modelview", glm::value_ptr(mvStack.top()));
-	rt3d::setMaterial(shaderProgram, material0);
-	rt3d::drawIndexedMesh(meshObjects[0], cubeIndexCount, GL_TRIANGLES);
-	mvStack.pop();
-
-	// This should draw the cube where the light is based
-	glBindTexture(GL_TEXTURE_2D, textures[0]);
-	mvStack.push(mvStack.top());
-	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(lightPos[0], lightPos[1], lightPos[2]));
-	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(0.25f, 0.25f, 0.25f));
-	rt3d::setUniformMatrix4fv(shaderProgram, "modelview", glm::value_ptr(mvStack.top()));
-	rt3d::setMaterial(shaderProgram, material0);
-	rt3d::drawIndexedMesh(meshObjects[0], cubeIndexCount, GL_TRIANGLES);
-	mvStack.pop();
-
-	// User input detection - For cycling through the five shaders:
-	// 1 = Gouraud
-	// 2 = Phong
-	// 3 = Refracted
-	// 4 = Environment mapping
-	// 5 = Car(toon)
-
-
-	if (shaderController == 1) drawGouraud(tmp, projection);
-	if (shaderController == 2) drawActPhong(tmp, projection);
-	if (shaderController == 3) drawRefraction(tmp, projection);
-	if (shaderController == 4) drawReflection(tmp, projection);
-	if (shaderController == 5) drawCartoon(tmp, projection);
-
-	mvStack.pop(); // initial matrix
-	glDepthMask(GL_TRUE);
-
-	SDL_GL_SwapWindow(window); // swap buffers
-
-}
-
-
-// Program entry point
-int main(int argc, char *argv[]) {
-	SDL_Window * hWindow; // window handle
-	SDL_GLContext glContext; // OpenGL context handle
-	hWindow = setupRC(glContext); // Create window and render context 
-
-								  // Required on Windows *only* init GLEW to access OpenGL beyond 1.1
-	glewExperimental = GL_TRUE;
-	GLenum err = glewInit();
-	if (GLEW_OK != err) { // glewInit failed, something is seriously wrong
-		std::cout << "glewInit failed, aborting." << endl;
-		exit(1);
-	}
-	cout << glGetString(GL_VERSION) << endl;
-
-	init();
-
-	bool running = true; // set running to true
-	SDL_Event sdlEvent;  // variable to detect SDL events
-	while (running) {	// the event loop
-		while (SDL_PollEvent(&sdlEvent)) {
-			if (sdlEvent.type == SDL_QUIT)
-				running = false;
-		}
-		update();
-		draw(hWindow); // call the draw function
-	}
-
-	SDL_GL_DeleteContext(glContext);
-	SDL_DestroyWindow(hWindow);
-	SDL_Quit();
-	return 0;
+// MD2 animation renderer
+// This demo will load and render an animated MD2 model, an OBJ model and a skybox
+// Most of the OpenGL code for dealing with buffer objects, etc has been moved to a 
+// utility library, to make creation and display of mesh objects as simple as possible
+
+
+// Windows specific: Uncomment the following line to open a console window for debug output
+#if _DEBUG
+#pragma comment(linker, "/subsystem:\"console\" /entry:\"WinMainCRTStartup\"")
+#endif
+
+#include "rt3d.h"
+#include "rt3dObjLoader.h"
+#include "rt3dMeshCache.h"
+#include "rt3dRenderQueue.h"
+#include "rt3dMeshPool.h"
+#include "rt3dJobs.h"
+#include "rt3dProfiler.h"
+#include "rt3dCulling.h"
+#include "rt3dBvh.h"
+#include "rt3dLod.h"
+#include "md2model.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <stack>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <algorithm>
+
+using namespace std;
+
+#define DEG_TO_RADIAN 0.017453293
+
+// Globals are being used (for now...)
+
+GLuint cubeIndexCount = 0;
+GLuint bunnyIndexCount = 0;
+GLuint meshObjects[3];
+// Maps the bunny's packed vertex positions back to model space
+glm::mat4 bunnyDecode(1.0);
+// ... and its bounds, in the packed space, for culling the crowd
+rt3d::meshBounds bunnyBounds;
+// The bunny's LOD levels, all in its index buffer. O toggles LOD selection, which picks the coarsest
+// level whose error stays under maxLodPixelError pixels on screen
+rt3d::lodChain bunnyLods;
+bool lod = true;
+GLfloat lodPixels = 1.0f;		// from lodPixelScale, for the current projection
+const GLfloat maxLodPixelError = 1.0f;
+
+// Rotates the Camera
+GLfloat r = 0.0f;
+
+// Vectors applied to camera
+glm::vec3 eye(-2.0f, 1.0f, 8.0f);
+glm::vec3 at(0.0f, 1.0f, -1.0f);
+glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+// Shader programs (in the same order of the specification)
+
+// Gouraud
+GLuint gouraudProgram;
+
+// Phong
+GLuint actualPhongProgram;
+
+// Refraction
+GLuint refractionProgram;
+
+// Environment mapping (reflection)
+GLuint EnviroMapProgram;
+
+// Cartoon
+GLuint toonProgram;
+
+// Skybox
+GLuint skyboxProgram;
+
+// Instanced crowd of bunnies (Phong and Cartoon)
+GLuint instancedPhongProgram;
+GLuint instancedToonProgram;
+
+GLuint textureProgram;
+GLuint shaderProgram;
+
+// Uniform locations for each program, looked up once after the programs are linked
+rt3d::programUniforms gouraudUniforms;
+rt3d::programUniforms actualPhongUniforms;
+rt3d::programUniforms refractionUniforms;
+rt3d::programUniforms EnviroMapUniforms;
+rt3d::programUniforms toonUniforms;
+rt3d::programUniforms skyboxUniforms;
+rt3d::programUniforms shaderUniforms;
+rt3d::programUniforms instancedPhongUniforms;
+rt3d::programUniforms instancedToonUniforms;
+
+stack<glm::mat4> mvStack;
+
+// Draws are recorded here during draw() and submitted sorted at the end of the frame
+rt3d::renderQueue renderQueue;
+rt3d::renderQueueStats queueStats;
+
+GLuint uniformIndex;
+
+// TEXTURE STUFF
+GLuint textures[3];
+GLuint skybox[5];
+
+rt3d::lightStruct light0 = {
+	{ 0.4f, 0.4f, 0.4f, 1.0f }, // ambient
+	{ 1.0f, 1.0f, 1.0f, 1.0f }, // diffuse
+	{ 1.0f, 1.0f, 1.0f, 1.0f }, // specular
+	{ -5.0f, 2.0f, 2.0f, 1.0f }  // position
+};
+glm::vec4 lightPos(-5.0f, 2.0f, 2.0f, 1.0f); //light position
+
+rt3d::materialStruct material0 = {
+	{ 0.2f, 0.4f, 0.2f, 1.0f }, // ambient
+	{ 0.5f, 1.0f, 0.5f, 1.0f }, // diffuse
+	{ 0.0f, 0.1f, 0.0f, 1.0f }, // specular
+	2.0f  // shininess
+};
+rt3d::materialStruct material1 = {
+	{ 0.4f, 0.4f, 1.0f, 1.0f }, // ambient
+	{ 0.8f, 0.8f, 1.0f, 1.0f }, // diffuse
+	{ 0.8f, 0.8f, 0.8f, 1.0f }, // specular
+	1.0f  // shininess
+};
+
+// For cycling through the shaders
+int shaderController = 1;
+
+// Crowd scene (shaders 6 and 7) - +/- change the size by a factor of 10
+GLuint crowdSize = 1000;
+vector<rt3d::instanceData> crowd;
+
+// Static field of cubes and bunnies (shader 8), all in one mesh pool and drawn with one call
+rt3d::meshPool staticPool;
+rt3d::poolMesh poolCube;
+rt3d::poolMesh poolBunny;
+vector<rt3d::poolMesh> fieldMeshes;
+vector<rt3d::instanceData> fieldData;
+vector<rt3d::poolMesh> visibleFieldMeshes;
+vector<rt3d::instanceData> visibleFieldData;
+
+// View frustum culling - C toggles it. The world space frustum is for things placed by model
+// matrices (the crowd and the static field), render queue items are culled in eye space
+bool culling = true;
+rt3d::frustum worldFrustum;
+
+// World space bounding volume hierarchies over the crowd and the static field, for culling them
+// and for picking - space picks the object in the middle of the view
+rt3d::bvh crowdTree;
+rt3d::bvh fieldTree;
+vector<GLuint> visibleObjects;
+
+// Light attenuation (Taken from Lab4 base code)
+float attConstant = 1.0f;
+float attLinear = 0.0f;
+float attQuadratic = 0.0f;
+
+// Headless benchmark (-headless) - renders offscreen with vsync off, along a scripted camera path
+bool headless = false;
+int windowWidth = 800;
+int windowHeight = 600;
+GLuint offscreenFramebuffer = 0;
+GLuint offscreenBuffers[2];	// colour and depth
+
+// Set up rendering context using SDL
+SDL_Window * setupRC(SDL_GLContext &context) {
+	SDL_Window * window;
+#ifndef _WIN32
+	// with no display to connect to, SDL's offscreen driver still gives a context (e.g. from Mesa llvmpipe)
+	if (headless && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+		setenv("SDL_VIDEODRIVER", "offscreen", 0);
+#endif
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) // Initialize video
+		rt3d::exitFatalError("Unable to initialize SDL");
+
+	// Request an OpenGL 3.0 context.
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);  // double buffering on
+	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8); // 8 bit alpha buffering
+	if (!headless) { // headless frames go to an offscreen framebuffer without MSAA instead
+		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4); // Turn on x4 multisampling anti-aliasing (MSAA)
+	}
+
+													   // Create 800x600 window (hidden when headless)
+	window = SDL_CreateWindow("SDL/GLM/OpenGL Demo", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+		windowWidth, windowHeight, SDL_WINDOW_OPENGL | (headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
+	if (!window) // Check window was created OK
+		rt3d::exitFatalError("Unable to create window");
+
+	context = SDL_GL_CreateContext(window); // Create opengl context and attach to window
+	if (!context)
+		rt3d::exitFatalError("Unable to create OpenGL context");
+	// sync swap buffers with monitor's vertical refresh rate - except when benchmarking
+	SDL_GL_SetSwapInterval(headless ? 0 : 1);
+	return window;
+}
+
+// Headless frames are drawn into a framebuffer object instead of the hidden window, so they
+// can be any size and read back the same way on every driver
+void createOffscreenTarget(void) {
+	glGenRenderbuffers(2, offscreenBuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenBuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenBuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+
+	glGenFramebuffers(1, &offscreenFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);	// left bound for the whole run
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenBuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenBuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		rt3d::exitFatalError("Unable to create offscreen framebuffer");
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void deleteOffscreenTarget(void) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &offscreenFramebuffer);
+	glDeleteRenderbuffers(2, offscreenBuffers);
+}
+
+// A simple texture loading function to load from bitmap files
+
+GLuint loadBitmap(const char *fname) {
+	RT3D_PROFILE("loadBitmap");
+	GLuint texID;
+	glGenTextures(1, &texID); // generate texture ID
+
+							  // load file - using core SDL library
+	SDL_Surface *tmpSurface;
+	tmpSurface = SDL_LoadBMP(fname);
+	if (!tmpSurface) {
+		std::cout << "Error loading bitmap" << std::endl;
+	}
+
+	// bind texture and set parameters
+	rt3d::bindTexture(0, GL_TEXTURE_2D, texID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	SDL_PixelFormat *format = tmpSurface->format;
+
+	GLuint externalFormat, internalFormat;
+	if (format->Amask) {
+		internalFormat = GL_RGBA;
+		externalFormat = (format->Rmask < format->Bmask) ? GL_RGBA : GL_BGRA;
+	}
+	else {
+		internalFormat = GL_RGB;
+		externalFormat = (format->Rmask < format->Bmask) ? GL_RGB : GL_BGR;
+	}
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, tmpSurface->w, tmpSurface->h, 0,
+		externalFormat, GL_UNSIGNED_BYTE, tmpSurface->pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	SDL_FreeSurface(tmpSurface); // texture loaded, free the temporary buffer
+	return texID;	// return value of texture ID
+}
+
+
+// A simple cubemap loading function
+GLuint loadCubeMap(const char *fname[6], GLuint *texID)
+{
+	RT3D_PROFILE("loadCubeMap");
+	glGenTextures(1, texID); // generate texture ID
+	GLenum sides[6] = { GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
+		GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
+		GL_TEXTURE_CUBE_MAP_POSITIVE_X,
+		GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
+		GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
+		GL_TEXTURE_CUBE_MAP_NEGATIVE_Y };
+	SDL_Surface *tmpSurface;
+
+	rt3d::bindTexture(0, GL_TEXTURE_CUBE_MAP, *texID); // bind texture and set parameters
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	GLuint externalFormat;
+	for (int i = 0; i<6; i++)
+	{
+		// load file - using core SDL library
+		tmpSurface = SDL_LoadBMP(fname[i]);
+		if (!tmpSurface)
+		{
+			std::cout << "Error loading bitmap" << std::endl;
+			return *texID;
+		}
+
+		// skybox textures should not have alpha (assuming this is true!)
+		SDL_PixelFormat *format = tmpSurface->format;
+		externalFormat = (format->Rmask < format->Bmask) ? GL_RGB : GL_BGR;
+
+		glTexImage2D(sides[i], 0, GL_RGB, tmpSurface->w, tmpSurface->h, 0,
+			externalFormat, GL_UNSIGNED_BYTE, tmpSurface->pixels);
+		// texture loaded, free the temporary buffer
+		SDL_FreeSurface(tmpSurface);
+	}
+	return *texID;	// return value of texure ID, redundant really
+}
+
+// Loads an OBJ through the mesh cache, and gives up if it is missing or has no faces
+void loadObjOrExit(const char *fname, rt3d::objMesh &mesh, const bool packed) {
+	if (!rt3d::loadObjCached(fname, mesh, packed)) {
+		string message = string("Unable to load mesh ") + fname;
+		rt3d::exitFatalError(message.c_str());
+	}
+}
+
+void init(void) {
+	RT3D_PROFILE("init");
+
+	// Initialising shaders
+
+	// For Gouraud
+	gouraudProgram = rt3d::initShaders("gouraud.vert", "simple.frag");
+
+	// For Phong
+	actualPhongProgram = rt3d::initShaders("ActualPhong.vert", "ActualPhong.frag");
+
+	// For Refraction
+	refractionProgram = rt3d::initShaders("Refraction.vert", "Refraction.frag");
+
+	// set light attenuation shader uniforms
+	// Code below was taken from the Lab 4 base code during week 5
+
+	uniformIndex = glGetUniformLocation(refractionProgram, "attConst");
+	glUniform1f(uniformIndex, attConstant);
+	uniformIndex = glGetUniformLocation(refractionProgram, "attLinear");
+	glUniform1f(uniformIndex, attLinear);
+	uniformIndex = glGetUniformLocation(refractionProgram, "attQuadratic");
+	glUniform1f(uniformIndex, attQuadratic);
+
+
+	shaderProgram = rt3d::initShaders("EnviroMap.vert", "EnviroMap.frag");
+
+	// set light attenuation shader uniforms
+	// Code below was taken from the Lab 4 base code during week 5
+
+	uniformIndex = glGetUniformLocation(shaderProgram, "attConst");
+	glUniform1f(uniformIndex, attConstant);
+	uniformIndex = glGetUniformLocation(shaderProgram, "attLinear");
+	glUniform1f(uniformIndex, attLinear);
+	uniformIndex = glGetUniformLocation(shaderProgram, "attQuadratic");
+	glUniform1f(uniformIndex, attQuadratic);
+
+	// For Environment mapping (Reflection)
+	EnviroMapProgram = rt3d::initShaders("EnviroMap.vert", "EnviroMap.frag");
+
+	// set light attenuation shader uniforms
+	// Code below was taken from the Lab 4 base code during week 5
+
+	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attConst");
+	glUniform1f(uniformIndex, attConstant);
+	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attLinear");
+	glUniform1f(uniformIndex, attLinear);
+	uniformIndex = glGetUniformLocation(EnviroMapProgram, "attQuadratic");
+	glUniform1f(uniformIndex, attQuadratic);
+
+	// For Cartoon (toon)
+	toonProgram = rt3d::initShaders("toon.vert", "toon.frag");
+
+	// set light attenuation shader uniforms
+	// Code below was taken from the Lab 4 base code during week 5
+
+	uniformIndex = glGetUniformLocation(toonProgram, "attConst");
+	glUniform1f(uniformIndex, attConstant);
+	uniformIndex = glGetUniformLocation(toonProgram, "attLinear");
+	glUniform1f(uniformIndex, attLinear);
+	uniformIndex = glGetUniformLocation(toonProgram, "attQuadratic");
+	glUniform1f(uniformIndex, attQuadratic);
+
+	textureProgram = rt3d::initShaders("textured.vert", "textured.frag");
+	
+	// Cube mape shaders/texture for skybox
+	skyboxProgram = rt3d::initShaders("cubeMap.vert", "cubeMap.frag");
+
+	// Instanced shaders for the crowd scene
+	instancedPhongProgram = rt3d::initShaders("ActualPhongInstanced.vert", "ActualPhongInstanced.frag");
+	instancedToonProgram = rt3d::initShaders("toonInstanced.vert", "toonInstanced.frag");
+	uniformIndex = glGetUniformLocation(instancedToonProgram, "attConst");
+	glUniform1f(uniformIndex, attConstant);
+	uniformIndex = glGetUniformLocation(instancedToonProgram, "attLinear");
+	glUniform1f(uniformIndex, attLinear);
+	uniformIndex = glGetUniformLocation(instancedToonProgram, "attQuadratic");
+	glUniform1f(uniformIndex, attQuadratic);
+
+	gouraudUniforms = rt3d::getProgramUniforms(gouraudProgram);
+	actualPhongUniforms = rt3d::getProgramUniforms(actualPhongProgram);
+	refractionUniforms = rt3d::getProgramUniforms(refractionProgram);
+	EnviroMapUniforms = rt3d::getProgramUniforms(EnviroMapProgram);
+	toonUniforms = rt3d::getProgramUniforms(toonProgram);
+	skyboxUniforms = rt3d::getProgramUniforms(skyboxProgram);
+	shaderUniforms = rt3d::getProgramUniforms(shaderProgram);
+	instancedPhongUniforms = rt3d::getProgramUniforms(instancedPhongProgram);
+	instancedToonUniforms = rt3d::getProgramUniforms(instancedToonProgram);
+
+	// light and material are shared by all the programs through uniform blocks
+	rt3d::setLightBlock(light0);
+	rt3d::setMaterialBlock(material0);
+	rt3d::materialStruct crowdMaterials[2] = { material0, material1 };
+	rt3d::setMaterialArrayBlock(crowdMaterials, 2);
+
+	// 6 BMPs for Skybox, one BMP for each face of the cube
+	// Again, taken from Lab 4 base code during week 5
+
+	const char *cubeTexFiles[6] =
+
+	{
+		"Town-skybox/Town_bk.bmp", "Town-skybox/Town_ft.bmp", "Town-skybox/Town_rt.bmp", "Town-skybox/Town_lf.bmp", "Town-skybox/Town_up.bmp", "Town-skybox/Town_dn.bmp"
+	};
+
+	loadCubeMap(cubeTexFiles, &skybox[0]);
+
+
+	// Meshes are loaded through the binary mesh cache, so after the first run the OBJ files are
+	// not parsed at all - the interleaved mesh data is uploaded straight from the memory mapped cache file
+	rt3d::objMesh mesh;
+	loadObjOrExit("cube.obj", mesh, false);
+	cubeIndexCount = mesh.indexCount;
+	textures[0] = loadBitmap("fabric.bmp");
+	meshObjects[0] = rt3d::createInterleavedMesh(mesh.numVerts, mesh.vertexData, mesh.format, cubeIndexCount, mesh.indices, mesh.indexType);
+	rt3d::freeObjMesh(mesh);
+
+	textures[2] = loadBitmap("studdedmetal.bmp");
+
+
+	// The bunny is stored packed (16 bit positions, 10_10_10_2 normals, 16 bit indices) - the
+	// position decode is folded into its modelview with bunnyDecode when it is drawn
+	loadObjOrExit("bunny-5000.obj", mesh, true);
+	bunnyIndexCount = mesh.indexCount;
+	bunnyLods = mesh.lods;
+	meshObjects[2] = rt3d::createInterleavedMesh(mesh.numVerts, mesh.vertexData, mesh.format, mesh.lodIndexCount, mesh.indices, mesh.indexType);
+	bunnyDecode = glm::translate(glm::mat4(1.0), glm::vec3(mesh.positionBias[0], mesh.positionBias[1], mesh.positionBias[2]));
+	bunnyDecode = glm::scale(bunnyDecode, glm::vec3(mesh.positionScale[0], mesh.positionScale[1], mesh.positionScale[2]));
+	rt3d::getMeshBounds(meshObjects[2], bunnyBounds);
+	rt3d::freeObjMesh(mesh);
+
+	// The static field shares one vertex and index buffer, in plain float position and normal format
+	rt3d::createMeshPool(staticPool, rt3d::makeVertexFormat(false, true, false), 65536, 262144);
+	loadObjOrExit("cube.obj", mesh, false);
+	if (!rt3d::addPoolMesh(staticPool, mesh.numVerts, mesh.vertexData, mesh.format, mesh.indexCount, mesh.indices, mesh.indexType, poolCube))
+		rt3d::exitFatalError("Unable to add cube.obj to the mesh pool");
+	rt3d::freeObjMesh(mesh);
+	loadObjOrExit("bunny-5000.obj", mesh, false);
+	if (!rt3d::addPoolMesh(staticPool, mesh.numVerts, mesh.vertexData, mesh.format, mesh.indexCount, mesh.indices, mesh.indexType, poolBunny))
+		rt3d::exitFatalError("Unable to add bunny-5000.obj to the mesh pool");
+	rt3d::freeObjMesh(mesh);
+
+	rt3d::setEnabled(GL_DEPTH_TEST, true);
+	rt3d::setEnabled(GL_BLEND, true);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+}
+
+glm::vec3 moveForward(glm::vec3 pos, GLfloat angle, GLfloat d) {
+	return glm::vec3(pos.x + d * std::sin(r*DEG_TO_RADIAN), pos.y, pos.z - d * std::cos(r*DEG_TO_RADIAN));
+}
+
+glm::vec3 moveRight(glm::vec3 pos, GLfloat angle, GLfloat d) {
+	return glm::vec3(pos.x + d * std::cos(r*DEG_TO_RADIAN), pos.y, pos.z + d * std::sin(r*DEG_TO_RADIAN));
+}
+
+// Casts a ray from the camera along the view direction through the crowd or the static field,
+// whichever is showing, and prints the nearest object whose box it hits
+void pickObject(void) {
+	const rt3d::bvh *tree = nullptr;
+	const char *name = nullptr;
+	if ((shaderController == 6 || shaderController == 7) && !crowdTree.nodes.empty()) {
+		tree = &crowdTree;
+		name = "crowd member";
+	}
+	if (shaderController == 8 && !fieldTree.nodes.empty()) {
+		tree = &fieldTree;
+		name = "field object";
+	}
+	if (!tree) {
+		cout << "nothing to pick in this scene" << endl;
+		return;
+	}
+	glm::vec3 direction = moveForward(eye, r, 1.0f) - eye;
+	GLfloat distance;
+	GLuint object = rt3d::raycastBvh(*tree, glm::value_ptr(eye), glm::value_ptr(direction), 150.0f, distance);
+	if (object == RT3D_BVH_NONE)
+		cout << "nothing picked" << endl;
+	else
+		cout << "picked " << name << " " << object << " at distance " << distance << endl;
+}
+
+void update(void) {
+	RT3D_PROFILE("update");
+	const Uint8 *keys = SDL_GetKeyboardState(NULL);
+
+	// Controls for moving the camera:
+	// Back and Forth 
+	// Left and Right
+	// Up and Down
+
+	if (keys[SDL_SCANCODE_W]) eye = moveForward(eye, r, 0.1f);
+	if (keys[SDL_SCANCODE_S]) eye = moveForward(eye, r, -0.1f);
+	if (keys[SDL_SCANCODE_A]) eye = moveRight(eye, r, -0.1f);
+	if (keys[SDL_SCANCODE_D]) eye = moveRight(eye, r, 0.1f);
+	if (keys[SDL_SCANCODE_R]) eye.y += 0.1;
+	if (keys[SDL_SCANCODE_F]) eye.y -= 0.1;
+
+	// Controls for moving the light:
+	// Taken from the base code of Lab 4 during Week 5
+
+	if (keys[SDL_SCANCODE_I]) lightPos[2] -= 0.1;
+	if (keys[SDL_SCANCODE_J]) lightPos[0] -= 0.1;
+	if (keys[SDL_SCANCODE_K]) lightPos[2] += 0.1;
+	if (keys[SDL_SCANCODE_L]) lightPos[0] += 0.1;
+	if (keys[SDL_SCANCODE_U]) lightPos[1] += 0.1;
+	if (keys[SDL_SCANCODE_H]) lightPos[1] -= 0.1;
+
+	// Controls to cycle through the 5 shaders (In order of specification)
+
+	if (keys[SDL_SCANCODE_1]) shaderController = 1; // Gouraud Shader
+	if (keys[SDL_SCANCODE_2]) shaderController = 2; // Phong Shader
+	if (keys[SDL_SCANCODE_3]) shaderController = 3; // Refraction Map Shader
+	if (keys[SDL_SCANCODE_4]) shaderController = 4; // Environment Map Shader
+	if (keys[SDL_SCANCODE_5]) shaderController = 5; // Cartoon Shader
+	if (keys[SDL_SCANCODE_6]) shaderController = 6; // Instanced crowd, Phong Shader
+	if (keys[SDL_SCANCODE_7]) shaderController = 7; // Instanced crowd, Cartoon Shader
+	if (keys[SDL_SCANCODE_8]) shaderController = 8; // Static field from the mesh pool
+
+	// Picks once per press of space, not every frame it is held
+	static bool picking = false;
+	if (keys[SDL_SCANCODE_SPACE] && !picking) pickObject();
+	picking = keys[SDL_SCANCODE_SPACE] != 0;
+
+}
+
+// Replaces update() in the headless benchmark - the camera weaves across the scene and
+// turns from side to side, one full loop over the run, so every run sees the same frames
+void scriptCamera(GLuint frame, GLuint frames)
+{
+	RT3D_PROFILE("update");
+	double t = 6.283185307 * frame / frames;
+	eye = glm::vec3(-2.0f + 4.0f * (float) sin(t), 1.0f + 0.5f * (float) sin(2.0 * t), 8.0f - 2.0f * (float) sin(2.0 * t));
+	r = 30.0f * (float) sin(t);
+}
+
+// Fills in a draw item for an indexed mesh - texture, material and model matrix are left unset
+rt3d::drawItem makeDrawItem(GLuint pass, GLuint program, const rt3d::programUniforms &uniforms, GLuint mesh,
+	GLuint indexCount, const glm::mat4 &modelview) {
+	rt3d::drawItem item;
+	memset(&item, 0, sizeof(item));
+	item.pass = pass;
+	item.program = program;
+	item.modelviewLocation = uniforms.modelview;
+	item.modelMatrixLocation = -1;
+	item.mesh = mesh;
+	item.count = indexCount;
+	item.indexed = true;
+	item.primitive = GL_TRIANGLES;
+	memcpy(item.modelview, glm::value_ptr(modelview), sizeof(item.modelview));
+	return item;
+}
+
+// LOD level for a bunny drawn with matrix - its model matrix times bunnyDecode, taking it to the
+// space camera is in. The level errors are in the bunny's model space, before bunnyDecode
+GLuint selectBunnyLod(const glm::mat4 &matrix, const glm::vec3 &camera)
+{
+	if (!lod)
+		return 0;
+	glm::vec3 centre(matrix * glm::vec4(bunnyBounds.centre[0], bunnyBounds.centre[1], bunnyBounds.centre[2], 1.0f));
+	GLfloat scale = glm::length(glm::vec3(matrix[0]));
+	// the nearest the bunny's bounding sphere comes to the camera, but never nearer than the near plane
+	GLfloat distance = max(glm::length(centre - camera) - bunnyBounds.radius * scale, 1.0f);
+	return rt3d::selectLod(bunnyLods, distance, scale / bunnyDecode[0][0], lodPixels, maxLodPixelError);
+}
+
+// Sets a bunny draw item's indices to one LOD level
+void setBunnyLod(rt3d::drawItem &item)
+{
+	const rt3d::lodLevel &level = bunnyLods.levels[selectBunnyLod(glm::make_mat4(item.modelview), glm::vec3(0.0f))];
+	item.firstIndex = level.firstIndex;
+	item.count = level.indexCount;
+}
+
+// Bunny draw functions - each queues the bunny with one of the five shaders
+
+void queueBunny(GLuint program, const rt3d::programUniforms &uniforms, const rt3d::materialStruct &material)
+{
+	mvStack.push(mvStack.top());
+	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
+	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0, 20.0, 20.0));
+	rt3d::drawItem item = makeDrawItem(RT3D_PASS_OPAQUE, program, uniforms, meshObjects[2], bunnyIndexCount,
+		mvStack.top() * bunnyDecode);
+	setBunnyLod(item);
+
+	// Method to apply shader
+	item.hasMaterial = true;
+	item.material = material;
+
+	rt3d::queueDrawItem(renderQueue, item);
+	mvStack.pop();
+}
+
+// Environment mapped bunnies also need their world space model matrix, and the bunny texture
+void queueMappedBunny(GLuint program, const rt3d::programUniforms &uniforms, const rt3d::materialStruct &material)
+{
+	mvStack.push(mvStack.top());
+	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-2.0f, 1.0f, -3.0f));
+	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0f, 20.0f, 20.0f));
+	rt3d::drawItem item = makeDrawItem(RT3D_PASS_OPAQUE, program, uniforms, meshObjects[2], bunnyIndexCount,
+		mvStack.top() * bunnyDecode);
+	setBunnyLod(item);
+	item.textureTarget = GL_TEXTURE_2D;
+	item.texture = textures[2];
+	item.hasMaterial = true;
+	item.material = material;
+
+	glm::mat4 modelMatrix(1.0);
+	mvStack.push(mvStack.top());
+	modelMatrix = glm::translate(modelMatrix, glm::vec3(-2.0f, 1.0f, -3.0f));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(20.0f, 20.0f, 20.0f));
+	mvStack.top() = mvStack.top() * modelMatrix;
+	
+	// Method to apply shader
+	item.modelMatrixLocation = uniforms.modelMatrix;
+	memcpy(item.modelMatrix, glm::value_ptr(mvStack.top() * bunnyDecode), sizeof(item.modelMatrix));
+
+	rt3d::queueDrawItem(renderQueue, item);
+
+	mvStack.pop();
+	mvStack.pop();
+}
+
+// Draw function for Gouraud shader
+void drawGouraud(void)
+{
+	RT3D_PROFILE("drawGouraud");
+	queueBunny(gouraudProgram, gouraudUniforms, material0);
+}
+
+// Draw function for Phong shader
+void drawActPhong(void)
+{
+	RT3D_PROFILE("drawActPhong");
+	queueBunny(actualPhongProgram, actualPhongUniforms, material0);
+}
+
+// Draw function for Environment mapping (Reflection)
+void drawReflection(void)
+{
+	RT3D_PROFILE("drawReflection");
+	queueMappedBunny(EnviroMapProgram, EnviroMapUniforms, material1);
+}
+
+// Draw function for Refraction
+void drawRefraction(void)
+{
+	RT3D_PROFILE("drawRefraction");
+	queueMappedBunny(refractionProgram, refractionUniforms, material1);
+}
+
+// Draw function for Cartoon shading
+void drawCartoon(void)
+{
+	RT3D_PROFILE("drawCartoon");
+	queueBunny(toonProgram, toonUniforms, material0);
+}
+
+// Lays out crowd members begin to end - 1 of data - a job, so each one only writes its own members
+void buildCrowdJob(void *data, const GLuint begin, const GLuint end)
+{
+	rt3d::instanceData *members = (rt3d::instanceData *) data;
+	GLuint side = (GLuint) ceil(sqrt((double) crowdSize));
+	for (GLuint i = begin; i < end; i++) {
+		glm::mat4 model(1.0);
+		model = glm::translate(model, glm::vec3(-2.0f + 2.0f * ((int) (i % side) - (int) side / 2), 1.0f, -3.0f - 2.0f * (i / side)));
+		model = glm::scale(model, glm::vec3(20.0f, 20.0f, 20.0f));
+		memcpy(members[i].modelMatrix, glm::value_ptr(model * bunnyDecode), sizeof(members[i].modelMatrix));
+		members[i].materialIndex = i % 2;
+	}
+}
+
+// Lays the crowd out on a square grid behind the bunny, alternating the two materials,
+// spread over the job system - and waits for it all before the crowd is drawn
+void buildCrowd(void)
+{
+	RT3D_PROFILE("buildCrowd");
+	crowd.resize(crowdSize);
+	rt3d::jobGroup group;
+	rt3d::parallelFor(group, buildCrowdJob, crowd.data(), crowdSize, 1024);
+	rt3d::waitJobGroup(group);
+}
+
+// Builds crowdTree from the crowd's world space boxes
+void buildCrowdTree(void)
+{
+	vector<GLfloat> boxes(crowdSize * 6);
+	for (GLuint i = 0; i < crowdSize; i++)
+		rt3d::transformBox(bunnyBounds, crowd[i].modelMatrix, &boxes[i * 6], &boxes[i * 6 + 3]);
+	rt3d::buildBvh(crowdTree, boxes.data(), crowdSize);
+}
+
+// Times building the largest crowd on 1 to maxThreads threads, and checks every
+// thread count gives exactly the same crowd - run with -jobbenchmark [threads]
+void benchmarkJobs(GLuint maxThreads)
+{
+	const int repeats = 20;
+	crowdSize = 100000;
+	vector<rt3d::instanceData> reference;
+	double oneThread = 0.0;
+	for (GLuint threads = 1; threads <= maxThreads; threads++) {
+		rt3d::startJobSystem(threads);
+		buildCrowd();
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++)
+			buildCrowd();
+		double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / repeats;
+		if (threads == 1) {
+			reference = crowd;
+			oneThread = ms;
+		}
+		bool same = memcmp(reference.data(), crowd.data(), crowd.size() * sizeof(rt3d::instanceData)) == 0;
+		cout << threads << " threads: " << ms << " ms per " << crowdSize << " member crowd, "
+			<< oneThread / ms << "x, " << (same ? "identical" : "DIFFERENT") << endl;
+	}
+	rt3d::stopJobSystem();
+}
+
+// Milliseconds since a performance counter reading
+double elapsedMs(Uint64 start)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Reads back the offscreen image, RGBA with no row padding
+void readFrame(vector<GLubyte> &pixels)
+{
+	pixels.resize(windowWidth * windowHeight * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
+
+// FNV-1a hash of the offscreen image, to check runs render exactly the same frames
+GLuint hashFrame(void)
+{
+	vector<GLubyte> pixels;
+	readFrame(pixels);
+	GLuint hash = 2166136261u;
+	for (size_t i = 0; i < pixels.size(); i++)
+		hash = (hash ^ pixels[i]) * 16777619u;
+	return hash;
+}
+
+// Random number in [low, high), the same sequence on every run
+GLfloat randomRange(GLuint &seed, GLfloat low, GLfloat high)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return low + (high - low) * (seed >> 8) / 16777216.0f;
+}
+
+// Brute force box test, to check cullBvh against
+bool boxInFrustum(const rt3d::frustum &view, const GLfloat *box)
+{
+	for (int p = 0; p < 6; p++) {
+		const GLfloat *plane = view.planes[p];
+		GLfloat d = plane[3];
+		for (int i = 0; i < 3; i++)
+			d += plane[i] * (plane[i] > 0.0f ? box[i + 3] : box[i]);
+		if (d < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+// Times building, refitting and querying BVHs of 1k, 100k and 1M random boxes, against doing
+// the same without one, and checks every query gives the same answer - run with -bvhbenchmark
+void benchmarkBvh(void)
+{
+	const GLuint sizes[] = { 1000, 100000, 1000000 };
+	const GLuint queries = 1000;
+	for (GLuint n : sizes) {
+		// boxes of 0.5 to 1.5 on a side, at the same density whatever the count
+		GLuint seed = 1;
+		GLfloat side = 4.0f * (GLfloat) cbrt((double) n);
+		vector<GLfloat> boxes(n * 6);
+		for (GLuint i = 0; i < n; i++) {
+			for (int j = 0; j < 3; j++) {
+				GLfloat centre = randomRange(seed, -side / 2, side / 2), half = randomRange(seed, 0.25f, 0.75f);
+				boxes[i * 6 + j] = centre - half;
+				boxes[i * 6 + 3 + j] = centre + half;
+			}
+		}
+		cout << n << " objects:" << endl;
+
+		rt3d::bvh tree;
+		int repeats = max(1, (int) (100000 / n));
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++)
+			rt3d::buildBvh(tree, boxes.data(), n);
+		cout << "  build " << elapsedMs(start) / repeats << " ms, " << tree.nodes.size() << " nodes" << endl;
+
+		// everything drifts a little, then refit all at once
+		for (GLuint i = 0; i < n; i++) {
+			GLfloat dx = randomRange(seed, -0.1f, 0.1f);
+			for (int j = 0; j < 6; j += 3)
+				boxes[i * 6 + j] += dx;
+		}
+		start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++) {
+			for (GLuint j = 0; j < n; j++)
+				rt3d::setBvhObject(tree, j, &boxes[j * 6], &boxes[j * 6 + 3]);
+			rt3d::refitBvh(tree);
+		}
+		cout << "  full refit " << elapsedMs(start) / repeats << " ms" << endl;
+
+		// a few objects move further, one at a time
+		GLuint moves = min(n, (GLuint) 1000);
+		start = SDL_GetPerformanceCounter();
+		for (GLuint i = 0; i < moves; i++) {
+			GLuint object = (i * 7919) % n;
+			GLfloat dy = randomRange(seed, -1.0f, 1.0f);
+			boxes[object * 6 + 1] += dy;
+			boxes[object * 6 + 4] += dy;
+			rt3d::moveBvhObject(tree, object, &boxes[object * 6], &boxes[object * 6 + 3]);
+		}
+		cout << "  incremental refit " << elapsedMs(start) * 1000.0 / moves << " us per object" << endl;
+
+		// the camera at one edge of the boxes, looking in
+		glm::mat4 projection = glm::perspective(float(60.0f * DEG_TO_RADIAN), 4.0f / 3.0f, 1.0f, 150.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, side / 2), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		rt3d::frustum frustum;
+		rt3d::extractFrustum(glm::value_ptr(projection * view), frustum);
+		vector<GLuint> visible;
+		repeats = max(1, (int) (1000000 / n));
+		start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++) {
+			visible.clear();
+			rt3d::cullBvh(tree, frustum, visible);
+		}
+		double bvhMs = elapsedMs(start) / repeats;
+		rt3d::boundingSpheres spheres;
+		for (GLuint i = 0; i < n; i++) {
+			rt3d::meshBounds bounds;
+			rt3d::makeBounds(&boxes[i * 6], &boxes[i * 6 + 3], bounds);
+			spheres.x.push_back(bounds.centre[0]);
+			spheres.y.push_back(bounds.centre[1]);
+			spheres.z.push_back(bounds.centre[2]);
+			spheres.radius.push_back(bounds.radius);
+		}
+		vector<GLubyte> inside;
+		start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++)
+			rt3d::cullSpheres(frustum, spheres, inside);
+		double linearMs = elapsedMs(start) / repeats;
+		sort(visible.begin(), visible.end());
+		GLuint wrong = 0, expected = 0;
+		for (GLuint i = 0; i < n; i++) {
+			bool in = boxInFrustum(frustum, &boxes[i * 6]);
+			expected += in;
+			wrong += in != binary_search(visible.begin(), visible.end(), i);
+		}
+		cout << "  cull " << bvhMs << " ms, " << visible.size() << " visible (every sphere: " << linearMs
+			<< " ms), " << (wrong == 0 && expected == visible.size() ? "correct" : "WRONG") << endl;
+
+		// rays from the camera and nearest objects to random points, checked against every box
+		GLuint checks = min(queries, (GLuint) (100000000 / n)), rayWrong = 0, nearestWrong = 0;
+		vector<GLfloat> rays(queries * 6);
+		for (GLuint i = 0; i < queries; i++) {
+			for (int j = 0; j < 3; j++)
+				rays[i * 6 + j] = randomRange(seed, -side / 2, side / 2);
+			rays[i * 6 + 3] = randomRange(seed, -1.0f, 1.0f);
+			rays[i * 6 + 4] = randomRange(seed, -1.0f, 1.0f);
+			rays[i * 6 + 5] = randomRange(seed, -1.0f, 1.0f);
+		}
+		GLfloat distance;
+		vector<GLuint> hits(queries), nearest(queries);
+		start = SDL_GetPerformanceCounter();
+		for (GLuint i = 0; i < queries; i++)
+			hits[i] = rt3d::raycastBvh(tree, &rays[i * 6], &rays[i * 6 + 3], 50.0f, distance);
+		double rayUs = elapsedMs(start) * 1000.0 / queries;
+		start = SDL_GetPerformanceCounter();
+		for (GLuint i = 0; i < queries; i++)
+			nearest[i] = rt3d::nearestBvh(tree, &rays[i * 6], side, distance);
+		double nearestUs = elapsedMs(start) * 1000.0 / queries;
+		start = SDL_GetPerformanceCounter();
+		for (GLuint i = 0; i < checks; i++) {
+			const GLfloat *origin = &rays[i * 6], *direction = &rays[i * 6 + 3];
+			GLfloat inverse[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+			GLuint hit = RT3D_BVH_NONE, close = RT3D_BVH_NONE;
+			GLfloat hitT = 50.0f, closeD2 = side * side;
+			for (GLuint j = 0; j < n; j++) {
+				const GLfloat *box = &boxes[j * 6];
+				GLfloat enter = 0.0f, leave = FLT_MAX, d2 = 0.0f;
+				for (int k = 0; k < 3; k++) {
+					GLfloat t0 = (box[k] - origin[k]) * inverse[k], t1 = (box[k + 3] - origin[k]) * inverse[k];
+					enter = max(enter, min(t0, t1));
+					leave = min(leave, max(t0, t1));
+					GLfloat d = max(max(box[k] - origin[k], origin[k] - box[k + 3]), 0.0f);
+					d2 += d * d;
+				}
+				if (enter <= leave && (enter < hitT || (enter == hitT && j < hit))) {
+					hitT = enter;
+					hit = j;
+				}
+				if (d2 < closeD2 || (d2 == closeD2 && j < close)) {
+					closeD2 = d2;
+					close = j;
+				}
+			}
+			rayWrong += hit != hits[i];
+			nearestWrong += close != nearest[i];
+		}
+		double bruteUs = elapsedMs(start) * 1000.0 / checks;
+		cout << "  raycast " << rayUs << " us, nearest " << nearestUs << " us (both against every box: " << bruteUs
+			<< " us), " << (rayWrong == 0 && nearestWrong == 0 ? "correct" : "WRONG") << " for " << checks << " checked" << endl;
+	}
+}
+
+// Writes a side x side grid of quads, two triangles each, with positions, tex coords and normals
+// on every corner - a stand in for a large scanned model
+bool writeGridObj(const char *filename, GLuint side)
+{
+	FILE *file = fopen(filename, "w");
+	if (!file)
+		return false;
+	for (GLuint y = 0; y <= side; y++)
+		for (GLuint x = 0; x <= side; x++) {
+			GLfloat u = (GLfloat) x / side, v = (GLfloat) y / side;
+			fprintf(file, "v %f %f %f\n", u - 0.5f, 0.1f * sin(u * 40.0f) * cos(v * 40.0f), v - 0.5f);
+			fprintf(file, "vt %f %f\n", u, v);
+			fprintf(file, "vn 0 1 0\n");
+		}
+	for (GLuint y = 0; y < side; y++)
+		for (GLuint x = 0; x < side; x++) {
+			GLuint a = y * (side + 1) + x + 1, b = a + side + 1;
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+		}
+	return fclose(file) == 0;
+}
+
+// Names the grid OBJ of about the given number of triangles, writing it if it isn't there from
+// an earlier run. Returns false if it couldn't be written
+bool findGridObj(GLuint triangles, char *gridName, size_t nameSize)
+{
+	GLuint side = max((GLuint) 1, (GLuint) sqrt(triangles / 2.0));
+	snprintf(gridName, nameSize, "grid-%u.obj", side * side * 2);
+	FILE *existing = fopen(gridName, "rb");
+	if (existing) {
+		fclose(existing);
+		return true;
+	}
+	cout << "writing " << gridName << endl;
+	if (writeGridObj(gridName, side))
+		return true;
+	cout << "couldn't write " << gridName << endl;
+	return false;
+}
+
+// Times loading bunny-5000.obj and a generated grid of about the given number of triangles on
+// one thread and on every core, in MB/s, and checks both give exactly the same mesh - run with
+// -objbenchmark [triangles]. The grid is written the first time and kept for later runs
+void benchmarkObj(GLuint triangles)
+{
+	char gridName[64];
+	if (!findGridObj(triangles, gridName, sizeof(gridName)))
+		return;
+
+	rt3d::startJobSystem(0);
+	const char *files[] = { "bunny-5000.obj", gridName };
+	for (const char *name : files) {
+		size_t length;
+		const char *data = rt3d::mapFile(name, length);
+		rt3d::unmapFile(data, length);
+		if (!data) {
+			cout << name << ": not found" << endl;
+			continue;
+		}
+		double mb = length / (1024.0 * 1024.0);
+		int repeats = max(1, (int) (20.0 / mb));
+		vector<GLfloat> verts[2], norms[2], texcoords[2];
+		vector<GLuint> indices[2];
+		double ms[2];
+		for (int parallel = 0; parallel < 2; parallel++) {
+			Uint64 start = SDL_GetPerformanceCounter();
+			for (int i = 0; i < repeats; i++) {
+				verts[parallel].clear();
+				norms[parallel].clear();
+				texcoords[parallel].clear();
+				indices[parallel].clear();
+				rt3d::loadObj(name, verts[parallel], norms[parallel], texcoords[parallel], indices[parallel], parallel ? 0 : 1);
+			}
+			ms[parallel] = elapsedMs(start) / repeats;
+		}
+		bool same = verts[0] == verts[1] && norms[0] == norms[1] && texcoords[0] == texcoords[1] && indices[0] == indices[1];
+		cout << name << ": " << mb << " MB, " << indices[0].size() / 3 << " triangles, " << verts[0].size() / 3 << " vertices" << endl;
+		cout << "  serial " << ms[0] << " ms (" << mb * 1000.0 / ms[0] << " MB/s), parallel " << ms[1] << " ms ("
+			<< mb * 1000.0 / ms[1] << " MB/s), " << (same ? "identical" : "DIFFERENT") << endl;
+	}
+	rt3d::stopJobSystem();
+}
+
+// Times drawing a generated grid of about the given number of triangles from a mesh with a buffer
+// per attribute (createMesh) and from one interleaved buffer (createInterleavedMesh), with
+// ActualPhong, and checks both draw the same image - run with -meshbenchmark [triangles]
+void benchmarkMeshLayout(GLuint triangles)
+{
+	char gridName[64];
+	if (!findGridObj(triangles, gridName, sizeof(gridName)))
+		return;
+	vector<GLfloat> verts, norms, texcoords;
+	vector<GLuint> indices;
+	rt3d::loadObj(gridName, verts, norms, texcoords, indices);
+	GLuint numVerts = (GLuint) verts.size() / 3, indexCount = (GLuint) indices.size();
+	if (indexCount == 0)
+		return;
+	GLuint meshes[2];
+	meshes[0] = rt3d::createMesh(numVerts, verts.data(), nullptr, norms.data(), texcoords.data(), indexCount, indices.data());
+	rt3d::vertexFormat format = rt3d::makeVertexFormat(false, true, true);
+	vector<char> interleaved(numVerts * format.stride);
+	rt3d::interleaveVertices(numVerts, verts.data(), nullptr, norms.data(), texcoords.data(), format, interleaved.data());
+	meshes[1] = rt3d::createInterleavedMesh(numVerts, interleaved.data(), format, indexCount, indices.data());
+
+	GLuint program = rt3d::initShaders("ActualPhong.vert", "ActualPhong.frag");
+	glm::mat4 projection = glm::perspective(float(60.0f * DEG_TO_RADIAN), (float) windowWidth / windowHeight, 0.1f, 10.0f);
+	rt3d::cameraStruct camera = {};
+	memcpy(camera.projection, glm::value_ptr(projection), sizeof(camera.projection));
+	rt3d::setCameraBlock(camera);
+	rt3d::setLightBlock(light0);
+	rt3d::setMaterialBlock(material0);
+	glm::mat4 modelview = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, 0.0f, -1.2f));
+	modelview = glm::rotate(modelview, float(40.0f * DEG_TO_RADIAN), glm::vec3(1.0f, 0.0f, 0.0f));
+	rt3d::setUniformMatrix4fv(rt3d::getProgramUniforms(program).modelview, glm::value_ptr(modelview));
+	rt3d::setEnabled(GL_DEPTH_TEST, true);
+	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+
+	// about 20 million indices a run, alternating layouts so both see the same conditions. The image
+	// is only cleared once a run, so later draws of the same grid fail the depth test - a fetch and
+	// vertex shading test rather than a fill rate one
+	GLuint draws = min(max((GLuint) 5, 20000000 / indexCount), (GLuint) 1000);
+	double ms[2] = { 0.0, 0.0 };
+	GLuint hashes[2];
+	for (GLuint round = 0; round < 3; round++)
+		for (int layout = 0; layout < 2; layout++) {
+			glFinish();
+			Uint64 start = SDL_GetPerformanceCounter();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (GLuint i = 0; i < draws; i++)
+				rt3d::drawIndexedMesh(meshes[layout], indexCount, GL_TRIANGLES);
+			glFinish();
+			if (round > 0)	// the first round warms up
+				ms[layout] += elapsedMs(start);
+			hashes[layout] = hashFrame();
+		}
+	for (int layout = 0; layout < 2; layout++)
+		ms[layout] /= draws * 2;
+	cout << gridName << ": " << indexCount / 3 << " triangles, " << numVerts << " vertices" << endl;
+	cout << "  split " << ms[0] << " ms per draw (" << indexCount / 3 / ms[0] / 1000.0 << " M triangles/s), interleaved "
+		<< ms[1] << " ms (" << indexCount / 3 / ms[1] / 1000.0 << " M triangles/s), "
+		<< (hashes[0] == hashes[1] ? "identical" : "DIFFERENT") << endl;
+	glDeleteProgram(program);
+}
+
+// Writes an MD2 of a rows x columns grid wrapped round a cylinder, rippling from frame to frame -
+// a stand in for a character, with no skin and a tex coord per vertex
+bool writeSyntheticMd2(const char *filename, int rows, int columns, int frames)
+{
+	md2_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.ident = 844121161;	// "IDP2"
+	header.version = 8;
+	header.skinwidth = header.skinheight = 256;
+	header.num_vertices = header.num_st = rows * columns;
+	header.num_tris = (rows - 1) * (columns - 1) * 2;
+	header.num_frames = frames;
+	header.framesize = (int) (sizeof(md2vec3) * 2 + 16 + sizeof(md2_vertex_t) * header.num_vertices);
+	header.offset_skins = header.offset_st = sizeof(header);
+	header.offset_tris = header.offset_st + header.num_st * sizeof(md2_texCoord_t);
+	header.offset_frames = header.offset_tris + header.num_tris * sizeof(md2_triangle_t);
+	header.offset_glcmds = header.offset_end = header.offset_frames + header.num_frames * header.framesize;
+
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+		return false;
+	fwrite(&header, sizeof(header), 1, file);
+	for (int v = 0; v < header.num_vertices; v++) {
+		md2_texCoord_t st = { (short) (v % columns * 255 / (columns - 1)), (short) (v / columns * 255 / (rows - 1)) };
+		fwrite(&st, sizeof(st), 1, file);
+	}
+	for (int r = 0; r + 1 < rows; r++)
+		for (int c = 0; c + 1 < columns; c++) {
+			unsigned short a = (unsigned short) (r * columns + c), b = (unsigned short) (a + columns);
+			md2_triangle_t tris[2] = { { { a, b, (unsigned short) (a + 1) }, { a, b, (unsigned short) (a + 1) } },
+				{ { (unsigned short) (a + 1), b, (unsigned short) (b + 1) }, { (unsigned short) (a + 1), b, (unsigned short) (b + 1) } } };
+			fwrite(tris, sizeof(tris), 1, file);
+		}
+	vector<GLfloat> positions(header.num_vertices * 3);
+	vector<md2_vertex_t> verts(header.num_vertices);
+	for (int f = 0; f < frames; f++) {
+		GLfloat lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int v = 0; v < header.num_vertices; v++) {
+			GLfloat angle = 6.2831853f * (v % columns) / columns, height = (GLfloat) (v / columns) / (rows - 1);
+			GLfloat radius = 10.0f + 2.0f * sin(angle * 3.0f + height * 6.0f + f * 0.3f);
+			GLfloat *p = &positions[v * 3];
+			p[0] = radius * cos(angle);
+			p[1] = radius * sin(angle);
+			p[2] = 50.0f * height;
+			for (int i = 0; i < 3; i++) {
+				lo[i] = min(lo[i], p[i]);
+				hi[i] = max(hi[i], p[i]);
+			}
+		}
+		md2_frameScale_t scale;
+		char name[16] = "frame";
+		for (int i = 0; i < 3; i++) {
+			scale.scale[i] = max(hi[i] - lo[i], 1e-6f) / 255.0f;
+			scale.translate[i] = lo[i];
+		}
+		for (int v = 0; v < header.num_vertices; v++) {
+			for (int i = 0; i < 3; i++)
+				verts[v].v[i] = (unsigned char) ((positions[v * 3 + i] - lo[i]) / scale.scale[i] + 0.5f);
+			verts[v].normalIndex = (unsigned char) ((v + f) % 162);
+		}
+		fwrite(scale.scale, sizeof(md2vec3), 1, file);
+		fwrite(scale.translate, sizeof(md2vec3), 1, file);
+		fwrite(name, sizeof(name), 1, file);
+		fwrite(verts.data(), sizeof(md2_vertex_t), verts.size(), file);
+	}
+	return fclose(file) == 0;
+}
+
+// Animates count characters of filename, each with its own blended vertices and spread over the
+// animations, for steps frames - on the job system if parallel. Returns the time taken, and a hash
+// of every character's vertices, which doesn't depend on how they were animated
+double animateCharacters(const char *filename, GLuint count, GLuint steps, bool parallel, GLuint &hash)
+{
+	vector<md2model *> models(count);
+	for (GLuint i = 0; i < count; i++) {
+		models[i] = new md2model(filename);
+		models[i]->setCurrentAnim(i % MD2_ANIMATIONS);
+		models[i]->Animate(0.05f * (i % 20));
+	}
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (GLuint s = 0; s < steps; s++) {
+		if (parallel)
+			md2model::AnimateParallel(models.data(), count, 0.1f);
+		else
+			md2model::AnimateBatch(models.data(), count, 0.1f);
+	}
+	double ms = elapsedMs(start);
+	hash = 2166136261u;
+	for (GLuint i = 0; i < count; i++) {
+		const unsigned char *bytes = (const unsigned char *) models[i]->getAnimVerts();
+		for (size_t b = 0; b < models[i]->getVertDataSize() * 2 * sizeof(GLfloat); b++)
+			hash = (hash ^ bytes[b]) * 16777619u;
+		delete models[i];
+	}
+	return ms;
+}
+
+// Draws count characters of filename in a grid for frames frames (after one to warm up), either
+// blended on the CPU and uploaded before each draw with program, or morphed on the GPU by program
+// (md2Morph.vert). Returns the mean frame time, with the last frame's image in pixels
+double drawCharacters(const char *filename, GLuint count, GLuint frames, bool gpu, GLuint program, vector<GLubyte> &pixels)
+{
+	vector<md2model *> models(count);
+	for (GLuint i = 0; i < count; i++) {
+		models[i] = new md2model(filename);
+		if (gpu)
+			models[i]->createMorphTexture();
+		models[i]->setCurrentAnim(i % MD2_ANIMATIONS);
+		models[i]->Animate(0.05f * (i % 20));
+	}
+	GLuint mesh = models[0]->getAsset()->getMesh();
+	GLuint side = (GLuint) ceil(sqrt((double) count));
+	GLfloat cell = 100.0f / side;
+	const rt3d::programUniforms &uniforms = rt3d::getProgramUniforms(program);
+	double ms = 0.0;
+	for (GLuint f = 0; f <= frames; f++) {
+		glFinish();
+		Uint64 start = SDL_GetPerformanceCounter();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		md2model::AnimateParallel(models.data(), count, 0.1f);
+		rt3d::useProgram(program);
+		for (GLuint i = 0; i < count; i++) {
+			// the model stands along z, about 25 high - stand it up in the middle of its cell
+			glm::mat4 modelview = glm::translate(glm::mat4(1.0), glm::vec3((i % side + 0.5f) * cell - 50.0f, (i / side + 0.5f) * cell - 50.0f, -90.0f));
+			modelview = glm::scale(modelview, glm::vec3(1.8f / side));
+			modelview = glm::rotate(modelview, float(-90.0f * DEG_TO_RADIAN), glm::vec3(1.0f, 0.0f, 0.0f));
+			modelview = glm::translate(modelview, glm::vec3(0.0f, 0.0f, -25.0f));
+			rt3d::setUniformMatrix4fv(uniforms.modelview, glm::value_ptr(modelview));
+			if (gpu)
+				models[i]->setMorphUniforms(program);
+			else {
+				rt3d::updateMesh(mesh, RT3D_VERTEX, models[i]->getAnimVerts(), models[i]->getVertDataSize());
+				rt3d::updateMesh(mesh, RT3D_NORMAL, models[i]->getAnimNormals(), models[i]->getVertDataSize());
+			}
+			rt3d::drawIndexedMesh(mesh, models[i]->getIndexCount(), GL_TRIANGLES);
+		}
+		glFinish();
+		if (f > 0)
+			ms += elapsedMs(start);
+		rt3d::endStreamFrame();
+	}
+	readFrame(pixels);
+	for (GLuint i = 0; i < count; i++)
+		delete models[i];
+	return ms / frames;
+}
+
+// Times animating 1, 100 and 10000 characters of a synthetic 512 vertex, 198 frame MD2 on the CPU,
+// in million vertices per second, with AnimateBatch on one thread and AnimateParallel on threads,
+// and checks both give the same vertices. Then times drawing 1, 100 and 1000 of them blended on the
+// CPU and morphed on the GPU, and checks both draw the same image - run with -md2benchmark [threads]
+void benchmarkMd2(GLuint threads)
+{
+	const char *filename = "synthetic.md2";
+	if (!writeSyntheticMd2(filename, 16, 32, 198)) {
+		cout << "couldn't write " << filename << endl;
+		return;
+	}
+	md2model reference(filename);
+	GLuint verts = reference.getVertDataCount();
+	cout << filename << ": " << verts << " vertices, " << reference.getIndexCount() / 3 << " triangles" << endl;
+	rt3d::startJobSystem(threads);
+	const GLuint counts[] = { 1, 100, 10000 };
+	for (GLuint count : counts) {
+		GLuint steps = max((GLuint) 20, 20000000 / (count * verts));
+		GLuint serialHash, parallelHash;
+		double serialMs = animateCharacters(filename, count, steps, false, serialHash);
+		double parallelMs = animateCharacters(filename, count, steps, true, parallelHash);
+		double vertices = (double) count * verts * steps / 1000000.0;
+		cout << count << (count > 1 ? " characters: " : " character: ") << vertices * 1000.0 / serialMs
+			<< " M vertices/s batched, " << vertices * 1000.0 / parallelMs << " M vertices/s on " << rt3d::getJobThreads()
+			<< " threads, " << (serialHash == parallelHash ? "identical" : "DIFFERENT") << endl;
+	}
+
+	GLuint cpuProgram = rt3d::initShaders("ActualPhong.vert", "ActualPhong.frag");
+	GLuint gpuProgram = rt3d::initShaders("md2Morph.vert", "ActualPhong.frag");
+	GLint linked[2];
+	glGetProgramiv(cpuProgram, GL_LINK_STATUS, &linked[0]);
+	glGetProgramiv(gpuProgram, GL_LINK_STATUS, &linked[1]);
+	if (!linked[0] || !linked[1])
+		cout << "couldn't build " << (linked[0] ? "md2Morph.vert" : "ActualPhong.vert") << " - not drawing" << endl;
+	else {
+		glm::mat4 projection = glm::perspective(float(60.0f * DEG_TO_RADIAN), (float) windowWidth / windowHeight, 1.0f, 150.0f);
+		rt3d::cameraStruct camera = {};
+		memcpy(camera.projection, glm::value_ptr(projection), sizeof(camera.projection));
+		rt3d::setCameraBlock(camera);
+		rt3d::setLightBlock(light0);
+		rt3d::setMaterialBlock(material0);
+		rt3d::setEnabled(GL_DEPTH_TEST, true);
+		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+		const GLuint drawCounts[] = { 1, 100, 1000 };
+		for (GLuint count : drawCounts) {
+			vector<GLubyte> pixels[2];
+			double cpuMs = drawCharacters(filename, count, 10, false, cpuProgram, pixels[0]);
+			double gpuMs = drawCharacters(filename, count, 10, true, gpuProgram, pixels[1]);
+			// the shader may fuse the blend's multiply and add, so allow the odd rounding difference
+			GLuint differing = 0;
+			for (size_t i = 0; i < pixels[0].size(); i++)
+				differing += abs(pixels[0][i] - pixels[1][i]) > 2;
+			cout << count << (count > 1 ? " characters: " : " character: ") << cpuMs << " ms per frame blended on the CPU, "
+				<< gpuMs << " ms morphed on the GPU, " << (differing == 0 ? "same image" : "DIFFERENT image") << endl;
+		}
+	}
+	glDeleteProgram(cpuProgram);
+	glDeleteProgram(gpuProgram);
+	rt3d::stopJobSystem();
+	reference.FreeModel();
+	remove(filename);
+}
+
+// The crowd members to draw this frame, grouped by LOD level and in crowd order within each
+// level. Members are picked and copied in chunks of crowdLodGrain on the job system: the first
+// pass finds each member's level and counts each chunk's members at each level, and once those
+// counts are turned into where each chunk's members go, the second pass copies them there
+const GLuint crowdLodGrain = 1024;
+struct crowdLodJob {
+	const GLuint *members;			// indices into crowd, or nullptr for the whole crowd
+	vector<GLubyte> levels;			// per member
+	vector<GLuint> chunkOffsets;	// per chunk and level - counts, then where the chunk's members go
+	GLuint levelStart[RT3D_MAX_LODS + 1];
+	vector<rt3d::instanceData> instances;
+};
+
+void selectCrowdLodJob(void *data, const GLuint begin, const GLuint end)
+{
+	crowdLodJob *job = (crowdLodJob *) data;
+	GLuint *counts = &job->chunkOffsets[begin / crowdLodGrain * RT3D_MAX_LODS];
+	for (GLuint i = begin; i < end; i++) {
+		GLuint member = job->members ? job->members[i] : i;
+		GLuint level = selectBunnyLod(glm::make_mat4(crowd[member].modelMatrix), eye);
+		job->levels[i] = (GLubyte) level;
+		counts[level]++;
+	}
+}
+
+void placeCrowdLodJob(void *data, const GLuint begin, const GLuint end)
+{
+	crowdLodJob *job = (crowdLodJob *) data;
+	GLuint *offsets = &job->chunkOffsets[begin / crowdLodGrain * RT3D_MAX_LODS];
+	for (GLuint i = begin; i < end; i++)
+		job->instances[offsets[job->levels[i]]++] = crowd[job->members ? job->members[i] : i];
+}
+
+void sortCrowdByLod(crowdLodJob &job, const GLuint *members, const GLuint count)
+{
+	RT3D_PROFILE("sortCrowdByLod");
+	GLuint chunks = (count + crowdLodGrain - 1) / crowdLodGrain;
+	job.members = members;
+	job.levels.resize(count);
+	job.chunkOffsets.assign(chunks * RT3D_MAX_LODS, 0);
+	job.instances.resize(count);
+	rt3d::jobGroup group;
+	rt3d::parallelFor(group, selectCrowdLodJob, &job, count, crowdLodGrain);
+	rt3d::waitJobGroup(group);
+	GLuint next = 0;
+	for (GLuint level = 0; level < RT3D_MAX_LODS; level++) {
+		job.levelStart[level] = next;
+		for (GLuint c = 0; c < chunks; c++) {
+			GLuint chunkCount = job.chunkOffsets[c * RT3D_MAX_LODS + level];
+			job.chunkOffsets[c * RT3D_MAX_LODS + level] = next;
+			next += chunkCount;
+		}
+	}
+	job.levelStart[RT3D_MAX_LODS] = next;
+	rt3d::parallelFor(group, placeCrowdLodJob, &job, count, crowdLodGrain);
+	rt3d::waitJobGroup(group);
+}
+
+// Draws the whole crowd with one instanced draw call per LOD level
+void drawCrowd(GLuint program, const rt3d::programUniforms &uniforms)
+{
+	RT3D_PROFILE("drawCrowd");
+	if (crowd.size() != crowdSize) {
+		buildCrowd();
+		buildCrowdTree();
+	}
+	const GLuint *members = nullptr;
+	GLuint count = crowdSize;
+	if (culling) {
+		// back in crowd order, so the crowd is drawn the same way with culling on or off
+		visibleObjects.clear();
+		count = rt3d::cullBvh(crowdTree, worldFrustum, visibleObjects);
+		sort(visibleObjects.begin(), visibleObjects.end());
+		members = visibleObjects.data();
+	}
+	static crowdLodJob levels;
+	sortCrowdByLod(levels, members, count);
+	RT3D_PROFILE_GPU("crowd");
+	rt3d::useProgram(program);
+	rt3d::setUniformMatrix4fv(uniforms.view, glm::value_ptr(mvStack.top()));
+	for (GLuint level = 0; level < bunnyLods.count; level++)
+		rt3d::drawIndexedMeshInstanced(meshObjects[2], bunnyLods.levels[level].indexCount, GL_TRIANGLES,
+			levels.instances.data() + levels.levelStart[level], levels.levelStart[level + 1] - levels.levelStart[level],
+			bunnyLods.levels[level].firstIndex);
+}
+
+// Lays out a 16 x 16 field of alternating cubes and bunnies behind the bunny
+void buildStaticField(void)
+{
+	const int side = 16;
+	for (int i = 0; i < side * side; i++) {
+		bool cube = (i + i / side) % 2 == 0;
+		glm::mat4 model(1.0);
+		model = glm::translate(model, glm::vec3(-2.0f + 2.0f * (i % side - side / 2), 1.0f, -3.0f - 2.0f * (i / side)));
+		if (cube)
+			model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
+		else
+			model = glm::scale(model, glm::vec3(20.0f, 20.0f, 20.0f));
+		rt3d::instanceData data;
+		memcpy(data.modelMatrix, glm::value_ptr(model), sizeof(data.modelMatrix));
+		data.materialIndex = cube ? 1 : 0;
+		fieldMeshes.push_back(cube ? poolCube : poolBunny);
+		fieldData.push_back(data);
+	}
+	vector<GLfloat> boxes(fieldMeshes.size() * 6);
+	for (size_t i = 0; i < fieldMeshes.size(); i++) {
+		GLfloat *box = &boxes[i * 6];
+		if (fieldMeshes[i].hasBounds)
+			rt3d::transformBox(fieldMeshes[i].bounds, fieldData[i].modelMatrix, box, box + 3);
+		else
+			for (int j = 0; j < 3; j++) {	// never culled
+				box[j] = -FLT_MAX;
+				box[j + 3] = FLT_MAX;
+			}
+	}
+	rt3d::buildBvh(fieldTree, boxes.data(), (GLuint) fieldMeshes.size());
+}
+
+// Copies the field meshes inside the view frustum to visibleFieldMeshes and visibleFieldData
+void cullStaticField(void)
+{
+	RT3D_PROFILE("cullStaticField");
+	visibleObjects.clear();
+	rt3d::cullBvh(fieldTree, worldFrustum, visibleObjects);
+	sort(visibleObjects.begin(), visibleObjects.end());
+	visibleFieldMeshes.clear();
+	visibleFieldData.clear();
+	for (size_t i = 0; i < visibleObjects.size(); i++) {
+		visibleFieldMeshes.push_back(fieldMeshes[visibleObjects[i]]);
+		visibleFieldData.push_back(fieldData[visibleObjects[i]]);
+	}
+}
+
+// Draws the whole field from the mesh pool, with one multi draw call where supported
+void drawStaticField(void)
+{
+	RT3D_PROFILE("drawStaticField");
+	if (fieldMeshes.empty())
+		buildStaticField();
+	if (culling)
+		cullStaticField();
+	const vector<rt3d::poolMesh> &meshes = culling ? visibleFieldMeshes : fieldMeshes;
+	const vector<rt3d::instanceData> &data = culling ? visibleFieldData : fieldData;
+	RT3D_PROFILE_GPU("static field");
+	rt3d::useProgram(instancedPhongProgram);
+	rt3d::setUniformMatrix4fv(instancedPhongUniforms.view, glm::value_ptr(mvStack.top()));
+	rt3d::drawMeshPool(staticPool, meshes.data(), data.data(), (GLuint) meshes.size(), GL_TRIANGLES);
+}
+
+void draw(SDL_Window * window) {
+	RT3D_PROFILE("draw");
+	
+	// clear the screen
+	rt3d::setEnabled(GL_CULL_FACE, true);
+	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glm::mat4 projection(1.0);
+	projection = glm::perspective(float(60.0f*DEG_TO_RADIAN), (float) windowWidth / windowHeight, 1.0f, 150.0f);
+	lodPixels = rt3d::lodPixelScale(float(60.0f*DEG_TO_RADIAN), windowHeight);
+
+	glm::mat4 modelview(1.0); // set base position for scene
+	mvStack.push(modelview);
+
+	at = moveForward(eye, r, 1.0f);
+	mvStack.top() = glm::lookAt(eye, at, up);
+	rt3d::extractFrustum(glm::value_ptr(projection * mvStack.top()), worldFrustum);
+
+	rt3d::cameraStruct camera;
+	memcpy(camera.projection, glm::value_ptr(projection), sizeof(camera.projection));
+	memcpy(camera.position, glm::value_ptr(glm::vec4(eye, 1.0f)), sizeof(camera.position));
+	rt3d::setCameraBlock(camera);
+
+	rt3d::clearRenderQueue(renderQueue);
+
+	// We will be using the cube map for the skybox
+	// (the sky pass is drawn first, inside out and without depth writes)
+	glm::mat3 mvRotOnlyMat3 = glm::mat3(mvStack.top());
+	mvStack.push(glm::mat4(mvRotOnlyMat3));
+	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(1.5f, 1.5f, 1.5f));
+	rt3d::drawItem item = makeDrawItem(RT3D_PASS_SKY, skyboxProgram, skyboxUniforms, meshObjects[0], cubeIndexCount, mvStack.top());
+	item.textureTarget = GL_TEXTURE_CUBE_MAP;
+	item.texture = skybox[0];
+	rt3d::queueDrawItem(renderQueue, item);
+	mvStack.pop();
+
+	// light position is in eye space, so the light block changes whenever the camera moves
+	glm::vec4 tmp = mvStack.top()*lightPos;
+	light0.position[0] = tmp.x;
+	light0.position[1] = tmp.y;
+	light0.position[2] = tmp.z;
+	rt3d::setLightBlock(light0);
+
+	// Draws ground plane
+	mvStack.push(mvStack.top());
+	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(-10.0f, -0.1f, -10.0f));
+	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(20.0f, 0.1f, 20.0f));
+	item = makeDrawItem(RT3D_PASS_OPAQUE, shaderProgram, shaderUniforms, meshObjects[0], cubeIndexCount, mvStack.top());
+	item.textureTarget = GL_TEXTURE_2D;
+	item.texture = textures[0];
+	item.hasMaterial = true;
+	item.material = material0;
+	rt3d::queueDrawItem(renderQueue, item);
+	mvStack.pop();
+
+	// This should draw the cube where the light is based
+	mvStack.push(mvStack.top());
+	mvStack.top() = glm::translate(mvStack.top(), glm::vec3(lightPos[0], lightPos[1], lightPos[2]));
+	mvStack.top() = glm::scale(mvStack.top(), glm::vec3(0.25f, 0.25f, 0.25f));
+	item = makeDrawItem(RT3D_PASS_OPAQUE, shaderProgram, shaderUniforms, meshObjects[0], cubeIndexCount, mvStack.top());
+	item.textureTarget = GL_TEXTURE_2D;
+	item.texture = textures[0];
+	item.hasMaterial = true;
+	item.material = material0;
+	rt3d::queueDrawItem(renderQueue, item);
+	mvStack.pop();
+
+	// User input detection - For cycling through the five shaders:
+	// 1 = Gouraud
+	// 2 = Phong
+	// 3 = Refracted
+	// 4 = Environment mapping
+	// 5 = Car(toon)
+	// 6 = Crowd (instanced Phong)
+	// 7 = Crowd (instanced toon)
+	// 8 = Static field (mesh pool, multi draw indirect)
+
+
+	if (shaderController == 1) drawGouraud();
+	if (shaderController == 2) drawActPhong();
+	if (shaderController == 3) drawRefraction();
+	if (shaderController == 4) drawReflection();
+	if (shaderController == 5) drawCartoon();
+
+	if (culling)
+		rt3d::cullRenderQueue(renderQueue, glm::value_ptr(projection));
+	rt3d::drawRenderQueue(renderQueue, queueStats);
+
+	if (shaderController == 6) drawCrowd(instancedPhongProgram, instancedPhongUniforms);
+	if (shaderController == 7) drawCrowd(instancedToonProgram, instancedToonUniforms);
+	if (shaderController == 8) drawStaticField();
+
+	mvStack.pop(); // initial matrix
+
+	{
+		RT3D_PROFILE("swap");
+		if (headless)
+			glFinish(); // nothing to show - wait for the GPU instead, so frame times include its work
+		else
+			SDL_GL_SwapWindow(window); // swap buffers
+	}
+	rt3d::endStreamFrame(); // next frame streams into the next region of the stream buffer
+
+}
+
+// Renders warmup frames, then times frames more along the scripted camera path and reports
+// mean/p50/p99 frame times, draw calls and triangles - to stdout, and as JSON to reportFile if given
+int runBenchmark(SDL_Window * window, GLuint frames, GLuint warmup, const char *reportFile, const char *traceFile)
+{
+	vector<double> frameMs;
+	GLuint64 drawCalls = 0, triangles = 0, visible = 0, culled = 0;
+	double totalMs = 0.0;
+	SDL_Event sdlEvent;
+	for (GLuint i = 0; i < warmup + frames; i++) {
+		while (SDL_PollEvent(&sdlEvent))
+			;	// nothing to respond to, but the event queue still has to be emptied
+		Uint64 start = SDL_GetPerformanceCounter();
+		scriptCamera(i < warmup ? 0 : i - warmup, frames);
+		rt3d::resetRenderStats();
+		draw(window);
+		double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+		rt3d::endProfileFrame();
+		if (i < warmup)
+			continue;
+		const rt3d::renderStats &stats = rt3d::getRenderStats();
+		frameMs.push_back(ms);
+		totalMs += ms;
+		drawCalls += stats.drawCalls;
+		triangles += stats.triangles;
+		visible += stats.objectsVisible;
+		culled += stats.objectsCulled;
+	}
+	GLuint hash = hashFrame();
+
+	// nearest rank percentiles
+	vector<double> sorted(frameMs);
+	sort(sorted.begin(), sorted.end());
+	double mean = totalMs / frames;
+	double p50 = sorted[(frames * 50 + 99) / 100 - 1];
+	double p99 = sorted[(frames * 99 + 99) / 100 - 1];
+	double trianglesPerSecond = totalMs > 0.0 ? triangles * 1000.0 / totalMs : 0.0;
+
+	const char *renderer = (const char *) glGetString(GL_RENDERER);
+	char line[256];
+	snprintf(line, sizeof(line), "headless benchmark: scene %d, %dx%d, %u frames after %u warmup, on %s",
+		shaderController, windowWidth, windowHeight, frames, warmup, renderer);
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  frame time: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, min %.3f ms, max %.3f ms (%.1f fps)",
+		mean, p50, p99, sorted.front(), sorted.back(), 1000.0 / mean);
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  per frame: %.1f draw calls, %.0f triangles - %.2f million triangles/s",
+		(double) drawCalls / frames, (double) triangles / frames, trianglesPerSecond / 1e6);
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  culling %s: %.1f objects visible, %.1f culled per frame",
+		culling ? "on" : "off", (double) visible / frames, (double) culled / frames);
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  LOD %s", lod ? "on" : "off");
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  last frame hash %08x", hash);
+	cout << line << endl;
+
+	int result = 0;
+	if (traceFile && !rt3d::writeProfileTrace(traceFile)) {
+		cout << "couldn't save " << traceFile << endl;
+		result = 1;
+	}
+	if (reportFile) {
+		FILE *file = fopen(reportFile, "w");
+		if (file) {
+			fprintf(file, "{\n  \"renderer\": \"");
+			for (const char *c = renderer; *c; c++)
+				fprintf(file, (*c == '"' || *c == '\\') ? "\\%c" : "%c", *c);
+			fprintf(file, "\",\n  \"scene\": %d,\n  \"width\": %d,\n  \"height\": %d,\n  \"crowd\": %u,\n",
+				shaderController, windowWidth, windowHeight, crowdSize);
+			fprintf(file, "  \"frames\": %u,\n  \"warmup\": %u,\n", frames, warmup);
+			fprintf(file, "  \"frameMs\": { \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f },\n",
+				mean, p50, p99, sorted.front(), sorted.back());
+			fprintf(file, "  \"drawCallsPerFrame\": %.2f,\n  \"trianglesPerFrame\": %.1f,\n  \"trianglesPerSecond\": %.0f,\n",
+				(double) drawCalls / frames, (double) triangles / frames, trianglesPerSecond);
+			fprintf(file, "  \"culling\": %s,\n  \"visiblePerFrame\": %.1f,\n  \"culledPerFrame\": %.1f,\n",
+				culling ? "true" : "false", (double) visible / frames, (double) culled / frames);
+			fprintf(file, "  \"lod\": %s,\n", lod ? "true" : "false");
+			fprintf(file, "  \"frameHash\": \"%08x\"\n}\n", hash);
+		}
+		if (!file || fclose(file) != 0) {
+			cout << "couldn't save " << reportFile << endl;
+			result = 1;
+		}
+	}
+	return result;
+}
+
+// Program entry point
+int main(int argc, char *argv[]) {
+	if (argc > 1 && strcmp(argv[1], "-jobbenchmark") == 0) {
+		benchmarkJobs(argc > 2 ? (GLuint) atoi(argv[2]) : (GLuint) SDL_GetCPUCount());
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "-bvhbenchmark") == 0) {
+		benchmarkBvh();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "-objbenchmark") == 0) {
+		benchmarkObj(argc > 2 ? (GLuint) atoi(argv[2]) : 10000000);
+		return 0;
+	}
+	if (argc > 1 && (strcmp(argv[1], "-md2benchmark") == 0 || strcmp(argv[1], "-meshbenchmark") == 0)) {
+		// these draw into the offscreen target, so need a GL context
+		headless = true;
+		SDL_GLContext glContext;
+		SDL_Window *window = setupRC(glContext);
+		glewExperimental = GL_TRUE;
+		if (glewInit() != GLEW_OK) {
+			std::cout << "glewInit failed, aborting." << endl;
+			exit(1);
+		}
+		createOffscreenTarget();
+		if (strcmp(argv[1], "-md2benchmark") == 0)
+			benchmarkMd2(argc > 2 ? (GLuint) atoi(argv[2]) : (GLuint) SDL_GetCPUCount());
+		else
+			benchmarkMeshLayout(argc > 2 ? (GLuint) atoi(argv[2]) : 180000);
+		deleteOffscreenTarget();
+		SDL_GL_DeleteContext(glContext);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return 0;
+	}
+
+	// -headless [-frames N] [-warmup N] [-scene N] [-crowd N] [-size W H] [-nocull] [-nolod] [-report file] [-trace file]
+	GLuint frames = 1000, warmup = 60;
+	const char *reportFile = nullptr, *traceFile = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			frames = (GLuint) max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+			warmup = (GLuint) max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+			shaderController = min(max(atoi(argv[++i]), 1), 8);
+		else if (strcmp(argv[i], "-crowd") == 0 && i + 1 < argc)
+			crowdSize = (GLuint) max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+			windowWidth = max(1, atoi(argv[++i]));
+			windowHeight = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-nocull") == 0)
+			culling = false;
+		else if (strcmp(argv[i], "-nolod") == 0)
+			lod = false;
+		else if (strcmp(argv[i], "-report") == 0 && i + 1 < argc)
+			reportFile = argv[++i];
+		else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+			traceFile = argv[++i];
+		else {
+			cout << "unknown option " << argv[i] << endl;
+			return 1;
+		}
+	}
+
+	SDL_Window * hWindow; // window handle
+	SDL_GLContext glContext; // OpenGL context handle
+	hWindow = setupRC(glContext); // Create window and render context 
+
+								  // Required on Windows *only* init GLEW to access OpenGL beyond 1.1
+	glewExperimental = GL_TRUE;
+	GLenum err = glewInit();
+	if (GLEW_OK != err) { // glewInit failed, something is seriously wrong
+		std::cout << "glewInit failed, aborting." << endl;
+		exit(1);
+	}
+	cout << glGetString(GL_VERSION) << endl;
+
+	rt3d::startJobSystem(0); // one thread per core - started first so init's models load on it
+	init();
+
+	int result = 0;
+	if (headless) {
+		createOffscreenTarget();
+		result = runBenchmark(hWindow, frames, warmup, reportFile, traceFile);
+		deleteOffscreenTarget();
+	}
+
+	bool running = !headless; // set running to true, unless the benchmark has already run
+	SDL_Event sdlEvent;  // variable to detect SDL events
+	GLuint frameCount = 0;
+	while (running) {	// the event loop
+		while (SDL_PollEvent(&sdlEvent)) {
+			if (sdlEvent.type == SDL_QUIT)
+				running = false;
+			// crowd size goes up and down in steps of 10, between 1 and 100000
+			if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.scancode == SDL_SCANCODE_EQUALS && crowdSize < 100000)
+				crowdSize *= 10;
+			if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.scancode == SDL_SCANCODE_MINUS && crowdSize > 1)
+				crowdSize /= 10;
+			// P saves the last few seconds of frames as a Chrome trace
+			if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.scancode == SDL_SCANCODE_P)
+				cout << (rt3d::writeProfileTrace("profile.json") ? "profile saved to profile.json" : "couldn't save profile.json") << endl;
+			if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.scancode == SDL_SCANCODE_C)
+				culling = !culling;
+			if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.scancode == SDL_SCANCODE_O)
+				lod = !lod;
+		}
+		update();
+		rt3d::resetRenderStats();
+		draw(hWindow); // call the draw function
+		rt3d::endProfileFrame();
+		// frame times in the title bar, and the full profile every few seconds
+		if (++frameCount % 30 == 0) {
+			const rt3d::frameProfile &frame = rt3d::getFrameProfile();
+			const rt3d::renderStats &stats = rt3d::getRenderStats();
+			char title[160];
+			snprintf(title, sizeof(title), "SDL/GLM/OpenGL Demo - %.2f ms CPU, %.2f ms GPU, %u draw calls, %u visible, %u culled",
+				frame.cpuMs, frame.gpuMs, frame.drawCalls, stats.objectsVisible, stats.objectsCulled);
+			SDL_SetWindowTitle(hWindow, title);
+		}
+		if (frameCount % 300 == 0) {
+			if (shaderController == 6 || shaderController == 7)
+				cout << crowdSize << " instances" << endl;
+			rt3d::printProfileSummary(cout);
+			const rt3d::renderStats &stats = rt3d::getRenderStats();
+			cout << stats.uniformLocationQueries << " uniform lookups, "
+				<< stats.stateChangesSkipped << " state changes skipped, "
+				<< stats.streamWaits << " stream waits" << endl;
+			cout << "culling " << (culling ? "on: " : "off: ") << stats.objectsVisible << " objects visible, "
+				<< stats.objectsCulled << " culled" << endl;
+			cout << "render queue: " << queueStats.items << " items, " << queueStats.programChanges << " program changes ("
+				<< queueStats.unsortedProgramChanges << " unsorted), " << queueStats.textureChanges << " texture changes ("
+				<< queueStats.unsortedTextureChanges << " unsorted)" << endl;
+		}
+	}
+
+	rt3d::stopJobSystem();
+	SDL_GL_DeleteContext(glContext);
+	SDL_DestroyWindow(hWindow);
+	SDL_Quit();
+	return result;
 }
\ No newline at end of file
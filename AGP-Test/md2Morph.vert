@@ -0,0 +1,59 @@
+// md2Morph.vert
+// Version of ActualPhong.vert for MD2 models morphed on the GPU - use with ActualPhong.frag
+// Every frame of the model is in morphFrames (see md2model::createMorphTexture), as 6 floats per
+// mesh vertex - its position then its normal - and both are blended here instead of on the CPU.
+// gl_VertexID is the index value, so the mesh is drawn with drawIndexedMesh
+#version 330
+
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
+layout(std140) uniform lightBlock
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 position;
+} light;
+
+uniform mat4 modelview;
+
+uniform samplerBuffer morphFrames;
+uniform int morphCurrent;	// first float of the current and next frames in morphFrames
+uniform int morphNext;
+uniform float morphInterp;
+
+out vec3 ex_N;
+out vec3 ex_V;
+out vec3 ex_L;
+
+vec3 frameVector(int i) {
+	return vec3(texelFetch(morphFrames, i).r, texelFetch(morphFrames, i + 1).r, texelFetch(morphFrames, i + 2).r);
+}
+
+void main(void) {
+	int vertex = gl_VertexID * 6;
+	vec3 current = frameVector(morphCurrent + vertex);
+	vec3 position = current + morphInterp * (frameVector(morphNext + vertex) - current);
+	current = frameVector(morphCurrent + vertex + 3);
+	vec3 normal = current + morphInterp * (frameVector(morphNext + vertex + 3) - current);
+
+	// vertex into eye coordinates
+	vec4 vertexPosition = modelview * vec4(position,1.0);
+
+	// Find V - in eye coordinates, eye is at (0,0,0)
+	ex_V = normalize(-vertexPosition).xyz;
+
+	// surface normal in eye coordinates
+	mat3 normalmatrix = transpose(inverse(mat3(modelview)));
+	ex_N = normalize(normalmatrix * normal);
+
+	// L - to light source from vertex
+	ex_L = normalize(light.position.xyz - vertexPosition.xyz);
+
+    gl_Position = projection * vertexPosition;
+}
@@ -1,342 +1,851 @@
-/* md2model.cpp - based on original:
-* md2.c -- md2 model loader
-* last modification: November 2010 by Daniel Livingstone
-*
-* Copyright (c) 2005-2007 David HENRY
-*
-* Permission is hereby granted, free of charge, to any person
-* obtaining a copy of this software and associated documentation
-* files (the "Software"), to deal in the Software without
-* restriction, including without limitation the rights to use,
-* copy, modify, merge, publish, distribute, sublicense, and/or
-* sell copies of the Software, and to permit persons to whom the
-* Software is furnished to do so, subject to the following conditions:
-*
-* The above copyright notice and this permission notice shall be
-* included in all copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
-* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
-* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
-* NONINFRINGEMENT.
-* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
-* ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
-* CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
-* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-*
-* gcc -Wall -ansi -lGL -lGLU -lglut md2.c -o md2
-*/
-
-
-#include "rt3d.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "md2model.h"
-#include <vector>
-
-/* Table of precalculated normals */
-md2vec3 anorms_table[162] = {
-#include "anorms.h"
-};
-
-// Table of animation begin/end frames
-static int animFrameList[40] = {
-	0, 39, // stand
-	40, 45, // run
-	46, 53, // attack
-	54, 57, //pain1
-	58, 61, //pain2
-	62, 65, //pain3
-	66, 71, //jump
-	72, 83, //flip
-	84, 94, //salute
-	95, 111, //taunt
-	112, 122, //wave
-	123, 134, //point
-	135, 153, //crstnd
-	154, 159, //crwalk
-	160, 168, //crattak
-	169, 172, //crpain
-	173, 177, //crdeath
-	178, 183, //death1
-	184, 189, //death2
-	190, 196 //death3
-};
-
-md2model::md2model()
-{
-	currentAnim = 0;
-	currentFrame = 0;
-	nextFrame = 1;
-	interp = 0.0f;
-}
-
-md2model::md2model(const char *filename)
-{
-	ReadMD2Model(filename);
-	currentAnim = 0;
-	currentFrame = 0;
-	nextFrame = 1;
-	interp = 0.0f;
-}
-
-md2model::~md2model()
-{
-	FreeModel();
-	int i;
-	for (i=0;i<mdl.header.num_frames;++i) {
-		delete [] vertData[i];
-	}
-	delete [] animVerts;
-}
-
-/**
-* Load an MD2 model from file.
-*
-* Note: MD2 format stores model's data in little-endian ordering.  On
-* big-endian machines, you'll have to perform proper conversions.
-*/
-GLuint md2model::ReadMD2Model (const char *filename)
-{
-	FILE *fp;
-	int i;
-
-	fp = fopen (filename, "rb");
-	if (!fp)
-	{
-		fprintf (stderr, "Error: couldn't open \"%s\"!\n", filename);
-		return 0;
-	}
-
-	/* Read header */
-	fread (&mdl.header, 1, sizeof (struct md2_header_t), fp);
-
-	if ((mdl.header.ident != 844121161) ||
-		(mdl.header.version != 8))
-	{
-		/* Error! */
-		fprintf (stderr, "Error: bad version or identifier\n");
-		fclose (fp);
-		return 0;
-	}
-
-	/* Memory allocations */
-	mdl.skins = (struct md2_skin_t *)
-		malloc (sizeof (struct md2_skin_t) * mdl.header.num_skins);
-	mdl.texcoords = (struct md2_texCoord_t *)
-		malloc (sizeof (struct md2_texCoord_t) * mdl.header.num_st);
-	mdl.triangles = (struct md2_triangle_t *)
-		malloc (sizeof (struct md2_triangle_t) * mdl.header.num_tris);
-	mdl.frames = (struct md2_frame_t *)
-		malloc (sizeof (struct md2_frame_t) * mdl.header.num_frames);
-	mdl.glcmds = (int *)malloc (sizeof (int) * mdl.header.num_glcmds);
-
-	/* Read model data */
-	fseek (fp, mdl.header.offset_skins, SEEK_SET);
-	fread (mdl.skins, sizeof (struct md2_skin_t),
-		mdl.header.num_skins, fp);
-
-	fseek (fp, mdl.header.offset_st, SEEK_SET);
-	fread (mdl.texcoords, sizeof (struct md2_texCoord_t),
-		mdl.header.num_st, fp);
-
-	fseek (fp, mdl.header.offset_tris, SEEK_SET);
-	fread (mdl.triangles, sizeof (struct md2_triangle_t),
-		mdl.header.num_tris, fp);
-
-	fseek (fp, mdl.header.offset_glcmds, SEEK_SET);
-	fread (mdl.glcmds, sizeof (int), mdl.header.num_glcmds, fp);
-
-	/* Read frames */
-	fseek (fp, mdl.header.offset_frames, SEEK_SET);
-	for (i = 0; i < mdl.header.num_frames; ++i)
-	{
-		/* Memory allocation for vertices of this frame */
-		mdl.frames[i].verts = (struct md2_vertex_t *)
-			malloc (sizeof (struct md2_vertex_t) * mdl.header.num_vertices);
-
-		/* Read frame data */
-		fread (mdl.frames[i].scale, sizeof (md2vec3), 1, fp);
-		fread (mdl.frames[i].translate, sizeof (md2vec3), 1, fp);
-		fread (mdl.frames[i].name, sizeof (char), 16, fp);
-		fread (mdl.frames[i].verts, sizeof (struct md2_vertex_t),
-			mdl.header.num_vertices, fp);
-	}
-
-	fclose (fp);
-
-	// now generate VBO data and create mesh
-	// then save the data we actually need and free all the stuff we no longer need
-	// this is required to allow the correct generation of normals etc
-
-	int j;
-	GLfloat s, t;
-	md2vec3 v, *norm;
-	struct md2_frame_t *pframe;
-	struct md2_vertex_t *pvert;
-
-	//std::vector<GLfloat> verts;
-	// these automatic variables will be created on stack and automatically deleted when this
-	// function ends - no need to delete
-	std::vector<GLfloat> tex_coords;
-	std::vector<GLfloat> norms;
-	std::vector<GLuint> indices;
-
-	pframe = &mdl.frames[0]; // first frame
-	// For each triangle 
-	// The bad news for MD2 is that we need to expand the triangles to get the data
-	// The number of tex coords need not match the number of vertices, and the number of normals
-	// is different again. So we need to calculate each vertex
-	// Is it possible to use indexing and remove duplicates though...
-	// But I'll not bother doing that for this aged format that I'm definately dumping next year
-	// (about 8 years overdue...! :-D )
-	for (i = 0; i < mdl.header.num_tris; ++i)
-	{
-		// For each vertex 
-		for (j = 0; j < 3; ++j)
-		{
-			// Get texture coordinates 
-			tex_coords.push_back( (GLfloat)mdl.texcoords[mdl.triangles[i].st[j]].s / mdl.header.skinwidth );
-			tex_coords.push_back( (GLfloat)mdl.texcoords[mdl.triangles[i].st[j]].t / mdl.header.skinheight );
-
-			// get current vertex
-			pvert = &pframe->verts[mdl.triangles[i].vertex[j]];
-
-			// Get normals 
-			//norm = anorms_table[pvert->normalIndex][0];
-			norms.push_back(anorms_table[pvert->normalIndex][0]);
-			norms.push_back(anorms_table[pvert->normalIndex][1]);
-			norms.push_back(anorms_table[pvert->normalIndex][2]);
-
-			// Vertices 
-			// Doing these scaling operations *every* refresh is *very* wasteful
-			// Should do all the scaling calculations once only, when loading the file
-			//verts.push_back( pframe->scale[0] * pvert->v[0] + pframe->translate[0] );
-			//verts.push_back( pframe->scale[1] * pvert->v[1] + pframe->translate[1] );
-			//verts.push_back( pframe->scale[2] * pvert->v[2] + pframe->translate[2] );
-			
-		}
-	}
-	// now repeat for each frame...
-	int k = 0;
-	GLfloat *verts;
-	vertDataSize = mdl.header.num_tris * 9;
-	for (k=0;k<mdl.header.num_frames;++k) {
-		verts = new GLfloat[vertDataSize];
-		pframe = &mdl.frames[k]; // first frame
-		for (i = 0; i < mdl.header.num_tris; ++i)
-		{
-			// For each vertex 
-			for (j = 0; j < 3; ++j)
-			{
-				// get current vertex
-				pvert = &pframe->verts[mdl.triangles[i].vertex[j]];
-				verts[(i*3 + j)*3] = GLfloat(pframe->scale[0] * pvert->v[0] + pframe->translate[0]);
-				verts[(i*3 + j)*3+1] = GLfloat(pframe->scale[1] * pvert->v[1] + pframe->translate[1]);
-				verts[(i*3 + j)*3+2] = GLfloat(pframe->scale[2] * pvert->v[2] + pframe->translate[2]);
-			}
-		}
-		vertData.push_back(verts);
-	}
-
-	// initialise animVerts with frame 0 data
-	animVerts = new GLfloat[vertDataSize];
-	memcpy(animVerts,vertData[0],vertDataSize*sizeof(float));
-
-
-	GLuint VAO;
-	VAO = rt3d::createMesh(mdl.header.num_tris * 3,vertData[0],nullptr,norms.data(),tex_coords.data());
-	
-	// actually have all the data we need, so call FreeModel
-	this->FreeModel();
-
-	return VAO;
-}
-
-
-/**
-* Free resources allocated for the model.
-*/
-void md2model::FreeModel ()
-{
-	int i;
-
-	if (mdl.skins)
-	{
-		free (mdl.skins);
-		mdl.skins = NULL;
-	}
-
-	if (mdl.texcoords)
-	{
-		free (mdl.texcoords);
-		mdl.texcoords = NULL;
-	}
-
-	if (mdl.triangles)
-	{
-		free (mdl.triangles);
-		mdl.triangles = NULL;
-	}
-
-	if (mdl.glcmds)
-	{
-		free (mdl.glcmds);
-		mdl.glcmds = NULL;
-	}
-
-	if (mdl.frames)
-	{
-		for (i = 0; i < mdl.header.num_frames; ++i)
-		{
-			free (mdl.frames[i].verts);
-			mdl.frames[i].verts = NULL;
-		}
-
-		free (mdl.frames);
-		mdl.frames = NULL;
-	}
-}
-
-
-
-/**
-* Calculate the current frame in animation, based on
-* selected animation and current frame. If current frame
-* is not in selected animation sequence, new current frame
-* is start of animation sequence. 
-* If interpolation is past 1.0, move current frame to next
-* and next frame = current frame + 1
-*/
-
-void md2model::Animate (int animation, float dt)
-{
-	int start = animFrameList[animation * 2];
-	int end =  animFrameList[animation * 2 + 1];
-	if ((currentFrame < start) || (currentFrame > end))
-	{
-		currentFrame = start;
-		nextFrame = start + 1;
-	}
-	interp += dt;
-	if (interp >= 1.0f)
-	{
-
-		// Move to next frame 
-		interp = 0.0f;
-		currentFrame = nextFrame;
-		nextFrame++;
-
-		if (nextFrame >= end+1)
-			nextFrame = start;
-	}
-	if (interp == 0.0f)
-		memcpy(animVerts,vertData[currentFrame],vertDataSize*sizeof(float));
-	else {
-		for (int i=0;i<vertDataSize;i++)
-			animVerts[i] = vertData[currentFrame][i] + interp*(vertData[nextFrame][i] - vertData[currentFrame][i]);
-	}
-}
-
+/* md2model.cpp - based on original:
+* md2.c -- md2 model loader
+* last modification: November 2010 by Daniel Livingstone
+*
+* Copyright (c) 2005-2007 David HENRY
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or
+* sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+* ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+* CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+* gcc -Wall -ansi -lGL -lGLU -lglut md2.c -o md2
+*/
+
+
+#include "rt3d.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "md2model.h"
+#include "rt3dSimd.h"
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <string>
+
+/* Table of precalculated normals */
+md2vec3 anorms_table[162] = {
+#include "anorms.h"
+};
+
+// Table of animation begin/end frames
+static int animFrameList[40] = {
+	0, 39, // stand
+	40, 45, // run
+	46, 53, // attack
+	54, 57, //pain1
+	58, 61, //pain2
+	62, 65, //pain3
+	66, 71, //jump
+	72, 83, //flip
+	84, 94, //salute
+	95, 111, //taunt
+	112, 122, //wave
+	123, 134, //point
+	135, 153, //crstnd
+	154, 159, //crwalk
+	160, 168, //crattak
+	169, 172, //crpain
+	173, 177, //crdeath
+	178, 183, //death1
+	184, 189, //death2
+	190, 196 //death3
+};
+
+// Keyframe interpolation kernels: out = a + t * (b - a) over count floats
+// The SIMD versions round every element exactly as the scalar loop does (there is no fused
+// multiply-add), so all three give identical vertices
+typedef void (*lerpFunction)(const GLfloat *a, const GLfloat *b, const GLfloat t, GLfloat *out, const GLuint count);
+
+static void lerpScalar(const GLfloat *a, const GLfloat *b, const GLfloat t, GLfloat *out, const GLuint count)
+{
+	for (GLuint i = 0; i < count; i++)
+		out[i] = a[i] + t*(b[i] - a[i]);
+}
+
+#ifdef RT3D_X86_SIMD
+static void lerpSSE2(const GLfloat *a, const GLfloat *b, const GLfloat t, GLfloat *out, const GLuint count)
+{
+	__m128 t4 = _mm_set1_ps(t);
+	GLuint i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(a + i), a1 = _mm_loadu_ps(a + i + 4);
+		__m128 d0 = _mm_sub_ps(_mm_loadu_ps(b + i), a0), d1 = _mm_sub_ps(_mm_loadu_ps(b + i + 4), a1);
+		_mm_storeu_ps(out + i, _mm_add_ps(a0, _mm_mul_ps(t4, d0)));
+		_mm_storeu_ps(out + i + 4, _mm_add_ps(a1, _mm_mul_ps(t4, d1)));
+	}
+	lerpScalar(a + i, b + i, t, out + i, count - i);
+}
+
+RT3D_TARGET_AVX static void lerpAVX(const GLfloat *a, const GLfloat *b, const GLfloat t, GLfloat *out, const GLuint count)
+{
+	__m256 t8 = _mm256_set1_ps(t);
+	GLuint i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(a + i), a1 = _mm256_loadu_ps(a + i + 8);
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(b + i), a0), d1 = _mm256_sub_ps(_mm256_loadu_ps(b + i + 8), a1);
+		_mm256_storeu_ps(out + i, _mm256_add_ps(a0, _mm256_mul_ps(t8, d0)));
+		_mm256_storeu_ps(out + i + 8, _mm256_add_ps(a1, _mm256_mul_ps(t8, d1)));
+	}
+	lerpScalar(a + i, b + i, t, out + i, count - i);
+}
+#endif
+
+// Picks the widest kernel the CPU supports
+static lerpFunction pickLerpFunction()
+{
+#ifdef RT3D_X86_SIMD
+	switch (rt3d::getSimdLevel()) {
+	case rt3d::SIMD_AVX: return lerpAVX;
+	case rt3d::SIMD_SSE2: return lerpSSE2;
+	default: break;
+	}
+#endif
+	return lerpScalar;
+}
+
+// The kernel to use, picked once on first use
+static lerpFunction getLerpFunction()
+{
+	static const lerpFunction lerp = pickLerpFunction();
+	return lerp;
+}
+
+// Loaded assets by file name
+static std::map<std::string, md2asset *> assets;
+
+// Step an animator on by dt
+static void advanceAnimator(md2animator &a, int animation, float dt)
+{
+	int start = animFrameList[animation * 2];
+	int end =  animFrameList[animation * 2 + 1];
+	if ((a.currentFrame < start) || (a.currentFrame > end))
+	{
+		a.currentFrame = start;
+		a.nextFrame = start + 1;
+	}
+	a.interp += dt;
+	if (a.interp >= 1.0f)
+	{
+
+		// Move to next frame 
+		a.interp = 0.0f;
+		a.currentFrame = a.nextFrame;
+		a.nextFrame++;
+
+		if (a.nextFrame >= end+1)
+			a.nextFrame = start;
+	}
+}
+
+md2asset::md2asset()
+{
+	name = nullptr;
+	refCount = 1;
+	mesh = 0;
+	numVertices = 0;
+	vertDataSize = 0;
+	indexCount = 0;
+	morphBuffer = 0;
+	morphTexture = 0;
+}
+
+md2asset::~md2asset()
+{
+	if (morphTexture)
+	{
+		glDeleteTextures(1, &morphTexture);
+		glDeleteBuffers(1, &morphBuffer);
+	}
+}
+
+/**
+* Get the asset for a file, loading it the first time. Returns
+* NULL if the file can't be loaded.
+*/
+md2asset* md2asset::Acquire(const char *filename)
+{
+	auto found = assets.find(filename);
+	if (found != assets.end())
+	{
+		found->second->refCount++;
+		return found->second;
+	}
+	md2asset *asset = new md2asset();
+	if (!asset->Load(filename))
+	{
+		delete asset;
+		return NULL;
+	}
+	found = assets.insert(std::make_pair(std::string(filename), asset)).first;
+	asset->name = found->first.c_str();
+	return asset;
+}
+
+/**
+* Drop a reference, deleting the asset with the last one. The mesh
+* is left alone, as rt3d meshes are never deleted.
+*/
+void md2asset::Release()
+{
+	if (--refCount > 0)
+		return;
+	assets.erase(name);
+	delete this;
+}
+
+static void freeModel (md2_model_t &mdl);
+
+/**
+* Load an MD2 model from file.
+*
+* Note: MD2 format stores model's data in little-endian ordering.  On
+* big-endian machines, you'll have to perform proper conversions.
+*/
+bool md2asset::Load (const char *filename)
+{
+	FILE *fp;
+	int i;
+	md2_model_t mdl;
+
+	fp = fopen (filename, "rb");
+	if (!fp)
+	{
+		fprintf (stderr, "Error: couldn't open \"%s\"!\n", filename);
+		return false;
+	}
+
+	/* Read header */
+	fread (&mdl.header, 1, sizeof (struct md2_header_t), fp);
+
+	if ((mdl.header.ident != 844121161) ||
+		(mdl.header.version != 8))
+	{
+		/* Error! */
+		fprintf (stderr, "Error: bad version or identifier\n");
+		fclose (fp);
+		return false;
+	}
+
+	/* Memory allocations */
+	mdl.skins = (struct md2_skin_t *)
+		malloc (sizeof (struct md2_skin_t) * mdl.header.num_skins);
+	mdl.texcoords = (struct md2_texCoord_t *)
+		malloc (sizeof (struct md2_texCoord_t) * mdl.header.num_st);
+	mdl.triangles = (struct md2_triangle_t *)
+		malloc (sizeof (struct md2_triangle_t) * mdl.header.num_tris);
+	mdl.frames = (struct md2_frame_t *)
+		malloc (sizeof (struct md2_frame_t) * mdl.header.num_frames);
+	mdl.glcmds = (int *)malloc (sizeof (int) * mdl.header.num_glcmds);
+
+	/* Read model data */
+	fseek (fp, mdl.header.offset_skins, SEEK_SET);
+	fread (mdl.skins, sizeof (struct md2_skin_t),
+		mdl.header.num_skins, fp);
+
+	fseek (fp, mdl.header.offset_st, SEEK_SET);
+	fread (mdl.texcoords, sizeof (struct md2_texCoord_t),
+		mdl.header.num_st, fp);
+
+	fseek (fp, mdl.header.offset_tris, SEEK_SET);
+	fread (mdl.triangles, sizeof (struct md2_triangle_t),
+		mdl.header.num_tris, fp);
+
+	fseek (fp, mdl.header.offset_glcmds, SEEK_SET);
+	fread (mdl.glcmds, sizeof (int), mdl.header.num_glcmds, fp);
+
+	/* Read frames */
+	fseek (fp, mdl.header.offset_frames, SEEK_SET);
+	for (i = 0; i < mdl.header.num_frames; ++i)
+	{
+		/* Memory allocation for vertices of this frame */
+		mdl.frames[i].verts = (struct md2_vertex_t *)
+			malloc (sizeof (struct md2_vertex_t) * mdl.header.num_vertices);
+
+		/* Read frame data */
+		fread (mdl.frames[i].scale, sizeof (md2vec3), 1, fp);
+		fread (mdl.frames[i].translate, sizeof (md2vec3), 1, fp);
+		fread (mdl.frames[i].name, sizeof (char), 16, fp);
+		fread (mdl.frames[i].verts, sizeof (struct md2_vertex_t),
+			mdl.header.num_vertices, fp);
+	}
+
+	fclose (fp);
+
+	// now generate VBO data and create mesh
+	// then save the data we actually need and free all the stuff we no longer need
+	// this is required to allow the correct generation of normals etc
+
+	int j;
+	struct md2_frame_t *pframe;
+
+	//std::vector<GLfloat> verts;
+	// these automatic variables will be created on stack and automatically deleted when this
+	// function ends - no need to delete
+	std::vector<GLfloat> tex_coords;
+	std::vector<GLuint> indices;
+
+	// MD2 triangles index positions and tex coords separately, so the mesh gets one vertex
+	// for each distinct (vertex, st) pair used, found through a table keyed on both
+	std::unordered_map<GLuint, GLuint> meshVertIndex;
+	for (i = 0; i < mdl.header.num_tris; ++i)
+	{
+		// For each vertex 
+		for (j = 0; j < 3; ++j)
+		{
+			unsigned short vertex = mdl.triangles[i].vertex[j];
+			unsigned short st = mdl.triangles[i].st[j];
+			GLuint key = ((GLuint) vertex << 16) | st;
+			auto found = meshVertIndex.find(key);
+			if (found != meshVertIndex.end())
+			{
+				indices.push_back(found->second);
+				continue;
+			}
+			GLuint index = (GLuint) meshVerts.size();
+			meshVertIndex.insert(std::make_pair(key, index));
+			indices.push_back(index);
+			meshVerts.push_back(vertex);
+
+			// Get texture coordinates 
+			tex_coords.push_back( (GLfloat)mdl.texcoords[st].s / mdl.header.skinwidth );
+			tex_coords.push_back( (GLfloat)mdl.texcoords[st].t / mdl.header.skinheight );
+		}
+	}
+	indexCount = (GLuint) indices.size();
+
+	// keep the frames compressed, as they are in the file, along with the MD2 vertex behind
+	// each mesh vertex - positions and normals are decoded from them only when interpolated
+	int k = 0;
+	numVertices = mdl.header.num_vertices;
+	vertDataSize = (GLuint) meshVerts.size() * 3;
+	frameVerts.resize((size_t) mdl.header.num_frames * mdl.header.num_vertices);
+	frameScales.resize(mdl.header.num_frames);
+	for (k=0;k<mdl.header.num_frames;++k) {
+		pframe = &mdl.frames[k];
+		memcpy(&frameVerts[(size_t) k * mdl.header.num_vertices], pframe->verts, mdl.header.num_vertices * sizeof(struct md2_vertex_t));
+		memcpy(frameScales[k].scale, pframe->scale, sizeof(md2vec3));
+		memcpy(frameScales[k].translate, pframe->translate, sizeof(md2vec3));
+	}
+
+	// the mesh starts out with frame 0 data
+	std::vector<GLfloat> frame0(vertDataSize * 2);
+	decodeFrame(0, frame0.data());
+	mesh = rt3d::createMesh((GLuint) meshVerts.size(),frame0.data(),nullptr,frame0.data() + vertDataSize,tex_coords.data(),indexCount,indices.data());
+	computeBounds();
+	
+	// actually have all the data we need, so call freeModel
+	freeModel(mdl);
+
+	return true;
+}
+
+/**
+* Grow a box by the box of a frame, from the frame's extreme compressed
+* vertices - decoded the same way decodeFrame decodes them.
+*/
+static void addFrameBox(const unsigned char *lo, const unsigned char *hi, const md2_frameScale_t &fs, GLfloat *min, GLfloat *max)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		GLfloat a = GLfloat(fs.scale[i] * lo[i] + fs.translate[i]);
+		GLfloat b = GLfloat(fs.scale[i] * hi[i] + fs.translate[i]);
+		min[i] = std::min(min[i], std::min(a, b));
+		max[i] = std::max(max[i], std::max(a, b));
+	}
+}
+
+/**
+* Find the bounds of each animation, and of the whole model for the mesh,
+* as its vertices change from frame to frame. The interpolated vertices
+* always lie between two frames, so are inside the bounds of both.
+*/
+void md2asset::computeBounds()
+{
+	int numFrames = (int) frameScales.size();
+	memset(animationBounds, 0, sizeof(animationBounds));
+	if (numFrames == 0 || meshVerts.empty())
+		return;
+
+	// extreme compressed vertices of each frame, over the vertices the mesh uses
+	std::vector<unsigned char> frameLo(numFrames * 3, 255), frameHi(numFrames * 3, 0);
+	for (int k = 0; k < numFrames; k++)
+	{
+		const md2_vertex_t *verts = &frameVerts[(size_t) k * numVertices];
+		for (size_t c = 0; c < meshVerts.size(); c++)
+		{
+			const md2_vertex_t &v = verts[meshVerts[c]];
+			for (int i = 0; i < 3; i++)
+			{
+				frameLo[k*3+i] = std::min(frameLo[k*3+i], v.v[i]);
+				frameHi[k*3+i] = std::max(frameHi[k*3+i], v.v[i]);
+			}
+		}
+	}
+
+	GLfloat allMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, allMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int k = 0; k < numFrames; k++)
+		addFrameBox(&frameLo[k*3], &frameHi[k*3], frameScales[k], allMin, allMax);
+	rt3d::meshBounds all;
+	rt3d::makeBounds(allMin, allMax, all);
+	rt3d::setMeshBounds(mesh, all);
+
+	// models with fewer frames than the standard list get the whole model's bounds for the rest
+	for (int a = 0; a < MD2_ANIMATIONS; a++)
+	{
+		int start = animFrameList[a * 2];
+		int end = std::min(animFrameList[a * 2 + 1], numFrames - 1);
+		if (start > end)
+		{
+			animationBounds[a] = all;
+			continue;
+		}
+		GLfloat min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int k = start; k <= end; k++)
+			addFrameBox(&frameLo[k*3], &frameHi[k*3], frameScales[k], min, max);
+		rt3d::makeBounds(min, max, animationBounds[a]);
+	}
+}
+
+/**
+* Free resources allocated for the file data.
+*/
+static void freeModel (md2_model_t &mdl)
+{
+	int i;
+
+	if (mdl.skins)
+	{
+		free (mdl.skins);
+		mdl.skins = NULL;
+	}
+
+	if (mdl.texcoords)
+	{
+		free (mdl.texcoords);
+		mdl.texcoords = NULL;
+	}
+
+	if (mdl.triangles)
+	{
+		free (mdl.triangles);
+		mdl.triangles = NULL;
+	}
+
+	if (mdl.glcmds)
+	{
+		free (mdl.glcmds);
+		mdl.glcmds = NULL;
+	}
+
+	if (mdl.frames)
+	{
+		for (i = 0; i < mdl.header.num_frames; ++i)
+		{
+			free (mdl.frames[i].verts);
+			mdl.frames[i].verts = NULL;
+		}
+
+		free (mdl.frames);
+		mdl.frames = NULL;
+	}
+}
+
+
+
+md2model::md2model()
+{
+	asset = NULL;
+	state.animation = 0;
+	state.currentFrame = 0;
+	state.nextFrame = 1;
+	state.interp = 0.0f;
+	morphing = false;
+	decodedFrames[0] = decodedFrames[1] = -1;
+	animVerts = NULL;
+	animNormals = NULL;
+}
+
+md2model::md2model(const char *filename)
+{
+	asset = NULL;
+	state.animation = 0;
+	state.currentFrame = 0;
+	state.nextFrame = 1;
+	state.interp = 0.0f;
+	morphing = false;
+	decodedFrames[0] = decodedFrames[1] = -1;
+	animVerts = NULL;
+	animNormals = NULL;
+	ReadMD2Model(filename);
+}
+
+md2model::~md2model()
+{
+	FreeModel();
+}
+
+/**
+* Load a model, sharing its asset with any other instances of the
+* same file. Returns the asset's mesh.
+*/
+GLuint md2model::ReadMD2Model (const char *filename)
+{
+	FreeModel();
+	asset = md2asset::Acquire(filename);
+	if (!asset)
+		return 0;
+
+	// initialise animVerts and animNormals with frame 0 data
+	GLuint vertDataSize = asset->getVertDataSize();
+	animVerts = new GLfloat[vertDataSize * 2];
+	animNormals = animVerts + vertDataSize;
+	asset->decodeFrame(0, animVerts);
+	return asset->getMesh();
+}
+
+/**
+* Release this instance's asset and blended vertices.
+*/
+void md2model::FreeModel ()
+{
+	if (asset)
+	{
+		asset->Release();
+		asset = NULL;
+	}
+	delete [] animVerts;
+	animVerts = NULL;
+	animNormals = NULL;
+	decoded[0].clear();
+	decoded[1].clear();
+	decodedFrames[0] = decodedFrames[1] = -1;
+	morphing = false;
+}
+
+
+
+/**
+* Calculate the current frame in animation, based on
+* selected animation and current frame. If current frame
+* is not in selected animation sequence, new current frame
+* is start of animation sequence. 
+* If interpolation is past 1.0, move current frame to next
+* and next frame = current frame + 1
+*/
+
+void md2model::Animate (int animation, float dt)
+{
+	advanceAnimator(state, animation, dt);
+	if (morphing)
+		return;	// blended in the vertex shader
+	interpolate(getLerpFunction());
+}
+
+/**
+* Switch to another animation, which starts from its first frame on
+* the next Animate - Animate(dt) and AnimateBatch play it from then on.
+* Returns the animation now playing.
+*/
+int md2model::setCurrentAnim(int n)
+{
+	if (n >= 0 && n < MD2_ANIMATIONS)
+		state.animation = n;
+	return state.animation;
+}
+
+/**
+* Animate a batch of models, each in its current animation, with a
+* single pass of the interpolation kernel over all of them.
+*/
+void md2model::AnimateBatch (md2model **models, int count, float dt)
+{
+	lerpFunction lerp = getLerpFunction();
+	for (int i = 0; i < count; i++)
+	{
+		md2model *model = models[i];
+		advanceAnimator(model->state, model->state.animation, dt);
+		if (!model->morphing)
+			model->interpolate(lerp);
+	}
+}
+
+// Job data for AnimateParallel
+struct md2animateJob
+{
+	md2model **models;
+	float dt;
+};
+
+static void animateJob(void *data, const GLuint begin, const GLuint end)
+{
+	md2animateJob *job = (md2animateJob *) data;
+	md2model::AnimateBatch(job->models + begin, end - begin, job->dt);
+}
+
+/**
+* Animate a batch of models on the job system, a chunk of models
+* per job. Each model only writes its own data, so the results are
+* the same for any number of threads.
+*/
+void md2model::AnimateParallel (md2model **models, int count, float dt)
+{
+	md2animateJob job = { models, dt };
+	rt3d::jobGroup group;
+	rt3d::parallelFor(group, animateJob, &job, count, 16);
+	rt3d::waitJobGroup(group);
+}
+
+/**
+* Decode one compressed frame to a float position per mesh vertex,
+* followed by the normals from anorms_table.
+*/
+void md2asset::decodeFrame(int frame, GLfloat *out) const
+{
+	const md2_vertex_t *verts = &frameVerts[(size_t) frame * numVertices];
+	const md2_frameScale_t &fs = frameScales[frame];
+	GLfloat *normals = out + vertDataSize;
+	for (size_t c = 0; c < meshVerts.size(); ++c)
+	{
+		const md2_vertex_t &v = verts[meshVerts[c]];
+		out[c*3] = GLfloat(fs.scale[0] * v.v[0] + fs.translate[0]);
+		out[c*3+1] = GLfloat(fs.scale[1] * v.v[1] + fs.translate[1]);
+		out[c*3+2] = GLfloat(fs.scale[2] * v.v[2] + fs.translate[2]);
+		memcpy(&normals[c*3], anorms_table[v.normalIndex], sizeof(md2vec3));
+	}
+}
+
+/**
+* Fill animVerts and animNormals for the current frames and interp.
+* The two frames are decoded only when they change - most calls just
+* blend them. Blended normals aren't unit length, so shaders should
+* normalize them.
+*/
+void md2model::interpolate(void (*lerp)(const GLfloat *, const GLfloat *, const GLfloat, GLfloat *, const GLuint))
+{
+	GLuint vertDataSize = asset->getVertDataSize();
+	if (decoded[0].empty())
+	{
+		decoded[0].resize(vertDataSize * 2);
+		decoded[1].resize(vertDataSize * 2);
+	}
+	// reuse a decoded frame if it is already held in either slot
+	if (decodedFrames[0] != state.currentFrame && decodedFrames[1] == state.currentFrame)
+	{
+		decoded[0].swap(decoded[1]);
+		std::swap(decodedFrames[0], decodedFrames[1]);
+	}
+	if (decodedFrames[0] != state.currentFrame)
+	{
+		asset->decodeFrame(state.currentFrame, decoded[0].data());
+		decodedFrames[0] = state.currentFrame;
+	}
+	if (state.interp == 0.0f)
+	{
+		memcpy(animVerts, decoded[0].data(), vertDataSize*2*sizeof(float));
+		return;
+	}
+	if (decodedFrames[1] != state.nextFrame)
+	{
+		asset->decodeFrame(state.nextFrame, decoded[1].data());
+		decodedFrames[1] = state.nextFrame;
+	}
+	lerp(decoded[0].data(), decoded[1].data(), state.interp, animVerts, vertDataSize*2);
+}
+
+/**
+* Upload every frame of the model into a buffer texture, for
+* blending in the vertex shader with md2Morph.vert. Returns 0 if
+* the frames are too big for a buffer texture.
+*/
+GLuint md2asset::createMorphTexture()
+{
+	if (morphTexture)
+		return morphTexture;
+	GLint maxTexels;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	size_t frameSize = vertDataSize * 2;
+	size_t texels = frameSize * frameScales.size();
+	if (texels > (size_t) maxTexels)
+		return 0;
+
+	// each frame is decoded as animVerts would be, then stored as the position and normal of
+	// each mesh vertex in turn, so the shader finds a vertex's normal right after its position
+	glGenBuffers(1, &morphBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, morphBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, texels * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+	std::vector<GLfloat> frame(frameSize), interleaved(frameSize);
+	for (size_t k = 0; k < frameScales.size(); k++)
+	{
+		decodeFrame((int) k, frame.data());
+		for (size_t v = 0; v < vertDataSize; v += 3)
+		{
+			memcpy(&interleaved[v*2], &frame[v], sizeof(md2vec3));
+			memcpy(&interleaved[v*2+3], &frame[vertDataSize + v], sizeof(md2vec3));
+		}
+		glBufferSubData(GL_TEXTURE_BUFFER, k * frameSize * sizeof(GLfloat), frameSize * sizeof(GLfloat), interleaved.data());
+	}
+
+	// one float per texel, as 3 component buffer textures need GL 4
+	glGenTextures(1, &morphTexture);
+	rt3d::bindTexture(MD2_MORPH_TEXTURE_UNIT, GL_TEXTURE_BUFFER, morphTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, morphBuffer);
+	return morphTexture;
+}
+
+// Locations of the per draw uniforms of a morph program
+struct md2morphUniforms
+{
+	GLint current;
+	GLint next;
+	GLint interp;
+};
+
+// Looked up once per program
+static std::map<GLuint, md2morphUniforms> morphPrograms;
+
+/**
+* Get the morph uniform locations of an md2Morph.vert program. The
+* first time a program is seen its locations are looked up, and its
+* morphFrames sampler is pointed at MD2_MORPH_TEXTURE_UNIT for good -
+* so the program is made current if it isn't already.
+*/
+static const md2morphUniforms& getMorphUniforms(GLuint program)
+{
+	auto found = morphPrograms.find(program);
+	if (found != morphPrograms.end())
+		return found->second;
+	md2morphUniforms &uniforms = morphPrograms[program];
+	uniforms.current = rt3d::getUniformLocation(program, "morphCurrent");
+	uniforms.next = rt3d::getUniformLocation(program, "morphNext");
+	uniforms.interp = rt3d::getUniformLocation(program, "morphInterp");
+	rt3d::useProgram(program);
+	rt3d::setUniform1i(rt3d::getUniformLocation(program, "morphFrames"), MD2_MORPH_TEXTURE_UNIT);
+	return uniforms;
+}
+
+/**
+* Set the morph uniforms of the given (md2Morph.vert) program
+* for an animator's current frames - call before drawing it.
+*/
+void md2asset::setMorphUniforms(GLuint program, const md2animator &animator) const
+{
+	const md2morphUniforms &uniforms = getMorphUniforms(program);
+	rt3d::bindTexture(MD2_MORPH_TEXTURE_UNIT, GL_TEXTURE_BUFFER, morphTexture);
+	rt3d::setUniform1i(uniforms.current, animator.currentFrame * vertDataSize * 2);
+	rt3d::setUniform1i(uniforms.next, animator.nextFrame * vertDataSize * 2);
+	rt3d::setUniform1f(uniforms.interp, animator.interp);
+}
+
+/**
+* Blend this model on the GPU from now on, with md2Morph.vert.
+* Animate only steps the frame counters, animVerts is not updated,
+* and setMorphUniforms passes the frames and weight to the shader.
+* Returns 0 (leaving the model blended on the CPU) if the frames
+* are too big for a buffer texture.
+*/
+GLuint md2model::createMorphTexture()
+{
+	GLuint texture = asset->createMorphTexture();
+	morphing = texture != 0;
+	return texture;
+}
+
+/**
+* Set the morph uniforms of the given (md2Morph.vert) program
+* for this model's current frames - call before drawing it.
+*/
+void md2model::setMorphUniforms(GLuint program)
+{
+	asset->setMorphUniforms(program, state);
+}
+
+/**
+* Add an animator playing the given animation from its start,
+* returning its number.
+*/
+int md2animatorSet::add(int anim)
+{
+	animation.push_back(anim);
+	startFrame.push_back(animFrameList[anim * 2]);
+	endFrame.push_back(animFrameList[anim * 2 + 1]);
+	currentFrame.push_back(0);
+	nextFrame.push_back(1);
+	interp.push_back(0.0f);
+	return size() - 1;
+}
+
+void md2animatorSet::clear()
+{
+	animation.clear();
+	startFrame.clear();
+	endFrame.clear();
+	currentFrame.clear();
+	nextFrame.clear();
+	interp.clear();
+}
+
+/**
+* Switch an animator to another animation - it jumps to the start
+* of it on the next Animate, as md2model does.
+*/
+void md2animatorSet::setAnimation(int i, int anim)
+{
+	animation[i] = anim;
+	startFrame[i] = animFrameList[anim * 2];
+	endFrame[i] = animFrameList[anim * 2 + 1];
+}
+
+md2animator md2animatorSet::get(int i) const
+{
+	md2animator a = { animation[i], currentFrame[i], nextFrame[i], interp[i] };
+	return a;
+}
+
+/**
+* Step every animator on by dt, exactly as md2model::Animate does,
+* with selects in place of branches so compilers can vectorise
+* the loop.
+*/
+void md2animatorSet::Animate(float dt)
+{
+	int count = size();
+	const int *start = startFrame.data();
+	const int *end = endFrame.data();
+	int *current = currentFrame.data();
+	int *next = nextFrame.data();
+	float *t = interp.data();
+	for (int i = 0; i < count; i++)
+	{
+		bool restart = (current[i] < start[i]) | (current[i] > end[i]);
+		int c = restart ? start[i] : current[i];
+		int n = restart ? start[i] + 1 : next[i];
+		float f = t[i] + dt;
+		bool step = f >= 1.0f;
+		int following = (n + 1 >= end[i] + 1) ? start[i] : n + 1;
+		current[i] = step ? n : c;
+		next[i] = step ? following : n;
+		t[i] = step ? 0.0f : f;
+	}
+}
+
@@ -1,298 +1,1094 @@
-#include "rt3d.h"
-#include <map>
-
-using namespace std;
-
-namespace rt3d {
-
-// struct vaoBuffers will be used inside the rt3d library
-// clients should not need to know about this data structure
-struct vaoBuffers {
-	GLuint vertex_buffer;
-	GLuint colour_buffer;
-	GLuint normal_buffer;
-	GLuint texcoord_buffer;
-	GLuint index_buffer;
-};
-
-static map<GLuint, GLuint *> vertexArrayMap;
-
-// Something went wrong - print error message and quit
-void exitFatalError(const char *message) {
-    cout << message << " ";
-    exit(1);
-}
-
-// loadFile - loads text file from file fname as a char* 
-// Allocates memory - so remember to delete after use
-// size of file returned in fSize
-char* loadFile(const char *fname, GLint &fSize) {
-	int size;
-	char * memblock;
-
-	// file read based on example in cplusplus.com tutorial
-	// ios::ate opens file at the end
-	ifstream file (fname, ios::in|ios::binary|ios::ate);
-	if (file.is_open()) {
-		size = (int) file.tellg(); // get location of file pointer i.e. file size
-		fSize = (GLint) size;
-		memblock = new char [size];
-		file.seekg (0, ios::beg);
-		file.read (memblock, size);
-		file.close();
-		cout << "file " << fname << " loaded" << endl;
-	}
-	else {
-		cout << "Unable to open file " << fname << endl;
-		fSize = 0;
-		// should ideally set a flag or use exception handling
-		// so that calling function can decide what to do now
-		return nullptr;
-	}
-	return memblock;
-}
-
-// printShaderError
-// Display (hopefully) useful error messages if shader fails to compile or link
-void printShaderError(const GLint shader) {
-	int maxLength = 0;
-	int logLength = 0;
-	GLchar *logMessage;
-
-	// Find out how long the error message is
-	if (!glIsShader(shader))
-		glGetProgramiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
-	else
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
-
-	if (maxLength > 0) { // If message has some contents
-		logMessage = new GLchar[maxLength];
-		if (!glIsShader(shader))
-			glGetProgramInfoLog(shader, maxLength, &logLength, logMessage);
-		else
-			glGetShaderInfoLog(shader,maxLength, &logLength, logMessage);
-		cout << "Shader Info Log:" << endl << logMessage << endl;
-		delete [] logMessage;
-	}
-	// should additionally check for OpenGL errors here
-}
-
-
-GLuint initShaders(const char *vertFile, const char *fragFile) {
-	GLuint p, f, v;
-
-	char *vs,*fs;
-
-	v = glCreateShader(GL_VERTEX_SHADER);
-	f = glCreateShader(GL_FRAGMENT_SHADER);	
-
-	// load shaders & get length of each
-	GLint vlen;
-	GLint flen;
-	vs = loadFile(vertFile,vlen);
-	fs = loadFile(fragFile,flen);
-	
-	const char * vv = vs;
-	const char * ff = fs;
-
-	glShaderSource(v, 1, &vv,&vlen);
-	glShaderSource(f, 1, &ff,&flen);
-	
-	GLint compiled;
-
-	glCompileShader(v);
-	glGetShaderiv(v, GL_COMPILE_STATUS, &compiled);
-	if (!compiled) {
-		cout << "Vertex shader not compiled." << endl;
-		rt3d::printShaderError(v);
-	} 
-
-	glCompileShader(f);
-	glGetShaderiv(f, GL_COMPILE_STATUS, &compiled);
-	if (!compiled) {
-		cout << "Fragment shader not compiled." << endl;
-		rt3d::printShaderError(f);
-	} 
-	
-	p = glCreateProgram();
-		
-	glAttachShader(p,v);
-	glAttachShader(p,f);
-
-	glBindAttribLocation(p,RT3D_VERTEX,"in_Position");
-	glBindAttribLocation(p,RT3D_COLOUR,"in_Color");
-	glBindAttribLocation(p,RT3D_NORMAL,"in_Normal");
-	glBindAttribLocation(p,RT3D_TEXCOORD,"in_TexCoord");
-
-	glLinkProgram(p);
-	glUseProgram(p);
-
-	delete [] vs; // dont forget to free allocated memory
-	delete [] fs; // we allocated this in the loadFile function...
-
-	return p;
-}
-
-GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, 
-	const GLfloat* normals, const GLfloat* texcoords, const GLuint indexCount, const GLuint* indices) {
-	GLuint VAO;
-	// generate and set up a VAO for the mesh
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	GLuint *pMeshBuffers = new GLuint[5];
-
-
-	if (vertices == nullptr) {
-		// cant create a mesh without vertices... oops
-		exitFatalError("Attempt to create a mesh with no vertices");
-	}
-
-	// generate and set up the VBOs for the data
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
-	
-	// VBO for vertex data
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer((GLuint)RT3D_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, 0); 
-	glEnableVertexAttribArray(RT3D_VERTEX);
-	pMeshBuffers[RT3D_VERTEX] = VBO;
-
-
-	// VBO for colour data
-	if (colours != nullptr) {
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), colours, GL_STATIC_DRAW);
-		glVertexAttribPointer((GLuint)RT3D_COLOUR, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(RT3D_COLOUR);
-		pMeshBuffers[RT3D_COLOUR] = VBO;
-	}
-
-	// VBO for normal data
-	if (normals != nullptr) {
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), normals, GL_STATIC_DRAW);
-		glVertexAttribPointer((GLuint)RT3D_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(RT3D_NORMAL);
-		pMeshBuffers[RT3D_NORMAL] = VBO;
-	}
-
-	// VBO for tex-coord data
-	if (texcoords != nullptr) {
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, 2*numVerts*sizeof(GLfloat), texcoords, GL_STATIC_DRAW);
-		glVertexAttribPointer((GLuint)RT3D_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(RT3D_TEXCOORD);
-		pMeshBuffers[RT3D_TEXCOORD] = VBO;
-	}
-
-	if (indices != nullptr && indexCount > 0) {
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), indices, GL_STATIC_DRAW);
-		pMeshBuffers[RT3D_INDEX] = VBO;
-	}
-	// unbind vertex array
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	// return the identifier needed to draw this mesh
-
-	vertexArrayMap.insert( pair<GLuint, GLuint *>(VAO, pMeshBuffers) );
-
-	return VAO;
-}
-
-GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, 
-	const GLfloat* normals, const GLfloat* texcoords) {
-	return createMesh(numVerts, vertices, colours, normals, texcoords, 0, nullptr);
-}
-
-GLuint createMesh(const GLuint numVerts, const GLfloat* vertices) {
-	return createMesh(numVerts, vertices, nullptr, nullptr, nullptr);
-}
-
-GLuint createColourMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours) {
-	return createMesh(numVerts, vertices, colours, nullptr, nullptr);
-}
-
-void setUniformMatrix4fv(const GLuint program, const char* uniformName, const GLfloat *data) {
-	int uniformIndex = glGetUniformLocation(program, uniformName);
-	glUniformMatrix4fv(uniformIndex, 1, GL_FALSE, data); 
-}
-
-
-void setLightPos(const GLuint program, const GLfloat *lightPos) {
-	int uniformIndex = glGetUniformLocation(program, "lightPosition");
-	glUniform4fv(uniformIndex, 1, lightPos);
-}
-
-void setProjection(const GLuint program, const GLfloat *data) {
-	int uniformIndex = glGetUniformLocation(program, "projection");
-	glUniformMatrix4fv(uniformIndex, 1, GL_FALSE, data); 
-}
-
-void setLight(const GLuint program, const lightStruct light) {
-	// pass in light data to shader
-	int uniformIndex = glGetUniformLocation(program, "light.ambient");
-	glUniform4fv(uniformIndex, 1, light.ambient);
-	uniformIndex = glGetUniformLocation(program, "light.diffuse");
-	glUniform4fv(uniformIndex, 1, light.diffuse);
-	uniformIndex = glGetUniformLocation(program, "light.specular");
-	glUniform4fv(uniformIndex, 1, light.specular);
-	uniformIndex = glGetUniformLocation(program, "lightPosition");
-	glUniform4fv(uniformIndex, 1, light.position);
-}
-
-
-void setMaterial(const GLuint program, const materialStruct material) {
-	// pass in material data to shader 
-	int uniformIndex = glGetUniformLocation(program, "material.ambient");
-	glUniform4fv(uniformIndex, 1, material.ambient);
-	uniformIndex = glGetUniformLocation(program, "material.diffuse");
-	glUniform4fv(uniformIndex, 1, material.diffuse);
-	uniformIndex = glGetUniformLocation(program, "material.specular");
-	glUniform4fv(uniformIndex, 1, material.specular);
-	uniformIndex = glGetUniformLocation(program, "material.shininess");
-	glUniform1f(uniformIndex, material.shininess);
-}
-
-void drawMesh(const GLuint mesh, const GLuint numVerts, const GLuint primitive) {
-	glBindVertexArray(mesh);	// Bind mesh VAO
-	glDrawArrays(primitive, 0, numVerts);	// draw first vertex array object
-	glBindVertexArray(0);
-}
-
-
-void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive) {
-	glBindVertexArray(mesh);	// Bind mesh VAO
-	glDrawElements(primitive, indexCount,  GL_UNSIGNED_INT, 0);	// draw VAO 
-	glBindVertexArray(0);
-}
-
-
-void updateMesh(const GLuint mesh, const unsigned int bufferType, const GLfloat *data, const GLuint size) {
-	GLuint * pMeshBuffers = vertexArrayMap[mesh];
-	glBindVertexArray(mesh);
-
-	// Delete the old buffer data
-	glDeleteBuffers(1, &pMeshBuffers[bufferType]);
-
-	// generate and set up the VBOs for the new data
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
-		// VBO for the data
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, size*sizeof(GLfloat), data, GL_STATIC_DRAW);
-	glVertexAttribPointer((GLuint)bufferType, 3, GL_FLOAT, GL_FALSE, 0, 0); 
-	glEnableVertexAttribArray(bufferType);
-	pMeshBuffers[RT3D_VERTEX] = VBO;
-
-	glBindVertexArray(0);
-
-}
-
+#include "rt3d.h"
+#include <map>
+#include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace rt3d {
+
+// struct vaoBuffers will be used inside the rt3d library
+// clients should not need to know about this data structure
+struct vaoBuffers {
+	GLuint vertex_buffer;
+	GLuint colour_buffer;
+	GLuint normal_buffer;
+	GLuint texcoord_buffer;
+	GLuint index_buffer;
+};
+
+// per mesh buffer IDs, indexed by RT3D_VERTEX .. RT3D_INDEX, plus the GL type of the indices
+#define RT3D_INDEX_TYPE 5
+#define RT3D_MESH_BUFFERS 6
+static map<GLuint, GLuint *> vertexArrayMap;
+static map<GLuint, meshBounds> meshBoundsMap;
+
+// Shadow copy of the GL state set through rt3d - RT3D_UNKNOWN_STATE always forces the next call through
+#define RT3D_UNKNOWN_STATE 0xFFFFFFFF
+struct stateCache {
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeTexture;
+	GLuint textures[RT3D_TEXTURE_UNITS][2];	// GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP
+	GLuint cullFace;
+	GLuint depthTest;
+	GLuint blend;
+	GLuint cullFaceMode;
+	GLuint depthMask;
+};
+static stateCache state;
+static bool stateCacheValid = false;
+
+// Something went wrong - print error message and quit
+void exitFatalError(const char *message) {
+    cout << message << " ";
+    exit(1);
+}
+
+// loadFile - loads text file from file fname as a char* 
+// Allocates memory - so remember to delete after use
+// size of file returned in fSize
+char* loadFile(const char *fname, GLint &fSize) {
+	int size;
+	char * memblock;
+
+	// file read based on example in cplusplus.com tutorial
+	// ios::ate opens file at the end
+	ifstream file (fname, ios::in|ios::binary|ios::ate);
+	if (file.is_open()) {
+		size = (int) file.tellg(); // get location of file pointer i.e. file size
+		fSize = (GLint) size;
+		memblock = new char [size];
+		file.seekg (0, ios::beg);
+		file.read (memblock, size);
+		file.close();
+		cout << "file " << fname << " loaded" << endl;
+	}
+	else {
+		cout << "Unable to open file " << fname << endl;
+		fSize = 0;
+		// should ideally set a flag or use exception handling
+		// so that calling function can decide what to do now
+		return nullptr;
+	}
+	return memblock;
+}
+
+// mapFile - maps file fname read-only into memory, without copying it
+// The returned data is NOT null terminated, and must be released with unmapFile
+// rather than delete. Size of file returned in fSize
+const char* mapFile(const char *fname, size_t &fSize) {
+	const char *data = nullptr;
+	fSize = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping); // the view keeps the mapping alive
+			}
+			if (data)
+				fSize = (size_t) size.QuadPart;
+		}
+		CloseHandle(file);
+	}
+#else
+	int fd = open(fname, O_RDONLY);
+	if (fd >= 0) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void *addr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED) {
+				madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+				data = (const char *) addr;
+				fSize = (size_t) st.st_size;
+			}
+		}
+		close(fd); // the mapping stays valid after the descriptor is closed
+	}
+#endif
+	if (data)
+		cout << "file " << fname << " mapped" << endl;
+	else
+		cout << "Unable to map file " << fname << endl;
+	return data;
+}
+
+// unmapFile - releases memory returned by mapFile
+void unmapFile(const char *data, const size_t fSize) {
+	if (data == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void *) data, fSize);
+#endif
+}
+
+// printShaderError
+// Display (hopefully) useful error messages if shader fails to compile or link
+void printShaderError(const GLint shader) {
+	int maxLength = 0;
+	int logLength = 0;
+	GLchar *logMessage;
+
+	// Find out how long the error message is
+	if (!glIsShader(shader))
+		glGetProgramiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+	else
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+	if (maxLength > 0) { // If message has some contents
+		logMessage = new GLchar[maxLength];
+		if (!glIsShader(shader))
+			glGetProgramInfoLog(shader, maxLength, &logLength, logMessage);
+		else
+			glGetShaderInfoLog(shader,maxLength, &logLength, logMessage);
+		cout << "Shader Info Log:" << endl << logMessage << endl;
+		delete [] logMessage;
+	}
+	// should additionally check for OpenGL errors here
+}
+
+
+// Uniform reflection tables, one per program linked by initShaders - locations are read once at
+// link time so that the setters below never have to ask GL to look up a name
+struct programInfo {
+	map<string, GLint> locations;
+	programUniforms uniforms;
+};
+static map<GLuint, programInfo> programMap;
+
+static renderStats stats = {};
+
+static GLint findLocation(const programInfo &info, const char *uniformName) {
+	auto itr = info.locations.find(uniformName);
+	return (itr != info.locations.end()) ? itr->second : -1;
+}
+
+static const char *uniformBlockNames[RT3D_UNIFORM_BLOCKS] = { "cameraBlock", "lightBlock", "materialBlock",
+	"materialArrayBlock" };
+
+static void reflectUniforms(const GLuint program) {
+	programInfo &info = programMap[program];
+	info.locations.clear();
+
+	// attach the shared blocks to their fixed binding points (GLSL 3.30 has no layout(binding))
+	for (GLuint i = 0; i < RT3D_UNIFORM_BLOCKS; i++) {
+		GLuint blockIndex = glGetUniformBlockIndex(program, uniformBlockNames[i]);
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, blockIndex, i);
+	}
+
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	vector<GLchar> name(maxLength + 1);
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(program, i, maxLength + 1, &length, &size, &type, name.data());
+		string uniformName(name.data(), length);
+		GLint location = glGetUniformLocation(program, uniformName.c_str());
+		stats.uniformLocationQueries++;
+		if (location < 0)
+			continue; // members of uniform blocks have no location
+		info.locations[uniformName] = location;
+		// arrays are reported as name[0], but can be looked up by just their name too
+		size_t bracket = uniformName.rfind("[0]");
+		if (bracket != string::npos && bracket + 3 == uniformName.size())
+			info.locations[uniformName.substr(0, bracket)] = location;
+	}
+
+	programUniforms &u = info.uniforms;
+	u.modelview = findLocation(info, "modelview");
+	u.projection = findLocation(info, "projection");
+	u.modelMatrix = findLocation(info, "modelMatrix");
+	u.view = findLocation(info, "view");
+	u.lightPosition = findLocation(info, "lightPosition");
+	u.lightAmbient = findLocation(info, "light.ambient");
+	u.lightDiffuse = findLocation(info, "light.diffuse");
+	u.lightSpecular = findLocation(info, "light.specular");
+	u.materialAmbient = findLocation(info, "material.ambient");
+	u.materialDiffuse = findLocation(info, "material.diffuse");
+	u.materialSpecular = findLocation(info, "material.specular");
+	u.materialShininess = findLocation(info, "material.shininess");
+}
+
+GLuint initShaders(const char *vertFile, const char *fragFile) {
+	GLuint p, f, v;
+
+	char *vs,*fs;
+
+	v = glCreateShader(GL_VERTEX_SHADER);
+	f = glCreateShader(GL_FRAGMENT_SHADER);	
+
+	// load shaders & get length of each
+	GLint vlen;
+	GLint flen;
+	vs = loadFile(vertFile,vlen);
+	fs = loadFile(fragFile,flen);
+	
+	const char * vv = vs;
+	const char * ff = fs;
+
+	glShaderSource(v, 1, &vv,&vlen);
+	glShaderSource(f, 1, &ff,&flen);
+	
+	GLint compiled;
+
+	glCompileShader(v);
+	glGetShaderiv(v, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		cout << "Vertex shader not compiled." << endl;
+		rt3d::printShaderError(v);
+	} 
+
+	glCompileShader(f);
+	glGetShaderiv(f, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		cout << "Fragment shader not compiled." << endl;
+		rt3d::printShaderError(f);
+	} 
+	
+	p = glCreateProgram();
+		
+	glAttachShader(p,v);
+	glAttachShader(p,f);
+
+	glBindAttribLocation(p,RT3D_VERTEX,"in_Position");
+	glBindAttribLocation(p,RT3D_COLOUR,"in_Color");
+	glBindAttribLocation(p,RT3D_NORMAL,"in_Normal");
+	glBindAttribLocation(p,RT3D_TEXCOORD,"in_TexCoord");
+	glBindAttribLocation(p,RT3D_INSTANCE_MATRIX,"in_ModelMatrix");
+	glBindAttribLocation(p,RT3D_INSTANCE_MATERIAL,"in_MaterialIndex");
+
+	glLinkProgram(p);
+	useProgram(p);
+	reflectUniforms(p);
+
+	delete [] vs; // dont forget to free allocated memory
+	delete [] fs; // we allocated this in the loadFile function...
+
+	return p;
+}
+
+GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, 
+	const GLfloat* normals, const GLfloat* texcoords, const GLuint indexCount, const GLuint* indices) {
+	GLuint VAO;
+	// generate and set up a VAO for the mesh
+	glGenVertexArrays(1, &VAO);
+	bindVertexArray(VAO);
+
+	GLuint *pMeshBuffers = new GLuint[RT3D_MESH_BUFFERS];
+	for (int i = 0; i < RT3D_MESH_BUFFERS; i++)
+		pMeshBuffers[i] = 0;
+	pMeshBuffers[RT3D_INDEX_TYPE] = GL_UNSIGNED_INT;
+
+
+	if (vertices == nullptr) {
+		// cant create a mesh without vertices... oops
+		exitFatalError("Attempt to create a mesh with no vertices");
+	}
+
+	// generate and set up the VBOs for the data
+	GLuint VBO;
+	glGenBuffers(1, &VBO);
+	
+	// VBO for vertex data
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+	glVertexAttribPointer((GLuint)RT3D_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, 0); 
+	glEnableVertexAttribArray(RT3D_VERTEX);
+	pMeshBuffers[RT3D_VERTEX] = VBO;
+
+
+	// VBO for colour data
+	if (colours != nullptr) {
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), colours, GL_STATIC_DRAW);
+		glVertexAttribPointer((GLuint)RT3D_COLOUR, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(RT3D_COLOUR);
+		pMeshBuffers[RT3D_COLOUR] = VBO;
+	}
+
+	// VBO for normal data
+	if (normals != nullptr) {
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, 3*numVerts*sizeof(GLfloat), normals, GL_STATIC_DRAW);
+		glVertexAttribPointer((GLuint)RT3D_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(RT3D_NORMAL);
+		pMeshBuffers[RT3D_NORMAL] = VBO;
+	}
+
+	// VBO for tex-coord data
+	if (texcoords != nullptr) {
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, 2*numVerts*sizeof(GLfloat), texcoords, GL_STATIC_DRAW);
+		glVertexAttribPointer((GLuint)RT3D_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(RT3D_TEXCOORD);
+		pMeshBuffers[RT3D_TEXCOORD] = VBO;
+	}
+
+	if (indices != nullptr && indexCount > 0) {
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), indices, GL_STATIC_DRAW);
+		pMeshBuffers[RT3D_INDEX] = VBO;
+	}
+	// unbind vertex array
+	bindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// return the identifier needed to draw this mesh
+
+	vertexArrayMap.insert( pair<GLuint, GLuint *>(VAO, pMeshBuffers) );
+
+	meshBounds bounds;
+	if (computeBounds(numVerts, vertices, bounds))
+		setMeshBounds(VAO, bounds);
+
+	return VAO;
+}
+
+GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, 
+	const GLfloat* normals, const GLfloat* texcoords) {
+	return createMesh(numVerts, vertices, colours, normals, texcoords, 0, nullptr);
+}
+
+GLuint createMesh(const GLuint numVerts, const GLfloat* vertices) {
+	return createMesh(numVerts, vertices, nullptr, nullptr, nullptr);
+}
+
+GLuint createColourMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours) {
+	return createMesh(numVerts, vertices, colours, nullptr, nullptr);
+}
+
+// append an attribute to the end of a vertex format - offsets are kept 4 byte aligned
+void addVertexAttrib(vertexFormat &format, const GLuint index, const GLint size, const GLenum type, const GLboolean normalized) {
+	if (format.numAttribs >= RT3D_MAX_ATTRIBS)
+		exitFatalError("Too many attributes in vertex format");
+	GLuint attribSize;
+	switch (type) {
+		case GL_BYTE: case GL_UNSIGNED_BYTE: attribSize = size; break;
+		case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: attribSize = size * 2; break;
+		case GL_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: attribSize = 4; break; // all 4 components in one word
+		default: attribSize = size * 4;
+	}
+	vertexAttribFormat &attrib = format.attribs[format.numAttribs++];
+	attrib.index = index;
+	attrib.size = size;
+	attrib.type = type;
+	attrib.normalized = normalized;
+	attrib.offset = format.stride;
+	format.stride += (attribSize + 3) & ~3u;
+}
+
+// the standard all-float layout, attributes in RT3D_* order
+vertexFormat makeVertexFormat(const bool colours, const bool normals, const bool texcoords) {
+	vertexFormat format = {};
+	addVertexAttrib(format, RT3D_VERTEX, 3, GL_FLOAT, GL_FALSE);
+	if (colours)
+		addVertexAttrib(format, RT3D_COLOUR, 3, GL_FLOAT, GL_FALSE);
+	if (normals)
+		addVertexAttrib(format, RT3D_NORMAL, 3, GL_FLOAT, GL_FALSE);
+	if (texcoords)
+		addVertexAttrib(format, RT3D_TEXCOORD, 2, GL_FLOAT, GL_FALSE);
+	return format;
+}
+
+// interleaveVertices - copies separate attribute arrays into one interleaved block
+// out must have room for numVerts * format.stride bytes. Only GL_FLOAT attributes are supported
+void interleaveVertices(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
+	const GLfloat* texcoords, const vertexFormat &format, void *out) {
+	const GLfloat *sources[RT3D_MAX_ATTRIBS] = { vertices, colours, normals, texcoords };
+	for (GLuint a = 0; a < format.numAttribs; a++) {
+		const vertexAttribFormat &attrib = format.attribs[a];
+		const GLfloat *src = sources[attrib.index];
+		if (src == nullptr || attrib.type != GL_FLOAT)
+			exitFatalError("Attempt to interleave an attribute with no float data");
+		char *dst = (char *) out + attrib.offset;
+		for (GLuint v = 0; v < numVerts; v++, dst += format.stride)
+			memcpy(dst, src + v * attrib.size, attrib.size * sizeof(GLfloat));
+	}
+}
+
+// createInterleavedMesh - as createMesh, but with every attribute read from a single VBO
+// Indices may be GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+// Meshes created like this can't be changed with updateMesh
+GLuint createInterleavedMesh(const GLuint numVerts, const void* vertexData, const vertexFormat &format,
+	const GLuint indexCount, const void* indices, const GLenum indexType) {
+	if (vertexData == nullptr) {
+		// cant create a mesh without vertices... oops
+		exitFatalError("Attempt to create a mesh with no vertices");
+	}
+
+	GLuint VAO;
+	glGenVertexArrays(1, &VAO);
+	bindVertexArray(VAO);
+
+	GLuint *pMeshBuffers = new GLuint[RT3D_MESH_BUFFERS];
+	for (int i = 0; i < RT3D_MESH_BUFFERS; i++)
+		pMeshBuffers[i] = 0;
+	pMeshBuffers[RT3D_INDEX_TYPE] = indexType;
+
+	// one VBO for all the vertex data, with each attribute pointing at its own offset
+	GLuint VBO;
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, numVerts * format.stride, vertexData, GL_STATIC_DRAW);
+	for (GLuint a = 0; a < format.numAttribs; a++) {
+		const vertexAttribFormat &attrib = format.attribs[a];
+		glVertexAttribPointer(attrib.index, attrib.size, attrib.type, attrib.normalized, format.stride,
+			(const GLvoid *) (size_t) attrib.offset);
+		glEnableVertexAttribArray(attrib.index);
+	}
+	pMeshBuffers[RT3D_VERTEX] = VBO;
+
+	if (indices != nullptr && indexCount > 0) {
+		GLuint indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+		pMeshBuffers[RT3D_INDEX] = VBO;
+	}
+	bindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	vertexArrayMap.insert( pair<GLuint, GLuint *>(VAO, pMeshBuffers) );
+
+	meshBounds bounds;
+	if (computeBounds(numVerts, vertexData, format, bounds))
+		setMeshBounds(VAO, bounds);
+
+	return VAO;
+}
+
+GLuint createInterleavedMesh(const GLuint numVerts, const void* vertexData, const vertexFormat &format,
+	const GLuint indexCount, const GLuint* indices) {
+	return createInterleavedMesh(numVerts, vertexData, format, indexCount, indices, GL_UNSIGNED_INT);
+}
+
+static GLshort packSnorm16(GLfloat value) {
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return (GLshort) floor(value * 32767.0f + 0.5f);
+}
+
+// pack a unit vector into GL_INT_2_10_10_10_REV, decoded by the normalized attribute fetch
+static GLuint packNormal1010102(const GLfloat *n) {
+	GLuint packed = 0;
+	for (int i = 0; i < 3; i++) {
+		GLfloat c = n[i] < -1.0f ? -1.0f : (n[i] > 1.0f ? 1.0f : n[i]);
+		GLint q = (GLint) floor(c * 511.0f + 0.5f);
+		packed |= ((GLuint) q & 0x3FF) << (10 * i);
+	}
+	return packed;
+}
+
+// packVertices - quantizes a float mesh into a compact interleaved layout
+// snorm16 positions (about 2x smaller), 10_10_10_2 normals (3x) and unorm16 tex coords (2x) -
+// tex coords outside 0..1 stay as floats, as they can't be represented. Indices drop to
+// 16 bit when the mesh has no more than 65536 vertices. Normals and tex coords need no
+// shader changes, as the normalized fetch decodes them, but positions must be decoded with
+// positionScale and positionBias - see packedVertices
+void packVertices(const GLuint numVerts, const GLfloat* vertices, const GLfloat* normals, const GLfloat* texcoords,
+	const GLuint indexCount, const GLuint* indices, packedVertices &packed) {
+	if (vertices == nullptr || numVerts == 0)
+		exitFatalError("Attempt to pack a mesh with no vertices");
+
+	GLfloat minPos[3] = { vertices[0], vertices[1], vertices[2] };
+	GLfloat maxPos[3] = { vertices[0], vertices[1], vertices[2] };
+	for (GLuint v = 1; v < numVerts; v++)
+		for (int i = 0; i < 3; i++) {
+			if (vertices[v*3+i] < minPos[i]) minPos[i] = vertices[v*3+i];
+			if (vertices[v*3+i] > maxPos[i]) maxPos[i] = vertices[v*3+i];
+		}
+	GLfloat scale = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		packed.positionBias[i] = 0.5f * (minPos[i] + maxPos[i]);
+		if (0.5f * (maxPos[i] - minPos[i]) > scale)
+			scale = 0.5f * (maxPos[i] - minPos[i]);
+	}
+	if (scale == 0.0f)
+		scale = 1.0f;
+	packed.positionScale[0] = packed.positionScale[1] = packed.positionScale[2] = scale;
+
+	bool unormTexCoords = texcoords != nullptr;
+	for (GLuint t = 0; unormTexCoords && t < numVerts * 2; t++)
+		unormTexCoords = texcoords[t] >= 0.0f && texcoords[t] <= 1.0f;
+
+	vertexFormat &format = packed.format;
+	format.stride = 0;
+	format.numAttribs = 0;
+	addVertexAttrib(format, RT3D_VERTEX, 3, GL_SHORT, GL_TRUE);
+	if (normals)
+		addVertexAttrib(format, RT3D_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE);
+	if (texcoords)
+		addVertexAttrib(format, RT3D_TEXCOORD, 2, unormTexCoords ? GL_UNSIGNED_SHORT : GL_FLOAT, unormTexCoords);
+
+	packed.vertexData.assign(numVerts * format.stride, 0);
+	for (GLuint v = 0; v < numVerts; v++) {
+		char *vertex = packed.vertexData.data() + v * format.stride;
+		for (GLuint a = 0; a < format.numAttribs; a++) {
+			const vertexAttribFormat &attrib = format.attribs[a];
+			char *dst = vertex + attrib.offset;
+			if (attrib.index == RT3D_VERTEX) {
+				GLshort q[3];
+				for (int i = 0; i < 3; i++)
+					q[i] = packSnorm16((vertices[v*3+i] - packed.positionBias[i]) / scale);
+				memcpy(dst, q, sizeof(q));
+			}
+			else if (attrib.index == RT3D_NORMAL) {
+				GLuint n = packNormal1010102(normals + v*3);
+				memcpy(dst, &n, sizeof(n));
+			}
+			else if (attrib.type == GL_UNSIGNED_SHORT) {
+				GLushort q[2];
+				for (int i = 0; i < 2; i++)
+					q[i] = (GLushort) floor(texcoords[v*2+i] * 65535.0f + 0.5f);
+				memcpy(dst, q, sizeof(q));
+			}
+			else
+				memcpy(dst, texcoords + v*2, 2 * sizeof(GLfloat));
+		}
+	}
+
+	packed.indexType = (numVerts <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (packed.indexType == GL_UNSIGNED_SHORT) {
+		packed.indexData.resize(indexCount * sizeof(GLushort));
+		GLushort *dst = (GLushort *) packed.indexData.data();
+		for (GLuint i = 0; i < indexCount; i++)
+			dst[i] = (GLushort) indices[i];
+	}
+	else {
+		packed.indexData.resize(indexCount * sizeof(GLuint));
+		if (indexCount > 0)
+			memcpy(packed.indexData.data(), indices, indexCount * sizeof(GLuint));
+	}
+}
+
+// reads one vertex position, as either floats or the 16 bit values packVertices writes
+static bool readPosition(const char *vertex, const vertexAttribFormat &attrib, GLfloat *position) {
+	for (GLint i = 0; i < 3; i++) {
+		if (i >= attrib.size) {
+			position[i] = 0.0f;
+			continue;
+		}
+		if (attrib.type == GL_FLOAT)
+			memcpy(&position[i], vertex + attrib.offset + i * sizeof(GLfloat), sizeof(GLfloat));
+		else if (attrib.type == GL_SHORT) {
+			GLshort value;
+			memcpy(&value, vertex + attrib.offset + i * sizeof(GLshort), sizeof(GLshort));
+			position[i] = attrib.normalized ? max(value / 32767.0f, -1.0f) : (GLfloat) value;
+		}
+		else
+			return false;
+	}
+	return true;
+}
+
+// computeBounds - box around the positions, then the smallest sphere about its centre holding them all
+bool computeBounds(const GLuint numVerts, const void* vertexData, const vertexFormat &format, meshBounds &bounds) {
+	const vertexAttribFormat *attrib = nullptr;
+	for (GLuint a = 0; a < format.numAttribs; a++)
+		if (format.attribs[a].index == RT3D_VERTEX)
+			attrib = &format.attribs[a];
+	if (numVerts == 0 || vertexData == nullptr || attrib == nullptr)
+		return false;
+
+	const char *vertex = (const char *) vertexData;
+	GLfloat position[3];
+	if (!readPosition(vertex, *attrib, position))
+		return false;
+	GLfloat min[3] = { position[0], position[1], position[2] };
+	GLfloat max[3] = { position[0], position[1], position[2] };
+	for (GLuint v = 1; v < numVerts; v++) {
+		readPosition(vertex + v * format.stride, *attrib, position);
+		for (int i = 0; i < 3; i++) {
+			min[i] = std::min(min[i], position[i]);
+			max[i] = std::max(max[i], position[i]);
+		}
+	}
+	makeBounds(min, max, bounds);
+
+	GLfloat radius2 = 0.0f;
+	for (GLuint v = 0; v < numVerts; v++) {
+		readPosition(vertex + v * format.stride, *attrib, position);
+		GLfloat dx = position[0] - bounds.centre[0], dy = position[1] - bounds.centre[1], dz = position[2] - bounds.centre[2];
+		radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = sqrt(radius2);
+	return true;
+}
+
+bool computeBounds(const GLuint numVerts, const GLfloat* vertices, meshBounds &bounds) {
+	return computeBounds(numVerts, vertices, makeVertexFormat(false, false, false), bounds);
+}
+
+// makeBounds - from a box alone, so the sphere is the one through its corners
+void makeBounds(const GLfloat *min, const GLfloat *max, meshBounds &bounds) {
+	GLfloat radius2 = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		bounds.min[i] = min[i];
+		bounds.max[i] = max[i];
+		bounds.centre[i] = (min[i] + max[i]) * 0.5f;
+		radius2 += (max[i] - bounds.centre[i]) * (max[i] - bounds.centre[i]);
+	}
+	bounds.radius = sqrt(radius2);
+}
+
+void setMeshBounds(const GLuint mesh, const meshBounds &bounds) {
+	meshBoundsMap[mesh] = bounds;
+}
+
+bool getMeshBounds(const GLuint mesh, meshBounds &bounds) {
+	auto itr = meshBoundsMap.find(mesh);
+	if (itr == meshBoundsMap.end())
+		return false;
+	bounds = itr->second;
+	return true;
+}
+
+// getUniformLocation - location of a uniform from the program's reflection table
+// Falls back to asking GL for programs that weren't created by initShaders
+GLint getUniformLocation(const GLuint program, const char *uniformName) {
+	auto itr = programMap.find(program);
+	if (itr == programMap.end()) {
+		stats.uniformLocationQueries++;
+		return glGetUniformLocation(program, uniformName);
+	}
+	return findLocation(itr->second, uniformName);
+}
+
+// getProgramUniforms - locations of all the standard rt3d uniforms for a program
+// Keep hold of this and use the handle based setters on the hot path
+const programUniforms& getProgramUniforms(const GLuint program) {
+	auto itr = programMap.find(program);
+	if (itr == programMap.end())
+		reflectUniforms(program);
+	return programMap[program].uniforms;
+}
+
+void setUniformMatrix4fv(const GLuint program, const char* uniformName, const GLfloat *data) {
+	setUniformMatrix4fv(getUniformLocation(program, uniformName), data);
+}
+
+void setUniformMatrix4fv(const GLint location, const GLfloat *data) {
+	if (location < 0)
+		return;
+	glUniformMatrix4fv(location, 1, GL_FALSE, data);
+	stats.uniformUploads++;
+}
+
+void setUniform1i(const GLint location, const GLint value) {
+	if (location < 0)
+		return;
+	glUniform1i(location, value);
+	stats.uniformUploads++;
+}
+
+void setUniform1f(const GLint location, const GLfloat value) {
+	if (location < 0)
+		return;
+	glUniform1f(location, value);
+	stats.uniformUploads++;
+}
+
+static void setUniform4fv(const GLint location, const GLfloat *data) {
+	if (location < 0)
+		return;
+	glUniform4fv(location, 1, data);
+	stats.uniformUploads++;
+}
+
+void setLightPos(const GLuint program, const GLfloat *lightPos) {
+	setLightPos(getProgramUniforms(program), lightPos);
+}
+
+void setLightPos(const programUniforms &uniforms, const GLfloat *lightPos) {
+	setUniform4fv(uniforms.lightPosition, lightPos);
+}
+
+void setProjection(const GLuint program, const GLfloat *data) {
+	setUniformMatrix4fv(getProgramUniforms(program).projection, data);
+}
+
+void setLight(const GLuint program, const lightStruct light) {
+	setLight(getProgramUniforms(program), light);
+}
+
+void setLight(const programUniforms &uniforms, const lightStruct &light) {
+	// pass in light data to shader
+	setUniform4fv(uniforms.lightAmbient, light.ambient);
+	setUniform4fv(uniforms.lightDiffuse, light.diffuse);
+	setUniform4fv(uniforms.lightSpecular, light.specular);
+	setUniform4fv(uniforms.lightPosition, light.position);
+}
+
+
+void setMaterial(const GLuint program, const materialStruct material) {
+	setMaterial(getProgramUniforms(program), material);
+}
+
+void setMaterial(const programUniforms &uniforms, const materialStruct &material) {
+	// pass in material data to shader 
+	setUniform4fv(uniforms.materialAmbient, material.ambient);
+	setUniform4fv(uniforms.materialDiffuse, material.diffuse);
+	setUniform4fv(uniforms.materialSpecular, material.specular);
+	setUniform1f(uniforms.materialShininess, material.shininess);
+}
+
+// The stream buffer - a ring of RT3D_STREAM_FRAMES regions, each filled during one frame.
+// A fence is set when a frame's region has been submitted, and waited on before the region
+// is written again. It starts small and is replaced by a bigger one if a frame overflows it -
+// the old buffer is kept until any draws from it are done.
+#define RT3D_STREAM_REGION_SIZE (1 << 20)
+struct streamRing {
+	GLuint buffer;
+	GLuint regionSize;
+	GLuint region;
+	GLuint head;				// next free byte, from the start of the buffer
+	char *mapping;				// persistently mapped storage, or nullptr if orphaning
+	GLsync fences[RT3D_STREAM_FRAMES];
+	GLint uniformAlignment;
+	vector<GLuint> retired;
+	GLuint retiredFrames;
+};
+static streamRing ring = {};
+
+static void createStreamBuffer(const GLuint regionSize) {
+	for (GLuint i = 0; i < RT3D_STREAM_FRAMES; i++) {
+		if (ring.fences[i])
+			glDeleteSync(ring.fences[i]);
+		ring.fences[i] = 0;
+	}
+	if (ring.buffer) {
+		ring.retired.push_back(ring.buffer);
+		ring.retiredFrames = 0;
+	}
+	else
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring.uniformAlignment);
+	ring.regionSize = regionSize;
+	ring.head = ring.region * regionSize;
+
+	// bound to GL_COPY_WRITE_BUFFER so as not to disturb anything using the other targets
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+	GLsizeiptr size = (GLsizeiptr) regionSize * RT3D_STREAM_FRAMES;
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		ring.mapping = (char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	}
+	else {
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		ring.mapping = nullptr;
+	}
+}
+
+GLuint streamData(const void *data, const GLuint bytes, const GLuint alignment, GLuint &buffer) {
+	if (ring.buffer == 0)
+		createStreamBuffer(RT3D_STREAM_REGION_SIZE);
+	GLuint offset = (ring.head + alignment - 1) / alignment * alignment;
+	if (offset + bytes > (ring.region + 1) * ring.regionSize) {
+		GLuint regionSize = ring.regionSize * 2;
+		while (regionSize < bytes + alignment)
+			regionSize *= 2;
+		createStreamBuffer(regionSize);
+		offset = (ring.head + alignment - 1) / alignment * alignment;
+	}
+	if (ring.mapping)
+		memcpy(ring.mapping + offset, data, bytes);
+	else {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+	}
+	ring.head = offset + bytes;
+	stats.streamedBytes += bytes;
+	buffer = ring.buffer;
+	return offset;
+}
+
+// A copy of what was last set for each shared block, so that unchanged data (e.g. the same
+// material on consecutive draws) costs nothing. Blocks live in the stream buffer, so the
+// copies are streamed again at the start of each frame
+static vector<char> blockContents[RT3D_UNIFORM_BLOCKS];
+
+static void bindUniformBlock(const GLuint binding) {
+	const vector<char> &contents = blockContents[binding];
+	if (ring.buffer == 0)
+		createStreamBuffer(RT3D_STREAM_REGION_SIZE);	// to find the uniform offset alignment
+	GLuint buffer;
+	GLuint offset = streamData(contents.data(), (GLuint) contents.size(), ring.uniformAlignment, buffer);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, contents.size());
+}
+
+static void setUniformBlock(const GLuint binding, const void *data, const size_t size) {
+	vector<char> &contents = blockContents[binding];
+	// std140 blocks are a multiple of 16 bytes, so round up or the driver may reject the range
+	size_t paddedSize = (size + 15) & ~(size_t) 15;
+	if (contents.size() == paddedSize && memcmp(contents.data(), data, size) == 0)
+		return;
+	contents.assign(paddedSize, 0);
+	memcpy(contents.data(), data, size);
+	bindUniformBlock(binding);
+	stats.uniformBlockUploads++;
+}
+
+void endStreamFrame() {
+	if (ring.buffer == 0)
+		return;
+	if (ring.mapping)
+		ring.fences[ring.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring.region = (ring.region + 1) % RT3D_STREAM_FRAMES;
+	ring.head = ring.region * ring.regionSize;
+
+	if (ring.mapping && ring.fences[ring.region]) {
+		// normally long signalled - it was set RT3D_STREAM_FRAMES - 1 frames ago
+		GLenum result = glClientWaitSync(ring.fences[ring.region], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			stats.streamWaits++;
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(ring.fences[ring.region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		glDeleteSync(ring.fences[ring.region]);
+		ring.fences[ring.region] = 0;
+	}
+	else if (!ring.mapping && ring.region == 0) {
+		// back at the start, so give the driver fresh storage rather than wait for the old
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr) ring.regionSize * RT3D_STREAM_FRAMES, nullptr, GL_STREAM_DRAW);
+	}
+
+	if (!ring.retired.empty() && ++ring.retiredFrames >= RT3D_STREAM_FRAMES) {
+		glDeleteBuffers((GLsizei) ring.retired.size(), ring.retired.data());
+		ring.retired.clear();
+	}
+
+	for (GLuint binding = 0; binding < RT3D_UNIFORM_BLOCKS; binding++)
+		if (!blockContents[binding].empty())
+			bindUniformBlock(binding);
+}
+
+void setCameraBlock(const cameraStruct &camera) {
+	setUniformBlock(RT3D_CAMERA_BLOCK, &camera, sizeof(camera));
+}
+
+void setLightBlock(const lightStruct &light) {
+	setUniformBlock(RT3D_LIGHT_BLOCK, &light, sizeof(light));
+}
+
+void setMaterialBlock(const materialStruct &material) {
+	setUniformBlock(RT3D_MATERIAL_BLOCK, &material, sizeof(material));
+}
+
+// std140 pads each element of an array of structs to a multiple of 16 bytes, so materialStruct
+// has to be spread out, and the whole array is always sent as the shader declares a fixed size
+void setMaterialArrayBlock(const materialStruct *materials, const GLuint count) {
+	GLfloat block[RT3D_MAX_INSTANCE_MATERIALS][16];
+	memset(block, 0, sizeof(block));
+	for (GLuint i = 0; i < count && i < RT3D_MAX_INSTANCE_MATERIALS; i++)
+		memcpy(block[i], &materials[i], sizeof(materialStruct));
+	setUniformBlock(RT3D_MATERIAL_ARRAY_BLOCK, block, sizeof(block));
+}
+
+static bool stateChanged(GLuint &cached, const GLuint value) {
+	if (!stateCacheValid)
+		invalidateStateCache();
+	if (cached == value) {
+		stats.stateChangesSkipped++;
+		return false;
+	}
+	cached = value;
+	stats.stateChanges++;
+	return true;
+}
+
+void useProgram(const GLuint program) {
+	if (stateChanged(state.program, program))
+		glUseProgram(program);
+}
+
+void bindVertexArray(const GLuint vertexArray) {
+	if (stateChanged(state.vertexArray, vertexArray))
+		glBindVertexArray(vertexArray);
+}
+
+void bindTexture(const GLuint unit, const GLenum target, const GLuint texture) {
+	int targetIndex = (target == GL_TEXTURE_2D) ? 0 : (target == GL_TEXTURE_CUBE_MAP) ? 1 : -1;
+	if (unit < RT3D_TEXTURE_UNITS && targetIndex >= 0 && !stateChanged(state.textures[unit][targetIndex], texture))
+		return;
+	if (stateChanged(state.activeTexture, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+}
+
+void setEnabled(const GLenum capability, const bool enabled) {
+	GLuint *cached = nullptr;
+	if (capability == GL_CULL_FACE)
+		cached = &state.cullFace;
+	else if (capability == GL_DEPTH_TEST)
+		cached = &state.depthTest;
+	else if (capability == GL_BLEND)
+		cached = &state.blend;
+	if (cached != nullptr && !stateChanged(*cached, enabled))
+		return;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void setCullFace(const GLenum mode) {
+	if (stateChanged(state.cullFaceMode, mode))
+		glCullFace(mode);
+}
+
+void setDepthMask(const GLboolean mask) {
+	if (stateChanged(state.depthMask, mask))
+		glDepthMask(mask);
+}
+
+// invalidateStateCache - forget all cached state, so the next call of each setter goes to GL
+void invalidateStateCache() {
+	memset(&state, 0xFF, sizeof(state));
+	stateCacheValid = true;
+}
+
+// renderStats - counts of GL calls made through rt3d since the last reset
+const renderStats& getRenderStats() {
+	return stats;
+}
+
+// addDrawCalls - lets the other rt3d modules count the draws they make themselves
+void addDrawCalls(const GLuint count) {
+	stats.drawCalls += count;
+}
+
+// addTriangles - counts the triangles made from vertexCount vertices (or indices) of primitive
+void addTriangles(const GLenum primitive, const GLuint vertexCount, const GLuint instances) {
+	GLuint64 triangles = 0;
+	if (primitive == GL_TRIANGLES)
+		triangles = vertexCount / 3;
+	else if ((primitive == GL_TRIANGLE_STRIP || primitive == GL_TRIANGLE_FAN) && vertexCount > 2)
+		triangles = vertexCount - 2;
+	stats.triangles += triangles * instances;
+}
+
+// addCullCounts - for the culling functions, to count the objects they tested
+void addCullCounts(const GLuint visible, const GLuint culled) {
+	stats.objectsVisible += visible;
+	stats.objectsCulled += culled;
+}
+
+void resetRenderStats() {
+	stats = renderStats();
+}
+
+void drawMesh(const GLuint mesh, const GLuint numVerts, const GLuint primitive) {
+	bindVertexArray(mesh);	// Bind mesh VAO - left bound, as the next draw is likely to use it too
+	glDrawArrays(primitive, 0, numVerts);	// draw first vertex array object
+	stats.drawCalls++;
+	addTriangles(primitive, numVerts, 1);
+}
+
+
+// byte offset of an index, in a buffer of indexType indices
+static const GLvoid* indexOffset(const GLenum indexType, const GLuint index) {
+	return (const GLvoid *) (size_t) (index * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive) {
+	drawIndexedMesh(mesh, indexCount, primitive, 0);
+}
+
+void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive, const GLuint firstIndex) {
+	// packed meshes may use 16 bit indices
+	auto itr = vertexArrayMap.find(mesh);
+	GLenum indexType = (itr != vertexArrayMap.end()) ? itr->second[RT3D_INDEX_TYPE] : GL_UNSIGNED_INT;
+	bindVertexArray(mesh);	// Bind mesh VAO
+	glDrawElements(primitive, indexCount, indexType, indexOffset(indexType, firstIndex));	// draw VAO 
+	stats.drawCalls++;
+	addTriangles(primitive, indexCount, 1);
+}
+
+
+// setInstanceAttribPointers - point the per instance attributes of the bound VAO at an array
+// of instanceData, starting offset bytes into the bound GL_ARRAY_BUFFER
+void setInstanceAttribPointers(const size_t offset) {
+	for (GLuint i = 0; i < 4; i++) {
+		glVertexAttribPointer(RT3D_INSTANCE_MATRIX + i, 4, GL_FLOAT, GL_FALSE, sizeof(instanceData),
+			(const GLvoid *) (offset + i * 4 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(RT3D_INSTANCE_MATRIX + i);
+		glVertexAttribDivisor(RT3D_INSTANCE_MATRIX + i, 1);
+	}
+	glVertexAttribIPointer(RT3D_INSTANCE_MATERIAL, 1, GL_UNSIGNED_INT, sizeof(instanceData),
+		(const GLvoid *) (offset + offsetof(instanceData, materialIndex)));
+	glEnableVertexAttribArray(RT3D_INSTANCE_MATERIAL);
+	glVertexAttribDivisor(RT3D_INSTANCE_MATERIAL, 1);
+}
+
+void drawIndexedMeshInstanced(const GLuint mesh, const GLuint indexCount, const GLuint primitive,
+	const instanceData *instances, const GLuint instanceCount) {
+	drawIndexedMeshInstanced(mesh, indexCount, primitive, instances, instanceCount, 0);
+}
+
+void drawIndexedMeshInstanced(const GLuint mesh, const GLuint indexCount, const GLuint primitive,
+	const instanceData *instances, const GLuint instanceCount, const GLuint firstIndex) {
+	auto itr = vertexArrayMap.find(mesh);
+	if (itr == vertexArrayMap.end() || instanceCount == 0)
+		return;
+	GLuint *pMeshBuffers = itr->second;
+	GLuint buffer;
+	GLuint offset = streamData(instances, instanceCount * sizeof(instanceData), 16, buffer);
+	bindVertexArray(mesh);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	setInstanceAttribPointers(offset);
+
+	glDrawElementsInstanced(primitive, indexCount, pMeshBuffers[RT3D_INDEX_TYPE],
+		indexOffset(pMeshBuffers[RT3D_INDEX_TYPE], firstIndex), instanceCount);
+	stats.drawCalls++;
+	addTriangles(primitive, indexCount, instanceCount);
+}
+
+
+void updateMesh(const GLuint mesh, const unsigned int bufferType, const GLfloat *data, const GLuint size) {
+	GLuint * pMeshBuffers = vertexArrayMap[mesh];
+	bindVertexArray(mesh);
+
+	// the mesh's own buffer for this attribute isn't needed once its data is streamed
+	if (pMeshBuffers[bufferType] != 0) {
+		glDeleteBuffers(1, &pMeshBuffers[bufferType]);
+		pMeshBuffers[bufferType] = 0;
+	}
+
+	// copy the new data into the stream buffer and point the attribute at it
+	GLuint buffer;
+	GLuint offset = streamData(data, size*sizeof(GLfloat), 16, buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexAttribPointer((GLuint)bufferType, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *) (size_t) offset);
+	glEnableVertexAttribArray(bufferType);
+
+}
+
 } // namespace rt3d
\ No newline at end of file
@@ -1,58 +1,238 @@
-#ifndef RT3D
-#define RT3D
-
-#include <GL/glew.h>
-#include <SDL.h>
-#include <iostream>
-#include <fstream>
-#include <string>
-
-#define RT3D_VERTEX		0
-#define RT3D_COLOUR		1
-#define RT3D_NORMAL		2
-#define RT3D_TEXCOORD   3
-#define RT3D_INDEX		4
-
-namespace rt3d {
-
-	struct lightStruct {
-		GLfloat ambient[4];
-		GLfloat diffuse[4];
-		GLfloat specular[4];
-		GLfloat position[4];
-	};
-
-	struct materialStruct {
-		GLfloat ambient[4];
-		GLfloat diffuse[4];
-		GLfloat specular[4];
-		GLfloat shininess;
-	};
-
-	void exitFatalError(const char *message);
-	char* loadFile(const char *fname, GLint &fSize);
-	void printShaderError(const GLint shader);
-	GLuint initShaders(const char *vertFile, const char *fragFile);
-	// Some methods for creating meshes
-	// ... including one for dealing with indexed meshes
-	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
-		const GLfloat* texcoords, const GLuint indexCount, const GLuint* indices);
-	// these three create mesh functions simply provide more basic access to the full version
-	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
-		const GLfloat* texcoords);
-	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices);
-	GLuint createColourMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours);
-
-	void setUniformMatrix4fv(const GLuint program, const char* uniformName, const GLfloat *data);
-	
-	void setLight(const GLuint program, const lightStruct light);
-	void setLightPos(const GLuint program, const GLfloat *lightPos);
-	void setMaterial(const GLuint program, const materialStruct material);
-
-	void drawMesh(const GLuint mesh, const GLuint numVerts, const GLuint primitive); 
-	void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive);
-
-	void updateMesh(const GLuint mesh, const unsigned int bufferType, const GLfloat *data, const GLuint size);
-}
-
+#ifndef RT3D
+#define RT3D
+
+#include <GL/glew.h>
+#include <SDL.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define RT3D_VERTEX		0
+#define RT3D_COLOUR		1
+#define RT3D_NORMAL		2
+#define RT3D_TEXCOORD   3
+#define RT3D_INDEX		4
+
+// per instance attributes for instanced drawing - the model matrix takes locations 4 to 7
+#define RT3D_INSTANCE_MATRIX	4
+#define RT3D_INSTANCE_MATERIAL	8
+
+// uniform block binding points
+#define RT3D_CAMERA_BLOCK	0
+#define RT3D_LIGHT_BLOCK	1
+#define RT3D_MATERIAL_BLOCK	2
+#define RT3D_MATERIAL_ARRAY_BLOCK	3
+#define RT3D_UNIFORM_BLOCKS	4
+
+#define RT3D_MAX_INSTANCE_MATERIALS	16
+
+#define RT3D_MAX_ATTRIBS	4
+#define RT3D_TEXTURE_UNITS	8
+
+// the stream buffer is split into this many regions, one per frame in flight
+#define RT3D_STREAM_FRAMES	3
+
+namespace rt3d {
+
+	struct lightStruct {
+		GLfloat ambient[4];
+		GLfloat diffuse[4];
+		GLfloat specular[4];
+		GLfloat position[4];
+	};
+
+	struct materialStruct {
+		GLfloat ambient[4];
+		GLfloat diffuse[4];
+		GLfloat specular[4];
+		GLfloat shininess;
+	};
+
+	// std140 layout of the cameraBlock uniform block
+	struct cameraStruct {
+		GLfloat projection[16];
+		GLfloat position[4];		// world space, w unused
+	};
+
+	// Per instance data for drawIndexedMeshInstanced - materialIndex selects from the
+	// materials given to setMaterialArrayBlock
+	struct instanceData {
+		GLfloat modelMatrix[16];
+		GLuint materialIndex;
+	};
+
+	// Locations of the standard rt3d uniforms in a program, read once when it is linked
+	// Any the program doesn't use are -1, and are skipped by the setters
+	struct programUniforms {
+		GLint modelview;
+		GLint projection;
+		GLint modelMatrix;
+		GLint view;
+		GLint lightPosition;
+		GLint lightAmbient;
+		GLint lightDiffuse;
+		GLint lightSpecular;
+		GLint materialAmbient;
+		GLint materialDiffuse;
+		GLint materialSpecular;
+		GLint materialShininess;
+	};
+
+	// Counts of GL calls made through rt3d - reset once per frame to get per frame numbers
+	struct renderStats {
+		GLuint uniformLocationQueries;
+		GLuint uniformUploads;
+		GLuint uniformBlockUploads;
+		GLuint stateChanges;		// binds and enables passed on to GL
+		GLuint stateChangesSkipped;	// ... and those dropped because nothing would change
+		GLuint drawCalls;
+		GLuint64 triangles;			// drawn, counting every instance
+		GLuint objectsVisible;		// tested against the view frustum and drawn
+		GLuint objectsCulled;		// ... and skipped
+		GLuint streamedBytes;		// copied into the stream buffer
+		GLuint streamWaits;			// times the CPU had to wait for the GPU to free a region
+	};
+
+	// Declarative description of an interleaved vertex: one entry per attribute, each at
+	// a byte offset within a vertex of stride bytes
+	struct vertexAttribFormat {
+		GLuint index;			// attribute location - RT3D_VERTEX, RT3D_NORMAL etc
+		GLint size;				// number of components
+		GLenum type;			// component type, e.g. GL_FLOAT
+		GLboolean normalized;
+		GLuint offset;			// bytes from the start of the vertex
+	};
+
+	struct vertexFormat {
+		GLuint stride;			// bytes per vertex
+		GLuint numAttribs;
+		vertexAttribFormat attribs[RT3D_MAX_ATTRIBS];
+	};
+
+	// Quantized vertex data from packVertices. Positions are snorm16 and decode as
+	// position = packed * positionScale + positionBias. positionScale is the same on every axis,
+	// so the decode can be folded into the modelview matrix without skewing normals
+	struct packedVertices {
+		vertexFormat format;
+		GLfloat positionScale[3];
+		GLfloat positionBias[3];
+		GLenum indexType;		// GL_UNSIGNED_SHORT when there are few enough vertices
+		std::vector<char> vertexData;
+		std::vector<char> indexData;
+	};
+
+	// Bounds of a mesh, in the same space as its vertex data - so a packed mesh is bounded before
+	// its positions are decoded. The sphere is centred on the box, and just reaches the furthest vertex
+	struct meshBounds {
+		GLfloat min[3];
+		GLfloat max[3];
+		GLfloat centre[3];
+		GLfloat radius;
+	};
+
+	void exitFatalError(const char *message);
+	char* loadFile(const char *fname, GLint &fSize);
+	const char* mapFile(const char *fname, size_t &fSize);
+	void unmapFile(const char *data, const size_t fSize);
+	void printShaderError(const GLint shader);
+	GLuint initShaders(const char *vertFile, const char *fragFile);
+	// Some methods for creating meshes
+	// ... including one for dealing with indexed meshes
+	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
+		const GLfloat* texcoords, const GLuint indexCount, const GLuint* indices);
+	// these three create mesh functions simply provide more basic access to the full version
+	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
+		const GLfloat* texcoords);
+	GLuint createMesh(const GLuint numVerts, const GLfloat* vertices);
+	GLuint createColourMesh(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours);
+	// Interleaved meshes keep every attribute in a single VBO, laid out as described by format
+	void addVertexAttrib(vertexFormat &format, const GLuint index, const GLint size, const GLenum type, const GLboolean normalized);
+	vertexFormat makeVertexFormat(const bool colours, const bool normals, const bool texcoords);
+	void interleaveVertices(const GLuint numVerts, const GLfloat* vertices, const GLfloat* colours, const GLfloat* normals,
+		const GLfloat* texcoords, const vertexFormat &format, void *out);
+	GLuint createInterleavedMesh(const GLuint numVerts, const void* vertexData, const vertexFormat &format,
+		const GLuint indexCount, const GLuint* indices);
+	GLuint createInterleavedMesh(const GLuint numVerts, const void* vertexData, const vertexFormat &format,
+		const GLuint indexCount, const void* indices, const GLenum indexType);
+	void packVertices(const GLuint numVerts, const GLfloat* vertices, const GLfloat* normals, const GLfloat* texcoords,
+		const GLuint indexCount, const GLuint* indices, packedVertices &packed);
+
+	// Every mesh gets bounds from its vertices when it is created - meshes whose vertices change
+	// (e.g. through updateMesh) should have bounds set that cover all of their shapes.
+	// computeBounds returns false if there are no vertices, or positions of a type it can't read
+	bool computeBounds(const GLuint numVerts, const GLfloat* vertices, meshBounds &bounds);
+	bool computeBounds(const GLuint numVerts, const void* vertexData, const vertexFormat &format, meshBounds &bounds);
+	void makeBounds(const GLfloat *min, const GLfloat *max, meshBounds &bounds);
+	void setMeshBounds(const GLuint mesh, const meshBounds &bounds);
+	// false if the mesh has no bounds, and so can't be culled
+	bool getMeshBounds(const GLuint mesh, meshBounds &bounds);
+
+	// The name based setters are kept for convenience, but the handle based versions taking
+	// a location or programUniforms avoid any name lookups
+	GLint getUniformLocation(const GLuint program, const char *uniformName);
+	const programUniforms& getProgramUniforms(const GLuint program);
+
+	void setUniformMatrix4fv(const GLuint program, const char* uniformName, const GLfloat *data);
+	void setUniformMatrix4fv(const GLint location, const GLfloat *data);
+	void setUniform1i(const GLint location, const GLint value);
+	void setUniform1f(const GLint location, const GLfloat value);
+	
+	void setLight(const GLuint program, const lightStruct light);
+	void setLight(const programUniforms &uniforms, const lightStruct &light);
+	void setLightPos(const GLuint program, const GLfloat *lightPos);
+	void setLightPos(const programUniforms &uniforms, const GLfloat *lightPos);
+	void setMaterial(const GLuint program, const materialStruct material);
+	void setMaterial(const programUniforms &uniforms, const materialStruct &material);
+
+	// Shared uniform blocks - initShaders binds any cameraBlock, lightBlock or materialBlock
+	// declared in a program to these binding points, so one upload reaches every program.
+	// Uploads are skipped when the data hasn't changed since the last call.
+	void setCameraBlock(const cameraStruct &camera);
+	void setLightBlock(const lightStruct &light);
+	void setMaterialBlock(const materialStruct &material);
+	void setMaterialArrayBlock(const materialStruct *materials, const GLuint count);
+
+	// Cached GL state - these skip the GL call if the value is already set. Anything bound
+	// behind rt3d's back (e.g. a raw glUseProgram) needs invalidateStateCache afterwards
+	void useProgram(const GLuint program);
+	void bindVertexArray(const GLuint vertexArray);
+	void bindTexture(const GLuint unit, const GLenum target, const GLuint texture);
+	void setEnabled(const GLenum capability, const bool enabled);
+	void setCullFace(const GLenum mode);
+	void setDepthMask(const GLboolean mask);
+	void invalidateStateCache();
+
+	const renderStats& getRenderStats();
+	void addDrawCalls(const GLuint count);
+	void addTriangles(const GLenum primitive, const GLuint vertexCount, const GLuint instances);
+	void addCullCounts(const GLuint visible, const GLuint culled);
+	void resetRenderStats();
+
+	void drawMesh(const GLuint mesh, const GLuint numVerts, const GLuint primitive); 
+	void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive);
+	// ... starting firstIndex indices into the mesh's index buffer (e.g. at one of its LOD levels)
+	void drawIndexedMesh(const GLuint mesh, const GLuint indexCount, const GLuint primitive, const GLuint firstIndex);
+	// Draws instanceCount copies of a mesh in one call, for shaders taking in_ModelMatrix and
+	// in_MaterialIndex (e.g. ActualPhongInstanced). The instance data is streamed on every call
+	void drawIndexedMeshInstanced(const GLuint mesh, const GLuint indexCount, const GLuint primitive,
+		const instanceData *instances, const GLuint instanceCount);
+	void drawIndexedMeshInstanced(const GLuint mesh, const GLuint indexCount, const GLuint primitive,
+		const instanceData *instances, const GLuint instanceCount, const GLuint firstIndex);
+	void setInstanceAttribPointers(const size_t offset);
+
+	// Dynamic data streaming. streamData copies data into the current frame's region of a ring
+	// buffer (persistently mapped where GL 4.4 or ARB_buffer_storage allows, otherwise written with
+	// glBufferSubData and orphaned each time round) and returns its byte offset in buffer.
+	// Streamed data only lasts a few frames, so stream it again every frame it is used.
+	// endStreamFrame must be called once a frame, after the swap - it fences the frame just
+	// submitted and waits, if need be, for the GPU to finish with the next region.
+	// Uniform blocks, instance data and updateMesh all go through the stream buffer.
+	GLuint streamData(const void *data, const GLuint bytes, const GLuint alignment, GLuint &buffer);
+	void endStreamFrame();
+
+	// Streams new data for one attribute of a mesh - call every frame the mesh is drawn
+	void updateMesh(const GLuint mesh, const unsigned int bufferType, const GLfloat *data, const GLuint size);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,377 @@
+// rt3dBvh.cpp
+// Bounding volume hierarchy - see rt3dBvh.h
+
+#include "rt3dBvh.h"
+#include "rt3dProfiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace rt3d {
+
+	struct bvhBin {
+		GLfloat min[3];
+		GLfloat max[3];
+		GLuint count;
+	};
+
+	static void emptyBox(GLfloat *min, GLfloat *max) {
+		for (int i = 0; i < 3; i++) {
+			min[i] = FLT_MAX;
+			max[i] = -FLT_MAX;
+		}
+	}
+
+	static void growBox(GLfloat *min, GLfloat *max, const GLfloat *boxMin, const GLfloat *boxMax) {
+		for (int i = 0; i < 3; i++) {
+			min[i] = std::min(min[i], boxMin[i]);
+			max[i] = std::max(max[i], boxMax[i]);
+		}
+	}
+
+	// half the surface area - only ever compared, so the factor of 2 doesn't matter
+	static GLfloat boxArea(const GLfloat *min, const GLfloat *max) {
+		GLfloat dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+		if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+			return 0.0f;
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	static GLuint findBin(const GLfloat centre, const GLfloat low, const GLfloat scale) {
+		return std::min((GLuint) ((centre - low) * scale), (GLuint) (RT3D_BVH_BINS - 1));
+	}
+
+	// the box around a node's objects, or its children's boxes
+	static void fitNode(bvh &tree, const GLuint index, GLfloat *min, GLfloat *max) {
+		const bvhNode &node = tree.nodes[index];
+		emptyBox(min, max);
+		if (node.left) {
+			growBox(min, max, tree.nodes[node.left].min, tree.nodes[node.left].max);
+			growBox(min, max, tree.nodes[node.left + 1].min, tree.nodes[node.left + 1].max);
+			return;
+		}
+		for (GLuint i = node.begin; i < node.end; i++) {
+			const GLfloat *box = &tree.boxes[tree.objects[i] * 6];
+			growBox(min, max, box, box + 3);
+		}
+	}
+
+	// Splits a node's objects between two new children, at the cheapest bin boundary on any axis.
+	// Returns false if the node should stay a leaf
+	static bool splitNode(bvh &tree, const GLuint index, const std::vector<GLfloat> &centres, std::vector<GLuint> &depths) {
+		GLuint begin = tree.nodes[index].begin, end = tree.nodes[index].end;
+		if (end - begin <= RT3D_BVH_LEAF_SIZE)
+			return false;
+
+		GLfloat low[3], high[3];
+		emptyBox(low, high);
+		for (GLuint i = begin; i < end; i++) {
+			const GLfloat *c = &centres[tree.objects[i] * 3];
+			growBox(low, high, c, c);
+		}
+
+		GLuint bestAxis = 3, bestBin = 0;
+		GLfloat bestCost = FLT_MAX;
+		GLfloat scales[3];
+		for (GLuint axis = 0; axis < 3; axis++) {
+			GLfloat extent = high[axis] - low[axis];
+			scales[axis] = extent > 0.0f ? RT3D_BVH_BINS / extent : 0.0f;
+			if (extent <= 0.0f)
+				continue;
+			bvhBin bins[RT3D_BVH_BINS];
+			for (int b = 0; b < RT3D_BVH_BINS; b++) {
+				emptyBox(bins[b].min, bins[b].max);
+				bins[b].count = 0;
+			}
+			for (GLuint i = begin; i < end; i++) {
+				GLuint object = tree.objects[i];
+				bvhBin &bin = bins[findBin(centres[object * 3 + axis], low[axis], scales[axis])];
+				growBox(bin.min, bin.max, &tree.boxes[object * 6], &tree.boxes[object * 6 + 3]);
+				bin.count++;
+			}
+			// areas and counts to the right of each boundary, then sweep from the left
+			GLfloat rightArea[RT3D_BVH_BINS];
+			GLuint rightCount[RT3D_BVH_BINS];
+			GLfloat min[3], max[3];
+			emptyBox(min, max);
+			GLuint count = 0;
+			for (int b = RT3D_BVH_BINS - 1; b > 0; b--) {
+				growBox(min, max, bins[b].min, bins[b].max);
+				count += bins[b].count;
+				rightArea[b] = boxArea(min, max);
+				rightCount[b] = count;
+			}
+			emptyBox(min, max);
+			count = 0;
+			for (int b = 0; b < RT3D_BVH_BINS - 1; b++) {
+				growBox(min, max, bins[b].min, bins[b].max);
+				count += bins[b].count;
+				if (count == 0 || rightCount[b + 1] == 0)
+					continue;
+				GLfloat cost = boxArea(min, max) * count + rightArea[b + 1] * rightCount[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		// past RT3D_BVH_HALVE_DEPTH halving keeps the rest of the tree within RT3D_BVH_MAX_DEPTH
+		if (depths[index] >= RT3D_BVH_HALVE_DEPTH)
+			bestAxis = 3;
+		GLuint middle;
+		if (bestAxis == 3)
+			middle = begin + (end - begin) / 2;	// every centre in the same place - just halve the list
+		else
+			middle = (GLuint) (std::partition(tree.objects.begin() + begin, tree.objects.begin() + end,
+				[&](GLuint object) { return findBin(centres[object * 3 + bestAxis], low[bestAxis], scales[bestAxis]) <= bestBin; })
+				- tree.objects.begin());
+
+		GLuint left = (GLuint) tree.nodes.size();
+		bvhNode child;
+		memset(&child, 0, sizeof(child));
+		child.begin = begin;
+		child.end = middle;
+		tree.nodes.push_back(child);
+		child.begin = middle;
+		child.end = end;
+		tree.nodes.push_back(child);
+		tree.parents.push_back(index);
+		tree.parents.push_back(index);
+		depths.push_back(depths[index] + 1);
+		depths.push_back(depths[index] + 1);
+		tree.nodes[index].left = left;
+		return true;
+	}
+
+	void buildBvh(bvh &tree, const GLfloat *boxes, const GLuint count) {
+		RT3D_PROFILE("buildBvh");
+		tree.boxes.assign(boxes, boxes + count * 6);
+		tree.objects.resize(count);
+		tree.objectLeaves.resize(count);
+		std::vector<GLfloat> centres(count * 3);
+		for (GLuint i = 0; i < count; i++) {
+			tree.objects[i] = i;
+			for (int j = 0; j < 3; j++)
+				centres[i * 3 + j] = (boxes[i * 6 + j] + boxes[i * 6 + 3 + j]) * 0.5f;
+		}
+		tree.nodes.clear();
+		tree.parents.clear();
+		if (count == 0)
+			return;
+		tree.nodes.reserve(count / RT3D_BVH_LEAF_SIZE * 4 + 1);
+		tree.parents.reserve(tree.nodes.capacity());
+
+		bvhNode root;
+		memset(&root, 0, sizeof(root));
+		root.end = count;
+		tree.nodes.push_back(root);
+		tree.parents.push_back(RT3D_BVH_NONE);
+		std::vector<GLuint> depths(1, 0);
+		// children always come after their parent, so the nodes can be split in order
+		for (GLuint i = 0; i < tree.nodes.size(); i++) {
+			if (!splitNode(tree, i, centres, depths)) {
+				for (GLuint j = tree.nodes[i].begin; j < tree.nodes[i].end; j++)
+					tree.objectLeaves[tree.objects[j]] = i;
+			}
+		}
+		refitBvh(tree);
+	}
+
+	void setBvhObject(bvh &tree, const GLuint object, const GLfloat *min, const GLfloat *max) {
+		memcpy(&tree.boxes[object * 6], min, 3 * sizeof(GLfloat));
+		memcpy(&tree.boxes[object * 6 + 3], max, 3 * sizeof(GLfloat));
+	}
+
+	void refitBvh(bvh &tree) {
+		for (size_t i = tree.nodes.size(); i-- > 0;)
+			fitNode(tree, (GLuint) i, tree.nodes[i].min, tree.nodes[i].max);
+	}
+
+	void moveBvhObject(bvh &tree, const GLuint object, const GLfloat *min, const GLfloat *max) {
+		setBvhObject(tree, object, min, max);
+		GLuint node = tree.objectLeaves[object];
+		while (node != RT3D_BVH_NONE) {
+			GLfloat newMin[3], newMax[3];
+			fitNode(tree, node, newMin, newMax);
+			bvhNode &n = tree.nodes[node];
+			if (memcmp(newMin, n.min, sizeof(newMin)) == 0 && memcmp(newMax, n.max, sizeof(newMax)) == 0)
+				break;
+			memcpy(n.min, newMin, sizeof(newMin));
+			memcpy(n.max, newMax, sizeof(newMax));
+			node = tree.parents[node];
+		}
+	}
+
+	// Box against the planes in mask: -1 if wholly outside one, otherwise the planes it crosses
+	static int testBox(const frustum &view, const GLfloat *min, const GLfloat *max, const int mask) {
+		int crossing = 0;
+		for (int p = 0; p < 6; p++) {
+			if (!(mask & (1 << p)))
+				continue;
+			const GLfloat *plane = view.planes[p];
+			// the corners furthest along and furthest against the plane's normal
+			GLfloat inner = plane[3], outer = plane[3];
+			for (int i = 0; i < 3; i++) {
+				inner += plane[i] * (plane[i] > 0.0f ? max[i] : min[i]);
+				outer += plane[i] * (plane[i] > 0.0f ? min[i] : max[i]);
+			}
+			if (inner < 0.0f)
+				return -1;
+			if (outer < 0.0f)
+				crossing |= 1 << p;
+		}
+		return crossing;
+	}
+
+	struct bvhStackEntry {
+		GLuint node;
+		int mask;
+	};
+
+	GLuint cullBvh(const bvh &tree, const frustum &view, std::vector<GLuint> &visible) {
+		RT3D_PROFILE("cullBvh");
+		if (tree.nodes.empty())
+			return 0;
+		size_t first = visible.size();
+		bvhStackEntry stack[RT3D_BVH_MAX_DEPTH + 1];
+		int top = 0;
+		stack[top++] = { 0, 0x3F };
+		while (top > 0) {
+			bvhStackEntry entry = stack[--top];
+			const bvhNode &node = tree.nodes[entry.node];
+			int mask = testBox(view, node.min, node.max, entry.mask);
+			if (mask < 0)
+				continue;
+			if (mask == 0)	// wholly inside - everything below is visible
+				visible.insert(visible.end(), tree.objects.begin() + node.begin, tree.objects.begin() + node.end);
+			else if (node.left) {
+				stack[top++] = { node.left + 1, mask };
+				stack[top++] = { node.left, mask };
+			}
+			else {
+				for (GLuint i = node.begin; i < node.end; i++) {
+					const GLfloat *box = &tree.boxes[tree.objects[i] * 6];
+					if (testBox(view, box, box + 3, mask) >= 0)
+						visible.push_back(tree.objects[i]);
+				}
+			}
+		}
+		GLuint count = (GLuint) (visible.size() - first);
+		addCullCounts(count, (GLuint) tree.objects.size() - count);
+		return count;
+	}
+
+	// Distance along the ray to where it enters the box, or FLT_MAX if it misses
+	static GLfloat rayBox(const GLfloat *origin, const GLfloat *inverse, const GLfloat *min, const GLfloat *max) {
+		GLfloat enter = 0.0f, leave = FLT_MAX;
+		for (int i = 0; i < 3; i++) {
+			GLfloat t0 = (min[i] - origin[i]) * inverse[i];
+			GLfloat t1 = (max[i] - origin[i]) * inverse[i];
+			enter = std::max(enter, std::min(t0, t1));
+			leave = std::min(leave, std::max(t0, t1));
+		}
+		return enter <= leave ? enter : FLT_MAX;
+	}
+
+	GLuint raycastBvh(const bvh &tree, const GLfloat *origin, const GLfloat *direction, const GLfloat maxDistance,
+		GLfloat &distance) {
+		GLuint hit = RT3D_BVH_NONE;
+		distance = maxDistance;
+		if (tree.nodes.empty())
+			return hit;
+		GLfloat inverse[3];
+		for (int i = 0; i < 3; i++)
+			inverse[i] = 1.0f / direction[i];
+		GLuint stack[RT3D_BVH_MAX_DEPTH + 1];
+		int top = 0;
+		if (rayBox(origin, inverse, tree.nodes[0].min, tree.nodes[0].max) <= distance)
+			stack[top++] = 0;
+		while (top > 0) {
+			const bvhNode &node = tree.nodes[stack[--top]];
+			if (node.left) {
+				// visit the nearer child first, so the further one is more often skipped
+				GLfloat nearT = rayBox(origin, inverse, tree.nodes[node.left].min, tree.nodes[node.left].max);
+				GLfloat farT = rayBox(origin, inverse, tree.nodes[node.left + 1].min, tree.nodes[node.left + 1].max);
+				GLuint nearNode = node.left, farNode = node.left + 1;
+				if (farT < nearT) {
+					std::swap(nearT, farT);
+					std::swap(nearNode, farNode);
+				}
+				if (farT <= distance)
+					stack[top++] = farNode;
+				if (nearT <= distance)
+					stack[top++] = nearNode;
+				continue;
+			}
+			for (GLuint i = node.begin; i < node.end; i++) {
+				const GLfloat *box = &tree.boxes[tree.objects[i] * 6];
+				GLfloat t = rayBox(origin, inverse, box, box + 3);
+				if (t < distance || (t == distance && tree.objects[i] < hit)) {
+					distance = t;
+					hit = tree.objects[i];
+				}
+			}
+		}
+		return hit;
+	}
+
+	static GLfloat pointBoxDistance2(const GLfloat *point, const GLfloat *min, const GLfloat *max) {
+		GLfloat d2 = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			GLfloat d = std::max(std::max(min[i] - point[i], point[i] - max[i]), 0.0f);
+			d2 += d * d;
+		}
+		return d2;
+	}
+
+	GLuint nearestBvh(const bvh &tree, const GLfloat *point, const GLfloat maxDistance, GLfloat &distance) {
+		GLuint nearest = RT3D_BVH_NONE;
+		GLfloat best = maxDistance * maxDistance;
+		if (tree.nodes.empty()) {
+			distance = maxDistance;
+			return nearest;
+		}
+		GLuint stack[RT3D_BVH_MAX_DEPTH + 1];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const bvhNode &node = tree.nodes[stack[--top]];
+			if (pointBoxDistance2(point, node.min, node.max) > best)
+				continue;
+			if (node.left) {
+				GLuint nearNode = node.left, farNode = node.left + 1;
+				if (pointBoxDistance2(point, tree.nodes[farNode].min, tree.nodes[farNode].max)
+					< pointBoxDistance2(point, tree.nodes[nearNode].min, tree.nodes[nearNode].max))
+					std::swap(nearNode, farNode);
+				stack[top++] = farNode;
+				stack[top++] = nearNode;
+				continue;
+			}
+			for (GLuint i = node.begin; i < node.end; i++) {
+				const GLfloat *box = &tree.boxes[tree.objects[i] * 6];
+				GLfloat d2 = pointBoxDistance2(point, box, box + 3);
+				if (d2 < best || (d2 == best && tree.objects[i] < nearest)) {
+					best = d2;
+					nearest = tree.objects[i];
+				}
+			}
+		}
+		distance = sqrt(best);
+		return nearest;
+	}
+
+	void transformBox(const meshBounds &bounds, const GLfloat *m, GLfloat *min, GLfloat *max) {
+		for (int i = 0; i < 3; i++) {
+			min[i] = max[i] = m[12 + i];
+			for (int j = 0; j < 3; j++) {
+				GLfloat a = m[j * 4 + i] * bounds.min[j], b = m[j * 4 + i] * bounds.max[j];
+				min[i] += std::min(a, b);
+				max[i] += std::max(a, b);
+			}
+		}
+	}
+
+}
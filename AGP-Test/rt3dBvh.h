@@ -0,0 +1,64 @@
+// rt3dBvh.h
+// Bounding volume hierarchy over scene objects
+//
+// Each object is an axis aligned box in world space, numbered in the order given to buildBvh.
+// The tree is built top down, splitting each node where the surface area heuristic estimates the
+// cheapest traversal, found from the object centres sorted into RT3D_BVH_BINS bins per axis. The
+// two children of a node are stored side by side, and every node's objects are one contiguous run
+// of the objects array, so a node wholly inside the frustum is accepted without testing below it.
+// Objects that move are updated with moveBvhObject, which refits only the boxes above the object,
+// or all at once with setBvhObject and then refitBvh. Refitting never changes the tree, so after
+// a lot of movement the boxes overlap more and queries slow down - rebuild then.
+#ifndef RT3D_BVH
+#define RT3D_BVH
+
+#include "rt3d.h"
+#include "rt3dCulling.h"
+#include <vector>
+
+#define RT3D_BVH_BINS		16
+#define RT3D_BVH_LEAF_SIZE	4		// most objects in a leaf
+#define RT3D_BVH_NONE		0xFFFFFFFF
+#define RT3D_BVH_HALVE_DEPTH	32		// below this, nodes are split in half rather than by cost
+#define RT3D_BVH_MAX_DEPTH	64
+
+namespace rt3d {
+
+	struct bvhNode {
+		GLfloat min[3];
+		GLuint left;		// first child - the second follows it - or 0 in a leaf
+		GLfloat max[3];
+		GLuint begin;		// the objects under this node are objects[begin] to objects[end - 1]
+		GLuint end;
+	};
+
+	struct bvh {
+		std::vector<bvhNode> nodes;			// nodes[0] is the root
+		std::vector<GLuint> objects;		// object numbers, in leaf order
+		std::vector<GLfloat> boxes;			// min xyz, max xyz for each object
+		std::vector<GLuint> parents;		// for each node
+		std::vector<GLuint> objectLeaves;	// for each object
+	};
+
+	// boxes holds 6 floats per object - min xyz then max xyz
+	void buildBvh(bvh &tree, const GLfloat *boxes, const GLuint count);
+	void setBvhObject(bvh &tree, const GLuint object, const GLfloat *min, const GLfloat *max);
+	void refitBvh(bvh &tree);
+	// sets the object's box and refits its ancestors, stopping when a box doesn't change
+	void moveBvhObject(bvh &tree, const GLuint object, const GLfloat *min, const GLfloat *max);
+
+	// appends the objects whose boxes are not wholly outside one of the planes, and returns how many
+	GLuint cullBvh(const bvh &tree, const frustum &view, std::vector<GLuint> &visible);
+	// nearest object whose box the ray enters within maxDistance - direction needn't be unit length,
+	// distances are in multiples of it. Returns RT3D_BVH_NONE if nothing is hit
+	GLuint raycastBvh(const bvh &tree, const GLfloat *origin, const GLfloat *direction, const GLfloat maxDistance,
+		GLfloat &distance);
+	// object whose box is closest to point, within maxDistance, or RT3D_BVH_NONE
+	GLuint nearestBvh(const bvh &tree, const GLfloat *point, const GLfloat maxDistance, GLfloat &distance);
+
+	// world space box of a mesh's bounds moved by a model matrix
+	void transformBox(const meshBounds &bounds, const GLfloat *matrix, GLfloat *min, GLfloat *max);
+
+}
+
+#endif
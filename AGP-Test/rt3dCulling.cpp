@@ -0,0 +1,143 @@
+// rt3dCulling.cpp
+// View frustum culling - see rt3dCulling.h
+
+#include "rt3dCulling.h"
+#include "rt3dSimd.h"
+#include <cmath>
+#include <algorithm>
+
+namespace rt3d {
+
+	void extractFrustum(const GLfloat *m, frustum &result) {
+		// rows of the column major matrix - each plane is the w row plus or minus another
+		for (int p = 0; p < 6; p++) {
+			int row = p / 2;
+			GLfloat sign = (p % 2 == 0) ? 1.0f : -1.0f;
+			GLfloat *plane = result.planes[p];
+			for (int i = 0; i < 4; i++)
+				plane[i] = m[i * 4 + 3] + sign * m[i * 4 + row];
+			GLfloat length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			for (int i = 0; i < 4; i++)
+				plane[i] /= length;
+		}
+	}
+
+	void clearSpheres(boundingSpheres &spheres) {
+		spheres.x.clear();
+		spheres.y.clear();
+		spheres.z.clear();
+		spheres.radius.clear();
+	}
+
+	void addSphere(boundingSpheres &spheres, const meshBounds &bounds, const GLfloat *m) {
+		const GLfloat *c = bounds.centre;
+		spheres.x.push_back(m[0] * c[0] + m[4] * c[1] + m[8] * c[2] + m[12]);
+		spheres.y.push_back(m[1] * c[0] + m[5] * c[1] + m[9] * c[2] + m[13]);
+		spheres.z.push_back(m[2] * c[0] + m[6] * c[1] + m[10] * c[2] + m[14]);
+		GLfloat scale2 = 0.0f;
+		for (int i = 0; i < 3; i++)
+			scale2 = std::max(scale2, m[i * 4] * m[i * 4] + m[i * 4 + 1] * m[i * 4 + 1] + m[i * 4 + 2] * m[i * 4 + 2]);
+		spheres.radius.push_back(bounds.radius * sqrt(scale2));
+	}
+
+	// Sphere test kernels: visible[i] = 1 if sphere i is inside or crossing every plane
+	// The SIMD versions do the same arithmetic in the same order as the scalar loop, so all
+	// three give the same answer for every sphere
+	typedef GLuint (*cullFunction)(const frustum &view, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+		const GLfloat *r, const GLuint count, GLubyte *visible);
+
+	static GLuint cullScalar(const frustum &view, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+		const GLfloat *r, const GLuint count, GLubyte *visible) {
+		GLuint total = 0;
+		for (GLuint i = 0; i < count; i++) {
+			bool inside = true;
+			for (int p = 0; p < 6; p++) {
+				const GLfloat *plane = view.planes[p];
+				GLfloat d = plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + plane[3];
+				inside &= d >= -r[i];
+			}
+			visible[i] = inside ? 1 : 0;
+			total += visible[i];
+		}
+		return total;
+	}
+
+#ifdef RT3D_X86_SIMD
+	static GLuint cullSSE2(const frustum &view, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+		const GLfloat *r, const GLuint count, GLubyte *visible) {
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int i = 0; i < 4; i++)
+				planes[p][i] = _mm_set1_ps(view.planes[p][i]);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		GLuint total = 0, i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+			__m128 negR = _mm_xor_ps(_mm_loadu_ps(r + i), sign);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], px), _mm_mul_ps(planes[p][1], py)),
+					_mm_mul_ps(planes[p][2], pz)), planes[p][3]);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+			}
+			int mask = _mm_movemask_ps(inside);
+			for (int j = 0; j < 4; j++) {
+				visible[i + j] = (mask >> j) & 1;
+				total += visible[i + j];
+			}
+		}
+		return total + cullScalar(view, x + i, y + i, z + i, r + i, count - i, visible + i);
+	}
+
+	RT3D_TARGET_AVX static GLuint cullAVX(const frustum &view, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+		const GLfloat *r, const GLuint count, GLubyte *visible) {
+		__m256 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int i = 0; i < 4; i++)
+				planes[p][i] = _mm256_set1_ps(view.planes[p][i]);
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		GLuint total = 0, i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+			__m256 negR = _mm256_xor_ps(_mm256_loadu_ps(r + i), sign);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], px), _mm256_mul_ps(planes[p][1], py)),
+					_mm256_mul_ps(planes[p][2], pz)), planes[p][3]);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+			}
+			int mask = _mm256_movemask_ps(inside);
+			for (int j = 0; j < 8; j++) {
+				visible[i + j] = (mask >> j) & 1;
+				total += visible[i + j];
+			}
+		}
+		return total + cullScalar(view, x + i, y + i, z + i, r + i, count - i, visible + i);
+	}
+#endif
+
+	// The widest kernel the CPU supports
+	static cullFunction pickCullFunction() {
+#ifdef RT3D_X86_SIMD
+		switch (getSimdLevel()) {
+		case SIMD_AVX: return cullAVX;
+		case SIMD_SSE2: return cullSSE2;
+		default: break;
+		}
+#endif
+		return cullScalar;
+	}
+
+	GLuint cullSpheres(const frustum &view, const boundingSpheres &spheres, std::vector<GLubyte> &visible) {
+		GLuint count = (GLuint) spheres.x.size();
+		visible.resize(count);
+		if (count == 0)
+			return 0;
+		static const cullFunction cull = pickCullFunction();
+		GLuint total = cull(view, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+			spheres.radius.data(), count, visible.data());
+		addCullCounts(total, count - total);
+		return total;
+	}
+
+}
@@ -0,0 +1,42 @@
+// rt3dCulling.h
+// View frustum culling against bounding spheres
+//
+// extractFrustum takes the six planes from a projection matrix - or a projection * view matrix,
+// for things placed by world space model matrices - in the space the matrix transforms from.
+// Spheres are kept as separate x, y, z and radius arrays, so cullSpheres tests four (SSE2) or
+// eight (AVX) of them against a plane at once. A sphere is culled only when it is wholly outside
+// one of the planes, so nothing that could be seen is ever dropped - a few spheres just beyond the
+// corners of the frustum get through instead.
+// Meshes get their bounds when they are created (see rt3d::getMeshBounds); addSphere moves them
+// into the frustum's space. Every test is counted in renderStats as visible or culled.
+#ifndef RT3D_CULLING
+#define RT3D_CULLING
+
+#include "rt3d.h"
+#include <vector>
+
+namespace rt3d {
+
+	// left, right, bottom, top, near, far - a point p is inside a plane if
+	// plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] >= 0
+	struct frustum {
+		GLfloat planes[6][4];
+	};
+
+	struct boundingSpheres {
+		std::vector<GLfloat> x;
+		std::vector<GLfloat> y;
+		std::vector<GLfloat> z;
+		std::vector<GLfloat> radius;
+	};
+
+	void extractFrustum(const GLfloat *matrix, frustum &result);
+	void clearSpheres(boundingSpheres &spheres);
+	// adds the sphere of bounds moved by matrix - the radius grows with the matrix's largest scale
+	void addSphere(boundingSpheres &spheres, const meshBounds &bounds, const GLfloat *matrix);
+	// sets visible[i] to 1 or 0 for each sphere, and returns how many are visible
+	GLuint cullSpheres(const frustum &view, const boundingSpheres &spheres, std::vector<GLubyte> &visible);
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+// rt3dJobs.cpp
+// Work stealing job system - see rt3dJobs.h
+
+#include "rt3dJobs.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdlib>
+
+namespace rt3d {
+
+	struct job {
+		jobFunction function;
+		void *data;
+		GLuint begin;
+		GLuint end;
+		jobGroup *group;
+	};
+
+	struct jobQueue {
+		std::mutex lock;
+		std::deque<job> jobs;
+	};
+
+	// queue 0 belongs to the thread that started the system, the rest to the workers
+	static std::vector<jobQueue *> queues;
+	static std::vector<std::thread> workers;
+	static std::atomic<GLuint> queuedJobs(0);	// lets idle workers sleep
+	static std::mutex sleepLock;
+	static std::condition_variable wake;
+	static bool stopping = false;
+	static thread_local GLuint threadIndex = 0;
+
+	// own queue newest first, then the oldest job from each of the others in turn
+	static bool findJob(const GLuint index, job &found) {
+		for (size_t i = 0; i < queues.size(); i++) {
+			jobQueue &queue = *queues[(index + i) % queues.size()];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.jobs.empty())
+				continue;
+			if (i == 0) {
+				found = queue.jobs.back();
+				queue.jobs.pop_back();
+			}
+			else {
+				found = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+			queuedJobs--;
+			return true;
+		}
+		return false;
+	}
+
+	static void runJob(const job &j) {
+		j.function(j.data, j.begin, j.end);
+		j.group->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	static void workerLoop(const GLuint index) {
+		threadIndex = index;
+		job j;
+		for (;;) {
+			if (findJob(index, j)) {
+				runJob(j);
+				continue;
+			}
+			std::unique_lock<std::mutex> sleep(sleepLock);
+			wake.wait(sleep, [] { return stopping || queuedJobs > 0; });
+			if (stopping)
+				return;
+		}
+	}
+
+	static void pushJob(const GLuint queue, const job &j) {
+		std::lock_guard<std::mutex> guard(queues[queue]->lock);
+		queues[queue]->jobs.push_back(j);
+		queuedJobs++;
+	}
+
+	// taking the lock means a worker can't miss the wake up between checking for jobs and sleeping
+	static void wakeWorkers() {
+		std::lock_guard<std::mutex> sleep(sleepLock);
+		wake.notify_all();
+	}
+
+	void startJobSystem(GLuint threads) {
+		stopJobSystem();
+		// exit() with the workers still running would destroy joinable threads, which aborts
+		static bool stopAtExit = false;
+		if (!stopAtExit) {
+			atexit(stopJobSystem);
+			stopAtExit = true;
+		}
+		if (threads == 0)
+			threads = (GLuint) SDL_GetCPUCount();
+		if (threads < 1)
+			threads = 1;
+		threadIndex = 0;
+		stopping = false;
+		for (GLuint i = 0; i < threads; i++)
+			queues.push_back(new jobQueue());
+		for (GLuint i = 1; i < threads; i++)
+			workers.push_back(std::thread(workerLoop, i));
+	}
+
+	// any jobs still queued are dropped, so wait on their groups first
+	void stopJobSystem() {
+		{
+			std::lock_guard<std::mutex> sleep(sleepLock);
+			stopping = true;
+			wake.notify_all();
+		}
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		workers.clear();
+		for (size_t i = 0; i < queues.size(); i++)
+			delete queues[i];
+		queues.clear();
+		queuedJobs = 0;
+	}
+
+	GLuint getJobThreads() {
+		return queues.empty() ? 1 : (GLuint) queues.size();
+	}
+
+	void addJob(jobGroup &group, const jobFunction function, void *data, const GLuint begin, const GLuint end) {
+		if (queues.size() < 2) {
+			function(data, begin, end);
+			return;
+		}
+		job j = { function, data, begin, end, &group };
+		group.pending++;
+		pushJob(threadIndex, j);
+		wakeWorkers();
+	}
+
+	void parallelFor(jobGroup &group, const jobFunction function, void *data, const GLuint count, const GLuint grain) {
+		GLuint step = grain > 0 ? grain : 1;
+		if (queues.size() < 2) {
+			for (GLuint begin = 0; begin < count; begin += step)
+				function(data, begin, begin + step < count ? begin + step : count);
+			return;
+		}
+		// deal the chunks out round the queues, so the workers start without having to steal
+		GLuint chunks = (count + step - 1) / step;
+		group.pending += chunks;
+		for (GLuint c = 0; c < chunks; c++) {
+			GLuint begin = c * step;
+			job j = { function, data, begin, begin + step < count ? begin + step : count, &group };
+			pushJob((threadIndex + c) % (GLuint) queues.size(), j);
+		}
+		wakeWorkers();
+	}
+
+	void waitJobGroup(jobGroup &group) {
+		job j;
+		while (group.pending.load(std::memory_order_acquire) > 0) {
+			if (findJob(threadIndex, j))
+				runJob(j);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+}
@@ -0,0 +1,41 @@
+// rt3dJobs.h
+// Work stealing job system
+//
+// Each thread in the system has its own queue of jobs. A thread pushes to and pops from the back
+// of its own queue, newest first while the data is still in cache, and when that is empty it
+// steals the oldest job from the front of another thread's queue.
+// parallelFor splits a loop into chunks of grain elements. The chunks depend only on the count and
+// grain, never on the number of threads, so as long as each chunk only writes its own elements the
+// results are the same however many threads there are and whichever thread runs each chunk.
+// A jobGroup counts its unfinished jobs. waitJobGroup is the barrier between the phases of a frame
+// (e.g. animation, then rendering) - the waiting thread runs jobs itself until the group is done.
+// Without startJobSystem, jobs simply run on the thread that adds them.
+#ifndef RT3D_JOBS
+#define RT3D_JOBS
+
+#include "rt3d.h"
+#include <atomic>
+
+namespace rt3d {
+
+	// Runs elements begin to end - 1 of whatever data points to
+	typedef void (*jobFunction)(void *data, const GLuint begin, const GLuint end);
+
+	struct jobGroup {
+		std::atomic<GLuint> pending;
+		jobGroup() : pending(0) {}
+	};
+
+	// threads includes the calling thread, so 1 starts no workers - 0 uses one thread per core
+	// The system is stopped at exit if it is still running, so exitFatalError is safe
+	void startJobSystem(GLuint threads);
+	void stopJobSystem();
+	GLuint getJobThreads();
+	// data must stay valid until the group has been waited on
+	void addJob(jobGroup &group, const jobFunction function, void *data, const GLuint begin, const GLuint end);
+	void parallelFor(jobGroup &group, const jobFunction function, void *data, const GLuint count, const GLuint grain);
+	void waitJobGroup(jobGroup &group);
+
+}
+
+#endif
@@ -0,0 +1,397 @@
+// rt3dLod.cpp
+// Mesh simplification and level of detail selection - see rt3dLod.h
+
+#include "rt3dLod.h"
+#include "rt3dProfiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace rt3d {
+
+	// open edges weigh this much more than the surface, so the outline of an open mesh stays put
+	static const double borderWeight = 10.0;
+
+	// symmetric 4x4 matrix of summed planes, and the total of their weights
+	struct quadric {
+		double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+		double weight;
+	};
+
+	struct collapseCandidate {
+		double cost;
+		GLuint from;
+		GLuint to;
+		GLuint fromVersion;
+		GLuint toVersion;
+		bool operator>(const collapseCandidate &other) const { return cost > other.cost; }
+	};
+
+	static void addPlane(quadric &q, const double a, const double b, const double c, const double d, const double w) {
+		q.xx += w * a * a; q.xy += w * a * b; q.xz += w * a * c; q.xw += w * a * d;
+		q.yy += w * b * b; q.yz += w * b * c; q.yw += w * b * d;
+		q.zz += w * c * c; q.zw += w * c * d;
+		q.ww += w * d * d;
+		q.weight += w;
+	}
+
+	static void addQuadric(quadric &q, const quadric &r) {
+		q.xx += r.xx; q.xy += r.xy; q.xz += r.xz; q.xw += r.xw;
+		q.yy += r.yy; q.yz += r.yz; q.yw += r.yw;
+		q.zz += r.zz; q.zw += r.zw;
+		q.ww += r.ww;
+		q.weight += r.weight;
+	}
+
+	// mean squared distance from p to the planes in q
+	static double quadricError(const quadric &q, const GLfloat *p) {
+		double x = p[0], y = p[1], z = p[2];
+		double e = q.xx * x * x + 2.0 * q.xy * x * y + 2.0 * q.xz * x * z + 2.0 * q.xw * x
+			+ q.yy * y * y + 2.0 * q.yz * y * z + 2.0 * q.yw * y
+			+ q.zz * z * z + 2.0 * q.zw * z + q.ww;
+		return q.weight > 0.0 ? std::max(e, 0.0) / q.weight : 0.0;
+	}
+
+	static void triangleNormal(const GLfloat *a, const GLfloat *b, const GLfloat *c, double *n) {
+		double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = u[1] * v[2] - u[2] * v[1];
+		n[1] = u[2] * v[0] - u[0] * v[2];
+		n[2] = u[0] * v[1] - u[1] * v[0];
+	}
+
+	// squared distance from p to the closest point of triangle abc (from Ericson, Real-Time Collision Detection)
+	static double pointTriangleDistance2(const GLfloat *p, const GLfloat *a, const GLfloat *b, const GLfloat *c) {
+		double ab[3], ac[3], ap[3], bp[3], cp[3];
+		for (int i = 0; i < 3; i++) {
+			ab[i] = b[i] - a[i];
+			ac[i] = c[i] - a[i];
+			ap[i] = p[i] - a[i];
+			bp[i] = p[i] - b[i];
+			cp[i] = p[i] - c[i];
+		}
+		double d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2], d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+		double d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2], d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+		double d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2], d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+		double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+		// barycentric weights of b and c for the closest point, in whichever region p projects to
+		double v, w;
+		if (d1 <= 0.0 && d2 <= 0.0) { v = 0.0; w = 0.0; }
+		else if (d3 >= 0.0 && d4 <= d3) { v = 1.0; w = 0.0; }
+		else if (d6 >= 0.0 && d5 <= d6) { v = 0.0; w = 1.0; }
+		else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) { v = d1 / (d1 - d3); w = 0.0; }
+		else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) { v = 0.0; w = d2 / (d2 - d6); }
+		else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) { w = (d4 - d3) / ((d4 - d3) + (d5 - d6)); v = 1.0 - w; }
+		else { v = vb / (va + vb + vc); w = vc / (va + vb + vc); }
+		double d2sum = 0.0;
+		for (int i = 0; i < 3; i++) {
+			double d = ap[i] - ab[i] * v - ac[i] * w;
+			d2sum += d * d;
+		}
+		return d2sum;
+	}
+
+	// Everything simplifyMesh works on. Vertices are welded by position, so corners refer to the
+	// first vertex at each position, and a vertex collapsed into another is marked removed
+	struct simplifier {
+		const GLfloat *vertices;
+		std::vector<GLuint> corners;
+		std::vector<bool> alive;
+		std::vector<bool> removed;
+		std::vector<GLuint> targets;	// the vertex each removed one was collapsed into
+		std::vector<GLuint> versions;
+		std::vector<quadric> quadrics;
+		std::vector<std::vector<GLuint>> vertexTris;	// may hold triangles that no longer use the vertex
+		std::priority_queue<collapseCandidate, std::vector<collapseCandidate>, std::greater<collapseCandidate>> queue;
+	};
+
+	static bool usesVertex(const simplifier &s, const GLuint t, const GLuint v) {
+		return s.alive[t] && (s.corners[t * 3] == v || s.corners[t * 3 + 1] == v || s.corners[t * 3 + 2] == v);
+	}
+
+	static void pushCandidate(simplifier &s, const GLuint from, const GLuint to) {
+		quadric q = s.quadrics[from];
+		addQuadric(q, s.quadrics[to]);
+		collapseCandidate candidate = { quadricError(q, &s.vertices[to * 3]), from, to, s.versions[from], s.versions[to] };
+		s.queue.push(candidate);
+	}
+
+	static void neighbours(const simplifier &s, const GLuint v, std::vector<GLuint> &result) {
+		result.clear();
+		for (GLuint t : s.vertexTris[v])
+			if (usesVertex(s, t, v))
+				for (int k = 0; k < 3; k++)
+					if (s.corners[t * 3 + k] != v)
+						result.push_back(s.corners[t * 3 + k]);
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+	}
+
+	// A collapse is skipped if it would turn a triangle over or make it degenerate, or if from and
+	// to share a neighbour that isn't across one of their triangles - that would pinch the surface
+	static bool canCollapse(const simplifier &s, const GLuint from, const GLuint to) {
+		GLuint shared = 0;
+		for (GLuint t : s.vertexTris[from]) {
+			if (!usesVertex(s, t, from))
+				continue;
+			if (usesVertex(s, t, to)) {
+				shared++;
+				continue;
+			}
+			const GLfloat *p[3], *q[3];
+			for (int k = 0; k < 3; k++) {
+				GLuint v = s.corners[t * 3 + k];
+				p[k] = &s.vertices[v * 3];
+				q[k] = &s.vertices[(v == from ? to : v) * 3];
+			}
+			double before[3], after[3];
+			triangleNormal(p[0], p[1], p[2], before);
+			triangleNormal(q[0], q[1], q[2], after);
+			double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			if (dot <= 0.0)
+				return false;
+		}
+		static thread_local std::vector<GLuint> fromNeighbours, toNeighbours, common;
+		neighbours(s, from, fromNeighbours);
+		neighbours(s, to, toNeighbours);
+		common.clear();
+		std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(),
+			std::back_inserter(common));
+		return common.size() <= shared;
+	}
+
+	// Moves from onto to, and returns the number of triangles removed
+	static GLuint collapse(simplifier &s, const GLuint from, const GLuint to) {
+		GLuint removedTris = 0;
+		for (GLuint t : s.vertexTris[from]) {
+			if (!usesVertex(s, t, from))
+				continue;
+			if (usesVertex(s, t, to)) {
+				s.alive[t] = false;
+				removedTris++;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+				if (s.corners[t * 3 + k] == from)
+					s.corners[t * 3 + k] = to;
+			s.vertexTris[to].push_back(t);
+		}
+		std::vector<GLuint>().swap(s.vertexTris[from]);
+		addQuadric(s.quadrics[to], s.quadrics[from]);
+		s.removed[from] = true;
+		s.targets[from] = to;
+		s.versions[from]++;
+		s.versions[to]++;
+
+		// drop triangles to no longer uses, then cost its edges afresh
+		std::vector<GLuint> &tris = s.vertexTris[to];
+		tris.erase(std::remove_if(tris.begin(), tris.end(), [&](GLuint t) { return !usesVertex(s, t, to); }), tris.end());
+		std::sort(tris.begin(), tris.end());
+		tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+		static thread_local std::vector<GLuint> around;
+		neighbours(s, to, around);
+		for (GLuint n : around) {
+			pushCandidate(s, to, n);
+			pushCandidate(s, n, to);
+		}
+		return removedTris;
+	}
+
+	// simplifyMesh, for a chain of levels. On entry representatives[v] is the vertex of the input
+	// mesh standing in for vertex v of the full mesh, and on return the one in the result. The error
+	// is measured from every full mesh vertex, so it doesn't build up from level to level
+	static GLfloat simplify(const GLuint numVerts, const GLfloat *vertices, const GLuint indexCount, const GLuint *indices,
+		const GLuint targetIndexCount, std::vector<GLuint> &result, std::vector<GLuint> &representatives) {
+		GLuint triCount = indexCount / 3;
+		simplifier s;
+		s.vertices = vertices;
+
+		// weld vertices at the same position, so seams in the other attributes don't hold the mesh together
+		std::vector<GLuint> order(numVerts), weld(numVerts);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b) {
+			return std::lexicographical_compare(&vertices[a * 3], &vertices[a * 3 + 3], &vertices[b * 3], &vertices[b * 3 + 3]);
+		});
+		for (GLuint i = 0; i < numVerts; i++) {
+			GLuint v = order[i];
+			bool same = i > 0 && std::equal(&vertices[v * 3], &vertices[v * 3 + 3], &vertices[order[i - 1] * 3]);
+			weld[v] = same ? weld[order[i - 1]] : v;
+		}
+
+		s.corners.resize(triCount * 3);
+		s.alive.assign(triCount, true);
+		s.removed.assign(numVerts, false);
+		s.targets.assign(numVerts, 0);
+		s.versions.assign(numVerts, 0);
+		s.quadrics.assign(numVerts, quadric());
+		s.vertexTris.resize(numVerts);
+		GLuint liveTris = 0;
+		std::unordered_map<GLuint64, GLuint> edgeUses;
+		for (GLuint t = 0; t < triCount; t++) {
+			GLuint *c = &s.corners[t * 3];
+			for (int k = 0; k < 3; k++)
+				c[k] = weld[indices[t * 3 + k]];
+			if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+				s.alive[t] = false;
+				continue;
+			}
+			liveTris++;
+			double n[3];
+			triangleNormal(&vertices[c[0] * 3], &vertices[c[1] * 3], &vertices[c[2] * 3], n);
+			double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++) {
+				s.vertexTris[c[k]].push_back(t);
+				GLuint a = std::min(c[k], c[(k + 1) % 3]), b = std::max(c[k], c[(k + 1) % 3]);
+				edgeUses[((GLuint64) a << 32) | b]++;
+			}
+			if (length == 0.0)
+				continue;
+			const GLfloat *p = &vertices[c[0] * 3];
+			double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]) / length;
+			for (int k = 0; k < 3; k++)
+				addPlane(s.quadrics[c[k]], n[0] / length, n[1] / length, n[2] / length, d, length * 0.5);
+		}
+
+		// open edges get a plane through them at right angles to their triangle
+		for (GLuint t = 0; t < triCount; t++) {
+			if (!s.alive[t])
+				continue;
+			const GLuint *c = &s.corners[t * 3];
+			double n[3];
+			triangleNormal(&vertices[c[0] * 3], &vertices[c[1] * 3], &vertices[c[2] * 3], n);
+			for (int k = 0; k < 3; k++) {
+				GLuint a = c[k], b = c[(k + 1) % 3];
+				if (edgeUses[((GLuint64) std::min(a, b) << 32) | std::max(a, b)] != 1)
+					continue;
+				const GLfloat *pa = &vertices[a * 3], *pb = &vertices[b * 3];
+				double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+				double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+				double length = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+				if (length == 0.0)
+					continue;
+				for (int i = 0; i < 3; i++)
+					m[i] /= length;
+				double d = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+				double w = borderWeight * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+				addPlane(s.quadrics[a], m[0], m[1], m[2], d, w);
+				addPlane(s.quadrics[b], m[0], m[1], m[2], d, w);
+			}
+		}
+
+		for (GLuint t = 0; t < triCount; t++) {
+			if (!s.alive[t])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				pushCandidate(s, s.corners[t * 3 + k], s.corners[t * 3 + (k + 1) % 3]);
+				pushCandidate(s, s.corners[t * 3 + (k + 1) % 3], s.corners[t * 3 + k]);
+			}
+		}
+
+		// cheapest collapse first, skipping any costed before one of its ends changed
+		while (liveTris * 3 > targetIndexCount && !s.queue.empty()) {
+			collapseCandidate candidate = s.queue.top();
+			s.queue.pop();
+			if (s.removed[candidate.from] || s.removed[candidate.to] || candidate.fromVersion != s.versions[candidate.from]
+				|| candidate.toVersion != s.versions[candidate.to])
+				continue;
+			if (!canCollapse(s, candidate.from, candidate.to))
+				continue;
+			liveTris -= collapse(s, candidate.from, candidate.to);
+		}
+
+		// The quadrics give a mean error, which can be well under the worst. Instead, the error is how
+		// far each vertex is from the triangles within two edges of the vertex now standing in for it
+		double maxError = 0.0;
+		std::vector<GLuint> ring;
+		for (GLuint v = 0; v < numVerts; v++) {
+			GLuint end = weld[representatives[v]];
+			while (s.removed[end])
+				end = s.targets[end];
+			representatives[v] = end;
+			if (end == weld[v])
+				continue;
+			neighbours(s, end, ring);
+			ring.push_back(end);
+			double nearest = DBL_MAX;
+			for (GLuint centre : ring)
+				for (GLuint t : s.vertexTris[centre])
+					if (usesVertex(s, t, centre)) {
+						const GLuint *c = &s.corners[t * 3];
+						nearest = std::min(nearest, pointTriangleDistance2(&vertices[v * 3], &vertices[c[0] * 3],
+							&vertices[c[1] * 3], &vertices[c[2] * 3]));
+					}
+			if (nearest < DBL_MAX)
+				maxError = std::max(maxError, nearest);
+		}
+
+		// corners that didn't move keep their own vertex, with its normal and tex coords
+		result.clear();
+		result.reserve(liveTris * 3);
+		for (GLuint t = 0; t < triCount; t++) {
+			if (!s.alive[t])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				GLuint original = indices[t * 3 + k];
+				result.push_back(weld[original] == s.corners[t * 3 + k] ? original : s.corners[t * 3 + k]);
+			}
+		}
+		return (GLfloat) sqrt(maxError);
+	}
+
+	GLfloat simplifyMesh(const GLuint numVerts, const GLfloat *vertices, const GLuint indexCount, const GLuint *indices,
+		const GLuint targetIndexCount, std::vector<GLuint> &result) {
+		RT3D_PROFILE("simplifyMesh");
+		std::vector<GLuint> representatives(numVerts);
+		std::iota(representatives.begin(), representatives.end(), 0);
+		return simplify(numVerts, vertices, indexCount, indices, targetIndexCount, result, representatives);
+	}
+
+	void buildLodChain(const GLuint numVerts, const GLfloat *vertices, std::vector<GLuint> &indices, lodChain &lods) {
+		RT3D_PROFILE("buildLodChain");
+		singleLod((GLuint) indices.size(), lods);
+		std::vector<GLuint> level, representatives(numVerts);
+		std::iota(representatives.begin(), representatives.end(), 0);
+		while (lods.count < RT3D_MAX_LODS) {
+			const lodLevel previous = lods.levels[lods.count - 1];
+			if (previous.indexCount / 3 <= RT3D_LOD_MIN_TRIANGLES)
+				break;
+			GLuint target = (GLuint) (previous.indexCount / 3 * RT3D_LOD_REDUCTION) * 3;
+			GLfloat error = simplify(numVerts, vertices, previous.indexCount, &indices[previous.firstIndex], target, level,
+				representatives);
+			// stop once the surface won't give up many more triangles
+			if (level.empty() || level.size() > previous.indexCount * 0.85)
+				break;
+			lodLevel &next = lods.levels[lods.count++];
+			next.firstIndex = (GLuint) indices.size();
+			next.indexCount = (GLuint) level.size();
+			next.error = std::max(error, previous.error);	// so selectLod can stop at the first level that's too coarse
+			indices.insert(indices.end(), level.begin(), level.end());
+		}
+	}
+
+	void singleLod(const GLuint indexCount, lodChain &lods) {
+		lods.count = 1;
+		lods.levels[0].firstIndex = 0;
+		lods.levels[0].indexCount = indexCount;
+		lods.levels[0].error = 0.0f;
+	}
+
+	GLfloat lodPixelScale(const GLfloat fovy, const GLuint viewportHeight) {
+		return viewportHeight / (2.0f * tan(fovy * 0.5f));
+	}
+
+	GLuint selectLod(const lodChain &lods, const GLfloat distance, const GLfloat scale, const GLfloat pixelScale,
+		const GLfloat maxPixelError) {
+		if (distance <= 0.0f)
+			return 0;
+		GLuint level = 0;
+		while (level + 1 < lods.count && lods.levels[level + 1].error * scale * pixelScale <= maxPixelError * distance)
+			level++;
+		return level;
+	}
+
+}
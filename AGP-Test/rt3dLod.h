@@ -0,0 +1,57 @@
+// rt3dLod.h
+// Mesh levels of detail
+//
+// simplifyMesh reduces a triangle mesh by edge collapses, cheapest first, costed with quadric
+// error metrics (Garland and Heckbert) - each vertex keeps the area weighted sum of the planes of
+// its triangles, and collapsing an edge moves one end onto the other, so the simplified mesh only
+// uses vertices it already had. That lets every level of a chain share one vertex buffer, with the
+// levels' indices back to back in one index buffer. Vertices with the same position (seams in the
+// normals or tex coords) collapse together, open edges are held in place by extra planes at right
+// angles to them, and collapses that would flip a triangle or pinch the surface are skipped.
+// Each level records its error - roughly the furthest its surface has moved from the full mesh,
+// in the mesh's own units - and selectLod picks the coarsest level whose error, projected to the
+// screen from a given distance, stays under a pixel budget. Kept below a pixel, the switch from
+// one level to the next is not visible.
+#ifndef RT3D_LOD
+#define RT3D_LOD
+
+#include "rt3d.h"
+#include <vector>
+
+#define RT3D_MAX_LODS			8
+#define RT3D_LOD_MIN_TRIANGLES	64		// no more levels are made once one is this small
+#define RT3D_LOD_REDUCTION		0.5f	// each level aims for this fraction of the one before's triangles
+
+namespace rt3d {
+
+	struct lodLevel {
+		GLuint firstIndex;		// where the level starts in the shared indices
+		GLuint indexCount;
+		GLfloat error;			// in the units of the source positions
+	};
+
+	// levels[0] is the full mesh, and each level after it is coarser
+	struct lodChain {
+		GLuint count;
+		lodLevel levels[RT3D_MAX_LODS];
+	};
+
+	// Simplifies a triangle list to at most targetIndexCount indices, or as near as it can get
+	// without breaking the surface. vertices are xyz, as from loadObj. Returns the error of the result
+	GLfloat simplifyMesh(const GLuint numVerts, const GLfloat *vertices, const GLuint indexCount, const GLuint *indices,
+		const GLuint targetIndexCount, std::vector<GLuint> &result);
+	// indices holds the full mesh on entry, and every level back to back on return
+	void buildLodChain(const GLuint numVerts, const GLfloat *vertices, std::vector<GLuint> &indices, lodChain &lods);
+	// a chain of one level, for meshes that aren't simplified
+	void singleLod(const GLuint indexCount, lodChain &lods);
+
+	// pixels covered by one unit at distance one, for a perspective projection
+	GLfloat lodPixelScale(const GLfloat fovy, const GLuint viewportHeight);
+	// The coarsest level whose error stays within maxPixelError when seen from distance. scale takes
+	// the level errors into world units (e.g. the model matrix's scale), pixelScale from lodPixelScale
+	GLuint selectLod(const lodChain &lods, const GLfloat distance, const GLfloat scale, const GLfloat pixelScale,
+		const GLfloat maxPixelError);
+
+}
+
+#endif
@@ -0,0 +1,307 @@
+// rt3dMeshCache.cpp
+// Binary cache for meshes loaded from OBJ files - see rt3dMeshCache.h
+
+#include "rt3dMeshCache.h"
+#include "rt3dObjLoader.h"
+#include "rt3dMeshOptimizer.h"
+#include "rt3d.h"
+#include "rt3dProfiler.h"
+#include <iostream>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+
+namespace rt3d {
+
+	static const char meshCacheMagic[4] = { 'R', 'T', '3', 'M' };
+
+	static size_t alignBlock(size_t offset) {
+		return (offset + 15) & ~(size_t) 15;
+	}
+
+	// 64 bit FNV-1a
+	static GLuint64 hashBytes(const char *data, size_t length) {
+		GLuint64 hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; i++) {
+			hash ^= (unsigned char) data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static bool sourceStat(const char *filename, GLuint64 &size, GLuint64 &time) {
+		struct stat st;
+		if (stat(filename, &st) != 0)
+			return false;
+		size = (GLuint64) st.st_size;
+		time = (GLuint64) st.st_mtime;
+		return true;
+	}
+
+	static GLuint64 hashFile(const char *filename) {
+		size_t length;
+		const char *data = mapFile(filename, length);
+		GLuint64 hash = hashBytes(data, data ? length : 0);
+		unmapFile(data, length);
+		return hash;
+	}
+
+	// check a mapped cache file is complete and was built from the current source. If the source
+	// has only been touched, newTime is set to its modification time to record in the cache
+	static bool validateMeshCache(const char *data, size_t length, const char *filename, const bool packed,
+		GLuint64 &newTime) {
+		newTime = 0;
+		if (length < sizeof(meshCacheHeader))
+			return false;
+		meshCacheHeader header;
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, meshCacheMagic, 4) != 0 || header.version != RT3D_MESH_CACHE_VERSION
+			|| (header.packed != 0) != packed)
+			return false;
+		GLuint64 indexSize = (header.indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		if (header.format.numAttribs > RT3D_MAX_ATTRIBS
+			|| header.vertexBytes != header.numVerts * (GLuint64) header.format.stride
+			|| header.indexBytes != header.indexCount * indexSize
+			|| header.vertexOffset + header.vertexBytes > length
+			|| header.indexOffset + header.indexBytes > length
+			|| header.lods.count < 1 || header.lods.count > RT3D_MAX_LODS)
+			return false;
+		for (GLuint i = 0; i < header.lods.count; i++)
+			if ((GLuint64) header.lods.levels[i].firstIndex + header.lods.levels[i].indexCount > header.indexCount)
+				return false;
+
+		GLuint64 size, time;
+		if (!sourceStat(filename, size, time))
+			return true; // source not shipped - the cache is all we have
+		if (size == header.sourceSize && time == header.sourceTime)
+			return true;
+		// timestamps change on copies and checkouts, so only rebuild if the contents differ
+		if (size != header.sourceSize || hashFile(filename) != header.sourceHash)
+			return false;
+		newTime = time;
+		return true;
+	}
+
+	// rewrite just the source time in a cache's header, so later loads don't hash the source again
+	static void updateSourceTime(const std::string &cacheName, const GLuint64 time) {
+		FILE *fp = fopen(cacheName.c_str(), "r+b");
+		if (!fp)
+			return;	// e.g. read only - the source is just hashed again next time
+		if (fseek(fp, (long) offsetof(meshCacheHeader, sourceTime), SEEK_SET) == 0)
+			fwrite(&time, sizeof(time), 1, fp);
+		fclose(fp);
+	}
+
+	// point the mesh arrays into a complete cache image
+	static void setMeshPointers(const char *image, objMesh &mesh) {
+		meshCacheHeader header;
+		memcpy(&header, image, sizeof(header));
+		mesh.numVerts = header.numVerts;
+		mesh.indexCount = header.lods.levels[0].indexCount;
+		mesh.lodIndexCount = header.indexCount;
+		mesh.lods = header.lods;
+		mesh.format = header.format;
+		mesh.vertexData = image + header.vertexOffset;
+		mesh.indices = image + header.indexOffset;
+		mesh.indexType = header.indexType;
+		memcpy(mesh.positionScale, header.positionScale, sizeof(mesh.positionScale));
+		memcpy(mesh.positionBias, header.positionBias, sizeof(mesh.positionBias));
+	}
+
+	// an empty mesh, as left by a failed load or freeObjMesh - the mapping must already be released
+	static void clearObjMesh(objMesh &mesh) {
+		mesh.numVerts = mesh.indexCount = mesh.lodIndexCount = 0;
+		mesh.lods = lodChain();
+		mesh.format = vertexFormat();
+		mesh.vertexData = nullptr;
+		mesh.indices = nullptr;
+		mesh.indexType = GL_UNSIGNED_INT;
+		for (int i = 0; i < 3; i++) {
+			mesh.positionScale[i] = 1.0f;
+			mesh.positionBias[i] = 0.0f;
+		}
+		mesh.mapping = nullptr;
+		mesh.mappingSize = 0;
+		std::vector<char>().swap(mesh.storage);
+	}
+
+	static bool mapMeshCache(const std::string &cacheName, const char *filename, const bool packed, objMesh &mesh) {
+		size_t length;
+		const char *data = mapFile(cacheName.c_str(), length);
+		if (data == nullptr)
+			return false;
+		GLuint64 newTime;
+		if (!validateMeshCache(data, length, filename, packed, newTime)) {
+			std::cout << "mesh cache " << cacheName << " is out of date" << std::endl;
+			unmapFile(data, length);
+			return false;
+		}
+		if (newTime != 0) {
+			// unmapped first, as Windows won't write to a mapped file
+			unmapFile(data, length);
+			updateSourceTime(cacheName, newTime);
+			data = mapFile(cacheName.c_str(), length);
+			if (data == nullptr || !validateMeshCache(data, length, filename, packed, newTime)) {
+				unmapFile(data, length);
+				return false;
+			}
+		}
+		mesh.mapping = data;
+		mesh.mappingSize = length;
+		setMeshPointers(data, mesh);
+		return true;
+	}
+
+	// lay out header and data blocks exactly as they will appear on disk
+	static void buildMeshImage(const char *filename, const GLuint numVerts, const GLuint indexCount, const bool packed,
+		const lodChain &lods, const packedVertices &data, std::vector<char> &image) {
+
+		meshCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, meshCacheMagic, 4);
+		header.version = RT3D_MESH_CACHE_VERSION;
+		header.numVerts = numVerts;
+		header.indexCount = indexCount;
+		header.indexType = data.indexType;
+		header.packed = packed;
+		memcpy(header.positionScale, data.positionScale, sizeof(header.positionScale));
+		memcpy(header.positionBias, data.positionBias, sizeof(header.positionBias));
+		header.format = data.format;
+		header.lods = lods;
+		sourceStat(filename, header.sourceSize, header.sourceTime);
+		header.sourceHash = hashFile(filename);
+
+		header.vertexOffset = alignBlock(sizeof(header));
+		header.vertexBytes = data.vertexData.size();
+		header.indexOffset = alignBlock((size_t) (header.vertexOffset + header.vertexBytes));
+		header.indexBytes = data.indexData.size();
+
+		image.assign((size_t) (header.indexOffset + header.indexBytes), 0);
+		memcpy(image.data(), &header, sizeof(header));
+		if (!data.vertexData.empty())
+			memcpy(image.data() + header.vertexOffset, data.vertexData.data(), data.vertexData.size());
+		if (!data.indexData.empty())
+			memcpy(image.data() + header.indexOffset, data.indexData.data(), data.indexData.size());
+	}
+
+	// the unpacked layout - interleaved floats and 32 bit indices
+	static void interleaveMesh(const std::vector<GLfloat> &verts, const std::vector<GLfloat> &norms,
+		const std::vector<GLfloat> &texcoords, const std::vector<GLuint> &indices, packedVertices &data) {
+		GLuint numVerts = (GLuint) (verts.size() / 3);
+		bool hasNormals = !norms.empty() && norms.size() == verts.size();
+		bool hasTexCoords = !texcoords.empty() && texcoords.size() / 2 == numVerts;
+		data.format = makeVertexFormat(false, hasNormals, hasTexCoords);
+		data.indexType = GL_UNSIGNED_INT;
+		for (int i = 0; i < 3; i++) {
+			data.positionScale[i] = 1.0f;
+			data.positionBias[i] = 0.0f;
+		}
+		data.vertexData.resize(numVerts * data.format.stride);
+		interleaveVertices(numVerts, verts.data(), nullptr, hasNormals ? norms.data() : nullptr,
+			hasTexCoords ? texcoords.data() : nullptr, data.format, data.vertexData.data());
+		data.indexData.resize(indices.size() * sizeof(GLuint));
+		if (!indices.empty())
+			memcpy(data.indexData.data(), indices.data(), indices.size() * sizeof(GLuint));
+	}
+
+	// reorder each level's triangles for the vertex cache and overdraw, then the vertices for fetch locality.
+	// This only runs when the cache is rebuilt, so meshes load already optimised
+	static void optimizeMesh(const char *filename, std::vector<GLfloat> &verts, std::vector<GLfloat> &norms,
+		std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices, const lodChain &lods) {
+		// how much worse than the vertex cache order the overdraw order may be - below 1 leaves it alone
+		static const GLfloat overdrawThreshold = 1.05f;
+		GLuint numVerts = (GLuint) (verts.size() / 3);
+		vertexCacheStats before = analyzeVertexCache(indices.data(), lods.levels[0].indexCount, numVerts, RT3D_VERTEX_CACHE_SIZE);
+		for (GLuint i = 0; i < lods.count; i++) {
+			GLuint *levelIndices = indices.data() + lods.levels[i].firstIndex;
+			optimizeVertexCache(levelIndices, lods.levels[i].indexCount, numVerts);
+			optimizeOverdraw(levelIndices, lods.levels[i].indexCount, verts.data(), numVerts, overdrawThreshold);
+		}
+		vertexCacheStats after = analyzeVertexCache(indices.data(), lods.levels[0].indexCount, numVerts, RT3D_VERTEX_CACHE_SIZE);
+
+		std::vector<GLuint> remap;
+		optimizeVertexFetch(indices.data(), (GLuint) indices.size(), numVerts, remap);
+		remapVertexArray(verts, 3, remap);
+		if (norms.size() == verts.size())
+			remapVertexArray(norms, 3, remap);
+		if (!texcoords.empty() && texcoords.size() / 2 == numVerts)
+			remapVertexArray(texcoords, 2, remap);
+		std::cout << "optimized " << filename << ": ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
+
+	// write to a temporary file first, so a crash can never leave a truncated cache behind
+	static bool writeMeshCache(const std::string &cacheName, const std::vector<char> &image) {
+		std::string tmpName = cacheName + ".tmp";
+		FILE *fp = fopen(tmpName.c_str(), "wb");
+		if (!fp)
+			return false;
+		bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+		ok = (fclose(fp) == 0) && ok;
+		remove(cacheName.c_str());
+		if (!ok || rename(tmpName.c_str(), cacheName.c_str()) != 0) {
+			remove(tmpName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool loadObjCached(const char* filename, objMesh &mesh) {
+		return loadObjCached(filename, mesh, false);
+	}
+
+	bool loadObjCached(const char* filename, objMesh &mesh, const bool packed) {
+		RT3D_PROFILE("loadObjCached");
+		clearObjMesh(mesh);
+
+		std::string cacheName = std::string(filename) + (packed ? ".rt3dpack" : ".rt3dmesh");
+		if (mapMeshCache(cacheName, filename, packed, mesh))
+			return true;
+
+		// no usable cache - parse the OBJ, then write and map a fresh cache
+		std::vector<GLfloat> verts;
+		std::vector<GLfloat> norms;
+		std::vector<GLfloat> texcoords;
+		std::vector<GLuint> indices;
+		loadObj(filename, verts, norms, texcoords, indices, 0);
+		if (verts.empty() || indices.empty())
+			return false;	// missing or no faces - the mesh is left empty
+
+		GLuint numVerts = (GLuint) (verts.size() / 3);
+		lodChain lods;
+		buildLodChain(numVerts, verts.data(), indices, lods);
+		optimizeMesh(filename, verts, norms, texcoords, indices, lods);
+		bool hasNormals = !norms.empty() && norms.size() == verts.size();
+		bool hasTexCoords = !texcoords.empty() && texcoords.size() / 2 == numVerts;
+		packedVertices data;
+		if (packed)
+			packVertices(numVerts, verts.data(), hasNormals ? norms.data() : nullptr, hasTexCoords ? texcoords.data() : nullptr,
+				(GLuint) indices.size(), indices.data(), data);
+		else
+			interleaveMesh(verts, norms, texcoords, indices, data);
+
+		std::vector<char> image;
+		buildMeshImage(filename, numVerts, (GLuint) indices.size(), packed, lods, data, image);
+		if (writeMeshCache(cacheName, image)) {
+			std::cout << "wrote mesh cache " << cacheName << " (" << image.size() / 1024 << " KB, " << lods.count
+				<< " LOD levels)" << std::endl;
+			if (mapMeshCache(cacheName, filename, packed, mesh))
+				return true;
+		}
+		else
+			std::cout << "Unable to write mesh cache " << cacheName << std::endl;
+
+		// could not write the cache (e.g. read only directory) - keep the image in memory instead
+		mesh.storage.swap(image);
+		setMeshPointers(mesh.storage.data(), mesh);
+		return true;
+	}
+
+	void freeObjMesh(objMesh &mesh) {
+		unmapFile(mesh.mapping, mesh.mappingSize);
+		clearObjMesh(mesh);
+	}
+
+}
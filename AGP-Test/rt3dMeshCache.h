@@ -0,0 +1,79 @@
+// rt3dMeshCache.h
+// Binary cache for meshes loaded from OBJ files
+//
+// The first time a model is loaded the OBJ is parsed as normal and the result written next to it
+// as <filename>.rt3dmesh. Later loads memory map that file instead of parsing, and the interleaved
+// vertex data and index array in an objMesh point straight into the mapping, so they can be handed
+// to createInterleavedMesh without any intermediate copies.
+// The cache stores the size, modification time and a hash of the OBJ it was built from, and is
+// rebuilt automatically if the OBJ changes. If only the time has changed (e.g. after a checkout)
+// the new time is written to the cache, so the OBJ is hashed once rather than on every load.
+// Meshes can optionally be stored in the packed format from rt3d::packVertices, in a separate
+// <filename>.rt3dpack cache.
+// The cache is also where a mesh's LOD chain is made (see rt3dLod.h): the index block holds every
+// level back to back, so uploading lodIndexCount indices puts them all in one index buffer.
+// Each level's triangles and then the vertices are reordered for the GPU caches on the way in
+// (see rt3dMeshOptimizer.h), so that costs nothing once the cache exists.
+#ifndef RT3D_MESH_CACHE
+#define RT3D_MESH_CACHE
+
+#include "rt3d.h"
+#include "rt3dLod.h"
+#include <cstddef>
+#include <vector>
+
+#define RT3D_MESH_CACHE_VERSION 5
+
+namespace rt3d {
+
+	// File layout: header, then vertex block, then index block - blocks are 16 byte aligned
+	// The vertex block is interleaved, laid out as described by format
+	struct meshCacheHeader {
+		char magic[4];			// "RT3M"
+		GLuint version;			// RT3D_MESH_CACHE_VERSION
+		GLuint numVerts;
+		GLuint indexCount;		// in the index block - every LOD level
+		GLenum indexType;		// GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+		GLuint packed;			// non zero if built by packVertices
+		GLfloat positionScale[3];
+		GLfloat positionBias[3];
+		vertexFormat format;
+		lodChain lods;
+		GLuint64 sourceSize;	// size, modification time and FNV-1a hash of the source OBJ
+		GLuint64 sourceTime;
+		GLuint64 sourceHash;
+		GLuint64 vertexOffset;	// from start of file
+		GLuint64 vertexBytes;
+		GLuint64 indexOffset;
+		GLuint64 indexBytes;
+	};
+
+	// A loaded mesh - pointers are into the mapped cache file (or into storage if
+	// the cache could not be written) and stay valid until freeObjMesh is called
+	struct objMesh {
+		GLuint numVerts;
+		GLuint indexCount;			// the full detail mesh - the first LOD level
+		GLuint lodIndexCount;		// ... and every level, back to back
+		lodChain lods;
+		vertexFormat format;
+		const void *vertexData;		// numVerts * format.stride bytes
+		const void *indices;		// of type indexType
+		GLenum indexType;
+		// positions decode as position = stored * positionScale + positionBias
+		// (scale 1 and bias 0 unless the mesh is packed)
+		GLfloat positionScale[3];
+		GLfloat positionBias[3];
+
+		const char *mapping;
+		size_t mappingSize;
+		std::vector<char> storage;
+	};
+
+	// false if the OBJ is missing or has no faces, with the mesh left empty
+	bool loadObjCached(const char* filename, objMesh &mesh);
+	bool loadObjCached(const char* filename, objMesh &mesh, const bool packed);
+	void freeObjMesh(objMesh &mesh);
+
+}
+
+#endif
@@ -0,0 +1,254 @@
+// rt3dMeshOptimizer.cpp
+// Triangle and vertex reordering - see rt3dMeshOptimizer.h
+
+#include "rt3dMeshOptimizer.h"
+#include "rt3dProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#define RT3D_NO_TRIANGLE 0xFFFFFFFF
+
+namespace rt3d {
+
+	// the cache optimizeVertexCache plans for - larger than most real ones, as in Forsyth's article,
+	// which does no harm on smaller caches
+	static const int forsythCacheSize = 32;
+	static const int forsythMaxValence = 32;
+
+	// Forsyth's scores: the three vertices just used are worth the same, so the order within a
+	// triangle doesn't matter, older ones less the further back they are, and vertices with few
+	// triangles left are boosted so they get finished off rather than left behind
+	struct forsythScores {
+		float cache[forsythCacheSize];
+		float valence[forsythMaxValence + 1];
+		forsythScores() {
+			for (int i = 0; i < forsythCacheSize; i++)
+				cache[i] = i < 3 ? 0.75f : pow(1.0f - (i - 3) / (float) (forsythCacheSize - 3), 1.5f);
+			valence[0] = 0.0f;
+			for (int i = 1; i <= forsythMaxValence; i++)
+				valence[i] = 2.0f / sqrt((float) i);
+		}
+	};
+
+	static float vertexScore(const forsythScores &scores, const int cachePosition, const GLuint remaining) {
+		if (remaining == 0)
+			return -1.0f;
+		return (cachePosition >= 0 ? scores.cache[cachePosition] : 0.0f)
+			+ scores.valence[std::min(remaining, (GLuint) forsythMaxValence)];
+	}
+
+	vertexCacheStats analyzeVertexCache(const GLuint *indices, const GLuint indexCount, const GLuint numVerts,
+		const GLuint cacheSize) {
+		// a vertex is in the FIFO if fewer than cacheSize vertices have been added since it was
+		std::vector<GLuint> added(numVerts, 0);
+		GLuint time = cacheSize + 1, misses = 0, used = 0;
+		for (GLuint i = 0; i < indexCount; i++) {
+			GLuint v = indices[i];
+			if (added[v] == 0)
+				used++;
+			if (time - added[v] > cacheSize) {
+				added[v] = time++;
+				misses++;
+			}
+		}
+		vertexCacheStats stats;
+		stats.acmr = indexCount ? misses / (indexCount / 3.0f) : 0.0f;
+		stats.atvr = used ? misses / (GLfloat) used : 0.0f;
+		return stats;
+	}
+
+	void optimizeVertexCache(GLuint *indices, const GLuint indexCount, const GLuint numVerts) {
+		RT3D_PROFILE("optimizeVertexCache");
+		static const forsythScores scores;
+		GLuint triCount = indexCount / 3;
+		if (triCount == 0)
+			return;
+
+		// each vertex's triangles, with the ones not yet drawn first in its range
+		std::vector<GLuint> first(numVerts + 1, 0), remaining(numVerts, 0), adjacency(indexCount);
+		for (GLuint i = 0; i < indexCount; i++)
+			remaining[indices[i]]++;
+		for (GLuint v = 0; v < numVerts; v++)
+			first[v + 1] = first[v] + remaining[v];
+		std::vector<GLuint> filled(first.begin(), first.end() - 1);
+		for (GLuint i = 0; i < indexCount; i++)
+			adjacency[filled[indices[i]]++] = i / 3;
+
+		std::vector<int> cachePosition(numVerts, -1);
+		std::vector<float> vertexScores(numVerts), triangleScores(triCount, 0.0f);
+		for (GLuint v = 0; v < numVerts; v++)
+			vertexScores[v] = vertexScore(scores, -1, remaining[v]);
+		GLuint best = 0;
+		for (GLuint t = 0; t < triCount; t++) {
+			for (int k = 0; k < 3; k++)
+				triangleScores[t] += vertexScores[indices[t * 3 + k]];
+			if (triangleScores[t] > triangleScores[best])
+				best = t;
+		}
+
+		std::vector<GLuint> result(indexCount), cache, newCache;
+		std::vector<bool> drawn(triCount, false);
+		GLuint next = 0;	// every triangle before this has been drawn
+		for (GLuint i = 0; i < triCount; i++) {
+			if (best == RT3D_NO_TRIANGLE) {
+				// nothing in the cache has triangles left - start again from the next one not drawn
+				while (drawn[next])
+					next++;
+				best = next;
+			}
+			drawn[best] = true;
+			const GLuint *tri = &indices[best * 3];
+			newCache.assign(tri, tri + 3);
+			for (int k = 0; k < 3; k++) {
+				GLuint v = tri[k];
+				result[i * 3 + k] = v;
+				GLuint *begin = &adjacency[first[v]], *end = begin + remaining[v];
+				std::swap(*std::find(begin, end, best), end[-1]);
+				remaining[v]--;
+			}
+			for (GLuint v : cache)
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					newCache.push_back(v);
+
+			// rescore every vertex that moved in the cache, including those pushed out of it,
+			// and their triangles, then draw the best scoring triangle with a vertex in the cache next
+			for (size_t c = 0; c < newCache.size(); c++) {
+				GLuint v = newCache[c];
+				cachePosition[v] = c < (size_t) forsythCacheSize ? (int) c : -1;
+				float score = vertexScore(scores, cachePosition[v], remaining[v]);
+				float change = score - vertexScores[v];
+				vertexScores[v] = score;
+				for (GLuint j = first[v]; j < first[v] + remaining[v]; j++)
+					triangleScores[adjacency[j]] += change;
+			}
+			if (newCache.size() > (size_t) forsythCacheSize)
+				newCache.resize(forsythCacheSize);
+			cache.swap(newCache);
+			best = RT3D_NO_TRIANGLE;
+			float bestScore = -1.0f;
+			for (GLuint v : cache)
+				for (GLuint j = first[v]; j < first[v] + remaining[v]; j++)
+					if (triangleScores[adjacency[j]] > bestScore) {
+						bestScore = triangleScores[adjacency[j]];
+						best = adjacency[j];
+					}
+		}
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	// FIFO cache misses for one triangle, for cutting the triangles into clusters
+	static GLuint triangleMisses(const GLuint *tri, std::vector<GLuint> &added, GLuint &time) {
+		GLuint misses = 0;
+		for (int k = 0; k < 3; k++)
+			if (time - added[tri[k]] > RT3D_VERTEX_CACHE_SIZE) {
+				added[tri[k]] = time++;
+				misses++;
+			}
+		return misses;
+	}
+
+	void optimizeOverdraw(GLuint *indices, const GLuint indexCount, const GLfloat *vertices, const GLuint numVerts,
+		const GLfloat threshold) {
+		RT3D_PROFILE("optimizeOverdraw");
+		GLuint triCount = indexCount / 3;
+		if (triCount == 0 || threshold < 1.0f)
+			return;
+
+		// hard boundaries, where the cache starts again - a triangle with none of its vertices cached
+		std::vector<GLuint> added(numVerts, 0), hard, clusters;
+		GLuint time = RT3D_VERTEX_CACHE_SIZE + 1;
+		for (GLuint t = 0; t < triCount; t++)
+			if (triangleMisses(&indices[t * 3], added, time) == 3)
+				hard.push_back(t);
+		hard.push_back(triCount);
+
+		// soft boundaries, which cut each of those into pieces no worse than threshold times its misses
+		for (size_t h = 0; h + 1 < hard.size(); h++) {
+			GLuint start = hard[h], end = hard[h + 1], misses = 0;
+			time += RT3D_VERTEX_CACHE_SIZE + 1;		// empties the cache
+			for (GLuint t = start; t < end; t++)
+				misses += triangleMisses(&indices[t * 3], added, time);
+			GLfloat limit = threshold * misses / (end - start);
+			clusters.push_back(start);
+			time += RT3D_VERTEX_CACHE_SIZE + 1;
+			misses = 0;
+			for (GLuint t = start; t < end; t++) {
+				misses += triangleMisses(&indices[t * 3], added, time);
+				if (t + 1 < end && misses <= limit * (t + 1 - clusters.back())) {
+					clusters.push_back(t + 1);
+					time += RT3D_VERTEX_CACHE_SIZE + 1;
+					misses = 0;
+				}
+			}
+		}
+		clusters.push_back(triCount);
+
+		// each cluster's area weighted centre and normal, and the mesh's centre
+		GLuint clusterCount = (GLuint) clusters.size() - 1;
+		std::vector<double> centres(clusterCount * 3, 0.0), normals(clusterCount * 3, 0.0), areas(clusterCount, 0.0);
+		double meshCentre[3] = { 0.0, 0.0, 0.0 }, meshArea = 0.0;
+		for (GLuint c = 0; c < clusterCount; c++) {
+			for (GLuint t = clusters[c]; t < clusters[c + 1]; t++) {
+				const GLfloat *p0 = &vertices[indices[t * 3] * 3], *p1 = &vertices[indices[t * 3 + 1] * 3];
+				const GLfloat *p2 = &vertices[indices[t * 3 + 2] * 3];
+				double u[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				double v[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+				double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int i = 0; i < 3; i++) {
+					centres[c * 3 + i] += area * (p0[i] + p1[i] + p2[i]) / 3.0;
+					normals[c * 3 + i] += n[i];
+				}
+				areas[c] += area;
+			}
+			for (int i = 0; i < 3; i++)
+				meshCentre[i] += centres[c * 3 + i];
+			meshArea += areas[c];
+		}
+		for (int i = 0; i < 3; i++)
+			meshCentre[i] = meshArea > 0.0 ? meshCentre[i] / meshArea : 0.0;
+
+		// clusters facing furthest away from the centre come first
+		std::vector<double> facing(clusterCount, 0.0);
+		for (GLuint c = 0; c < clusterCount; c++) {
+			const double *n = &normals[c * 3];
+			double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (areas[c] == 0.0 || length == 0.0)
+				continue;
+			for (int i = 0; i < 3; i++)
+				facing[c] += (centres[c * 3 + i] / areas[c] - meshCentre[i]) * n[i] / length;
+		}
+		std::vector<GLuint> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](GLuint a, GLuint b) { return facing[a] > facing[b]; });
+
+		std::vector<GLuint> result;
+		result.reserve(indexCount);
+		for (GLuint c : order)
+			result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	void optimizeVertexFetch(GLuint *indices, const GLuint indexCount, const GLuint numVerts, std::vector<GLuint> &remap) {
+		const GLuint unused = 0xFFFFFFFF;
+		remap.assign(numVerts, unused);
+		GLuint next = 0;
+		for (GLuint i = 0; i < indexCount; i++) {
+			if (remap[indices[i]] == unused)
+				remap[indices[i]] = next++;
+			indices[i] = remap[indices[i]];
+		}
+		for (GLuint v = 0; v < numVerts; v++)
+			if (remap[v] == unused)
+				remap[v] = next++;
+	}
+
+	void remapVertexArray(std::vector<GLfloat> &data, const GLuint components, const std::vector<GLuint> &remap) {
+		std::vector<GLfloat> result(data.size());
+		for (size_t v = 0; v < remap.size(); v++)
+			std::copy(&data[v * components], &data[v * components] + components, &result[remap[v] * components]);
+		data.swap(result);
+	}
+
+}
@@ -0,0 +1,227 @@
+// rt3dMeshPool.cpp
+// Shared vertex and index buffers for static meshes - see rt3dMeshPool.h
+
+#include "rt3dMeshPool.h"
+#include <cstring>
+
+namespace rt3d {
+
+	// layout of one command in the GL_DRAW_INDIRECT_BUFFER
+	struct drawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// first fit - returns false if no free range is big enough
+	static bool allocateRange(std::vector<poolRange> &freeList, const GLuint count, GLuint &start) {
+		for (size_t i = 0; i < freeList.size(); i++) {
+			if (freeList[i].count < count)
+				continue;
+			start = freeList[i].start;
+			freeList[i].start += count;
+			freeList[i].count -= count;
+			if (freeList[i].count == 0)
+				freeList.erase(freeList.begin() + i);
+			return true;
+		}
+		return false;
+	}
+
+	// put a range back, merging it with its neighbours
+	static void freeRange(std::vector<poolRange> &freeList, const GLuint start, const GLuint count) {
+		if (count == 0)
+			return;
+		size_t i = 0;
+		while (i < freeList.size() && freeList[i].start < start)
+			i++;
+		poolRange range = { start, count };
+		freeList.insert(freeList.begin() + i, range);
+		if (i + 1 < freeList.size() && freeList[i].start + freeList[i].count == freeList[i + 1].start) {
+			freeList[i].count += freeList[i + 1].count;
+			freeList.erase(freeList.begin() + i + 1);
+		}
+		if (i > 0 && freeList[i - 1].start + freeList[i - 1].count == freeList[i].start) {
+			freeList[i - 1].count += freeList[i].count;
+			freeList.erase(freeList.begin() + i);
+		}
+	}
+
+	static const vertexAttribFormat* findAttrib(const vertexFormat &format, const GLuint index) {
+		for (GLuint a = 0; a < format.numAttribs; a++)
+			if (format.attribs[a].index == index)
+				return &format.attribs[a];
+		return nullptr;
+	}
+
+	static GLuint attribBytes(const vertexAttribFormat &attrib) {
+		if (attrib.type == GL_INT_2_10_10_10_REV || attrib.type == GL_UNSIGNED_INT_2_10_10_10_REV)
+			return 4;
+		GLuint componentSize = (attrib.type == GL_FLOAT || attrib.type == GL_INT || attrib.type == GL_UNSIGNED_INT) ? 4
+			: (attrib.type == GL_SHORT || attrib.type == GL_UNSIGNED_SHORT || attrib.type == GL_HALF_FLOAT) ? 2 : 1;
+		return attrib.size * componentSize;
+	}
+
+	static bool sameAttrib(const vertexAttribFormat &a, const vertexAttribFormat &b) {
+		return a.index == b.index && a.size == b.size && a.type == b.type && a.normalized == b.normalized
+			&& a.offset == b.offset;
+	}
+
+	static bool sameFormat(const vertexFormat &a, const vertexFormat &b) {
+		if (a.stride != b.stride || a.numAttribs != b.numAttribs)
+			return false;
+		for (GLuint i = 0; i < a.numAttribs; i++)
+			if (!sameAttrib(a.attribs[i], b.attribs[i]))
+				return false;
+		return true;
+	}
+
+	// every attribute the two formats share must be stored the same way - convertVertices only copies them
+	static bool compatibleFormat(const vertexFormat &srcFormat, const vertexFormat &dstFormat) {
+		for (GLuint a = 0; a < dstFormat.numAttribs; a++) {
+			const vertexAttribFormat &to = dstFormat.attribs[a];
+			const vertexAttribFormat *from = findAttrib(srcFormat, to.index);
+			if (from && (from->type != to.type || from->size != to.size || from->normalized != to.normalized))
+				return false;
+		}
+		return true;
+	}
+
+	// copy vertices from one interleaved layout to another, attribute by attribute - see compatibleFormat
+	static void convertVertices(const GLuint numVerts, const void *src, const vertexFormat &srcFormat,
+		const vertexFormat &dstFormat, char *dst) {
+		if (sameFormat(srcFormat, dstFormat)) {
+			memcpy(dst, src, numVerts * dstFormat.stride);
+			return;
+		}
+		memset(dst, 0, numVerts * dstFormat.stride);
+		for (GLuint a = 0; a < dstFormat.numAttribs; a++) {
+			const vertexAttribFormat &to = dstFormat.attribs[a];
+			const vertexAttribFormat *from = findAttrib(srcFormat, to.index);
+			if (!from)
+				continue;	// the mesh doesn't have it, so it stays zero
+			GLuint bytes = attribBytes(to);
+			for (GLuint v = 0; v < numVerts; v++)
+				memcpy(dst + v * dstFormat.stride + to.offset, (const char *) src + v * srcFormat.stride + from->offset, bytes);
+		}
+	}
+
+	void createMeshPool(meshPool &pool, const vertexFormat &format, const GLuint maxVerts, const GLuint maxIndices) {
+		pool.format = format;
+		pool.vertexCapacity = maxVerts;
+		pool.indexCapacity = maxIndices;
+		pool.freeVertices.assign(1, poolRange());
+		pool.freeVertices[0].start = 0;
+		pool.freeVertices[0].count = maxVerts;
+		pool.freeIndices.assign(1, poolRange());
+		pool.freeIndices[0].start = 0;
+		pool.freeIndices[0].count = maxIndices;
+		// multi draw indirect needs baseInstance too, which is core from 4.2
+		pool.multiDraw = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+
+		glGenVertexArrays(1, &pool.vao);
+		bindVertexArray(pool.vao);
+
+		glGenBuffers(1, &pool.vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) maxVerts * format.stride, nullptr, GL_STATIC_DRAW);
+		for (GLuint a = 0; a < format.numAttribs; a++) {
+			const vertexAttribFormat &attrib = format.attribs[a];
+			glVertexAttribPointer(attrib.index, attrib.size, attrib.type, attrib.normalized, format.stride,
+				(const GLvoid *) (size_t) attrib.offset);
+			glEnableVertexAttribArray(attrib.index);
+		}
+
+		glGenBuffers(1, &pool.indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) maxIndices * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+		bindVertexArray(0);
+	}
+
+	void deleteMeshPool(meshPool &pool) {
+		bindVertexArray(0);
+		glDeleteVertexArrays(1, &pool.vao);
+		glDeleteBuffers(1, &pool.vertexBuffer);
+		glDeleteBuffers(1, &pool.indexBuffer);
+		pool.vao = pool.vertexBuffer = pool.indexBuffer = 0;
+		pool.freeVertices.clear();
+		pool.freeIndices.clear();
+	}
+
+	bool addPoolMesh(meshPool &pool, const GLuint numVerts, const void *vertexData, const vertexFormat &format,
+		const GLuint indexCount, const void *indices, const GLenum indexType, poolMesh &mesh) {
+		if (!compatibleFormat(format, pool.format))
+			return false;
+		if (!allocateRange(pool.freeVertices, numVerts, mesh.baseVertex))
+			return false;
+		if (!allocateRange(pool.freeIndices, indexCount, mesh.firstIndex)) {
+			freeRange(pool.freeVertices, mesh.baseVertex, numVerts);
+			return false;
+		}
+		mesh.numVerts = numVerts;
+		mesh.indexCount = indexCount;
+		mesh.hasBounds = computeBounds(numVerts, vertexData, format, mesh.bounds);
+
+		std::vector<char> vertices(numVerts * pool.format.stride);
+		convertVertices(numVerts, vertexData, format, pool.format, vertices.data());
+		glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) mesh.baseVertex * pool.format.stride, vertices.size(), vertices.data());
+
+		// the pool always uses 32 bit indices
+		std::vector<GLuint> wideIndices(indexCount);
+		for (GLuint i = 0; i < indexCount; i++)
+			wideIndices[i] = (indexType == GL_UNSIGNED_SHORT) ? ((const GLushort *) indices)[i] : ((const GLuint *) indices)[i];
+		// the element array binding belongs to the VAO, so bind that first
+		bindVertexArray(pool.vao);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr) mesh.firstIndex * sizeof(GLuint),
+			indexCount * sizeof(GLuint), wideIndices.data());
+		return true;
+	}
+
+	void removePoolMesh(meshPool &pool, const poolMesh &mesh) {
+		freeRange(pool.freeVertices, mesh.baseVertex, mesh.numVerts);
+		freeRange(pool.freeIndices, mesh.firstIndex, mesh.indexCount);
+	}
+
+	void drawMeshPool(meshPool &pool, const poolMesh *meshes, const instanceData *drawData, const GLuint drawCount,
+		const GLenum primitive) {
+		if (drawCount == 0)
+			return;
+		GLuint buffer;
+		GLuint offset = streamData(drawData, drawCount * sizeof(instanceData), 16, buffer);
+		bindVertexArray(pool.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		if (pool.multiDraw) {
+			std::vector<drawElementsIndirectCommand> commands(drawCount);
+			for (GLuint i = 0; i < drawCount; i++) {
+				commands[i].count = meshes[i].indexCount;
+				commands[i].instanceCount = 1;
+				commands[i].firstIndex = meshes[i].firstIndex;
+				commands[i].baseVertex = (GLint) meshes[i].baseVertex;
+				commands[i].baseInstance = i;	// selects drawData[i] through the instance attributes
+			}
+			GLuint commandBuffer;
+			GLuint commandOffset = streamData(commands.data(), drawCount * sizeof(drawElementsIndirectCommand), 16, commandBuffer);
+			setInstanceAttribPointers(offset);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glMultiDrawElementsIndirect(primitive, GL_UNSIGNED_INT, (const GLvoid *) (size_t) commandOffset, drawCount, 0);
+			addDrawCalls(1);
+		}
+		else {
+			// GL 3.3 has no baseInstance, so move the instance attributes along for each draw instead
+			for (GLuint i = 0; i < drawCount; i++) {
+				setInstanceAttribPointers(offset + i * sizeof(instanceData));
+				glDrawElementsInstancedBaseVertex(primitive, meshes[i].indexCount, GL_UNSIGNED_INT,
+					(const GLvoid *) (meshes[i].firstIndex * sizeof(GLuint)), 1, (GLint) meshes[i].baseVertex);
+			}
+			addDrawCalls(drawCount);
+		}
+		for (GLuint i = 0; i < drawCount; i++)
+			addTriangles(primitive, meshes[i].indexCount, 1);
+	}
+
+}
@@ -0,0 +1,63 @@
+// rt3dMeshPool.h
+// Shared vertex and index buffers for static meshes
+//
+// A meshPool holds many meshes in one vertex buffer and one index buffer, sub-allocated with a
+// first fit free list, behind a single VAO. A whole list of pooled meshes is drawn with one
+// glMultiDrawElementsIndirect call, so there are no per mesh VAO binds at all.
+// Each draw has its own instanceData (model matrix and material index), which the shaders read
+// through the usual in_ModelMatrix/in_MaterialIndex attributes - the indirect commands use their
+// draw number as baseInstance, so the instanced shaders (e.g. ActualPhongInstanced) work unchanged.
+// The per draw data and the indirect commands are streamed through rt3d's stream buffer.
+// Without GL 4.3 or ARB_multi_draw_indirect, draws are issued one at a time from the same buffers.
+#ifndef RT3D_MESH_POOL
+#define RT3D_MESH_POOL
+
+#include "rt3d.h"
+#include <vector>
+
+namespace rt3d {
+
+	// A block of vertices or indices in a pool, in elements
+	struct poolRange {
+		GLuint start;
+		GLuint count;
+	};
+
+	// Where a mesh lives in its pool - keep it to draw or remove the mesh later
+	struct poolMesh {
+		GLuint baseVertex;
+		GLuint numVerts;
+		GLuint firstIndex;
+		GLuint indexCount;
+		bool hasBounds;				// false if the positions couldn't be read to find them
+		meshBounds bounds;
+	};
+
+	struct meshPool {
+		GLuint vao;
+		GLuint vertexBuffer;
+		GLuint indexBuffer;			// GL_UNSIGNED_INT indices, relative to baseVertex
+		vertexFormat format;
+		GLuint vertexCapacity;
+		GLuint indexCapacity;
+		std::vector<poolRange> freeVertices;	// sorted by start, adjacent ranges merged
+		std::vector<poolRange> freeIndices;
+		bool multiDraw;				// glMultiDrawElementsIndirect is available
+	};
+
+	void createMeshPool(meshPool &pool, const vertexFormat &format, const GLuint maxVerts, const GLuint maxIndices);
+	void deleteMeshPool(meshPool &pool);
+	// Vertices are converted to the pool's format - attributes the pool doesn't have are dropped,
+	// and any it has that the mesh doesn't are zeroed. Shared attributes are copied, not decoded, so
+	// they must have the same type, size and normalization (a packed mesh can't go in a float pool).
+	// Returns false if they don't, or if the pool is full
+	bool addPoolMesh(meshPool &pool, const GLuint numVerts, const void *vertexData, const vertexFormat &format,
+		const GLuint indexCount, const void *indices, const GLenum indexType, poolMesh &mesh);
+	void removePoolMesh(meshPool &pool, const poolMesh &mesh);
+	// Draws meshes[i] with drawData[i] for each of the drawCount draws
+	void drawMeshPool(meshPool &pool, const poolMesh *meshes, const instanceData *drawData, const GLuint drawCount,
+		const GLenum primitive);
+
+}
+
+#endif
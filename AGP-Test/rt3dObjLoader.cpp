@@ -1,210 +1,615 @@
-// rt3dObjLoader.cpp
-// A simple OBJ loader
-// (c) Daniel Livingstone 2013
-// Please don't share - this was hacked together quite quickly and is for demonstration use only
-//
-// Limitations:
-// Only works with triangulated OBJ models
-// Does not support groups or multiple meshes per file
-// Does not support anything other than very straightforward OBJ models
-// Will not generate normals if the model is missing them - or any other missing data
-
-#include "rt3dObjLoader.h"
-#include "rt3d.h"
-#include <iostream>
-#include <sstream>
-#include <map>
-
-#define FORMAT_UNKNOWN 0
-#define FORMAT_V 1
-#define FORMAT_VT 2
-#define FORMAT_VTN 3
-#define FORMAT_VN 4
-
-namespace rt3d {
-    
-	struct position {
-		GLfloat x;
-		GLfloat y;
-		GLfloat z;
-	};
-    
-	struct faceIndex {
-		int v;
-		int t;
-		int n;
-	};
-    
-	int determineFaceFormat(std::string fString) {
-		unsigned int delim1 = fString.find('/');
-		if (delim1 == std::string::npos)
-			return FORMAT_V;		
-		unsigned int delim2 = fString.rfind('/');
-		if (delim1 == delim2)
-			return FORMAT_VT;
-		if (delim2 == (delim1+1))
-			return FORMAT_VN;
-		return FORMAT_VTN;
-	}
-    
-	faceIndex getFace(std::string fString, int fFormat) {
-		// still need to sort out how to handle v/t properly, as well as v//n
-		int delim1 = fString.find('/');
-		int delim2 = fString.rfind('/');
-		
-		std::string vstr = fString.substr(0, delim1);
-		std::stringstream buffer;
-		if ( fFormat == FORMAT_VT ) {
-			// v/t format
-			std::string tstr = fString.substr(delim1+1, fString.size() );
-			buffer << vstr << " " << tstr << " " << 0 << " ";
-		}
-		else {
-			// v/t/n format or v//n format
-			std::string nstr = fString.substr(delim2+1, fString.size()-delim2 );
-			if ( fFormat == FORMAT_VTN ) {
-				std::string tstr = fString.substr(delim1+1, delim2-(delim1+1) );
-				buffer << vstr << " " << tstr << " " << nstr << " ";
-			}
-			else
-				buffer << vstr << " " << 0 << " " << nstr << " ";
-		}
-		
-		faceIndex f;
-		buffer >> f.v >> f.t >> f.n;
-		f.v--; f.t--, f.n--;
-		buffer.clear();
-		return f;
-	}
-    
-    
-	void addVertex(std::string fString1, std::map<std::string,GLuint> &indexMap, 
-                   std::vector<position> &inVerts, std::vector<position> &inCoords, std::vector<position> &inNorms, 
-                   std::vector<GLfloat> &verts, std::vector<GLfloat> &texcoords, std::vector<GLfloat> &norms, 
-                   std::vector<GLuint> &indices, int fFormat, int &index) {
-        
-		auto itr = indexMap.find(fString1);
-		if (itr == indexMap.end()) {
-			faceIndex f = getFace(fString1, fFormat);
-			verts.push_back(inVerts[f.v].x);
-			verts.push_back(inVerts[f.v].y);
-			verts.push_back(inVerts[f.v].z);
-			if (fFormat < FORMAT_VN) {
-				texcoords.push_back(inCoords[f.t].x);
-				texcoords.push_back(inCoords[f.t].y);
-			}
-			if (fFormat > FORMAT_VT) {
-				norms.push_back(inNorms[f.n].x);
-				norms.push_back(inNorms[f.n].y);
-				norms.push_back(inNorms[f.n].z);
-			}
-			indexMap.insert(std::pair<std::string, GLuint>(fString1, index)); 
-			indices.push_back(index++);
-		}
-		else {
-			indices.push_back( itr->second );
-		}
-	}
-    
-    
-    
-	void loadObj(const char* filename, std::vector<GLfloat> &verts, std::vector<GLfloat> &norms,
-                 std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices) {
-        
-		GLint fileLength;
-		char *fileSource = loadFile(filename, fileLength);
-        
-		if (fileLength == 0)
-			// should report error here too
-			return;
-        
-		std::stringstream  fileStream;
-		fileStream << fileSource;
-        
-		char line[256];
-		std::string lineHeader;
-		std::string fString1;
-		std::string fString2;
-		std::string fString3;
-		std::stringstream buffer;
-		std::vector<position> inVerts;
-		std::vector<position> inNorms;
-		std::vector<position> inCoords;
-		//std::vector<GLint> indexVector;
-        
-		GLfloat x,y,z;
-		GLint a,b,c;
-        
-		int i=0, iCount = 0;
-		position tmp;
-		std::map<std::string,GLuint> indexMap;
-		int fFormat = FORMAT_UNKNOWN;
-        
-		std::cout << "started parsing obj image..." << std::endl;
-        
-		while (fileStream.good()) {
-			//fileStream.getline(line, 256);
-			fileStream >> lineHeader;
-			switch (lineHeader[0]) {
-                case 'v':
-                    if ( lineHeader.length() > 1)
-                        switch (lineHeader[1]) {
-                            case 't': 
-                                fileStream >> tmp.x >> tmp.y;
-                                inCoords.push_back(tmp);
-                                break;
-                            case 'n':
-                                fileStream >> tmp.x >> tmp.y >> tmp.z;
-                                inNorms.push_back(tmp);
-                                break;
-                            default:
-                                break;
-                        }
-                    else {
-                        fileStream >> tmp.x >> tmp.y >> tmp.z;
-                        inVerts.push_back(tmp);
-                    }
-                    break;
-                case 'f':
-                    fileStream >> fString1 >> fString2 >> fString3;
-                    if (!fFormat)
-                        fFormat = determineFaceFormat(fString1);
-                    if (fFormat > FORMAT_V) {
-                        addVertex(fString1, indexMap, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
-                        addVertex(fString2, indexMap, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
-                        addVertex(fString3, indexMap, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
-                    }
-                    else {
-                        buffer << fString1 << " " << fString2 << " " << fString3;
-                        buffer >> a >> b >> c;
-                        buffer.clear();
-                        indices.push_back(a-1);
-                        indices.push_back(b-1);
-                        indices.push_back(c-1);
-                    }
-                    break;
-                case '#': 
-                    fileStream.getline(line, 256); // ignore line
-                    break;
-                default:
-                    fileStream.getline(line, 256); // ignore line
-			}
-            
-		}
-        
-		// copy vertex data to output vectors in case only single index was provided....
-		if (fFormat == FORMAT_V) {
-			for (int v = 0; v < inVerts.size(); v++) {
-				verts.push_back(inVerts[v].x);
-				verts.push_back(inVerts[v].y);
-				verts.push_back(inVerts[v].z);			
-			}
-		}
-        
-		std::cout << "finished parsing obj image..." << std::endl;
-        
-        
-	}
-    
-    
-}
+// rt3dObjLoader.cpp
+// A simple OBJ loader
+// (c) Daniel Livingstone 2013
+// Please don't share - this was hacked together quite quickly and is for demonstration use only
+//
+// Limitations:
+// Only works with triangulated OBJ models
+// Does not support groups or multiple meshes per file
+// Does not support anything other than very straightforward OBJ models
+// Will not generate normals if the model is missing them - or any other missing data
+//
+// The file is memory mapped and parsed in a single pass directly from the mapped buffer,
+// using the small hand written scanner below rather than stringstreams - so there are no
+// copies of the file and no per-token allocations. Face corners are deduplicated on their
+// parsed integer indices through a small open addressing hash table.
+// Large files can optionally be split into chunks and parsed on the job system
+
+#include "rt3dObjLoader.h"
+#include "rt3d.h"
+#include "rt3dJobs.h"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#define FORMAT_UNKNOWN 0
+#define FORMAT_V 1
+#define FORMAT_VT 2
+#define FORMAT_VTN 3
+#define FORMAT_VN 4
+
+namespace rt3d {
+
+	struct position {
+		GLfloat x;
+		GLfloat y;
+		GLfloat z;
+	};
+
+	struct faceIndex {
+		int v;
+		int t;
+		int n;
+	};
+
+	// exact powers of ten for the float scanner - anything beyond 1e22 falls back to pow
+	static const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	static inline bool isBlank(const char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static inline bool isDigit(const char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	// skip spaces and tabs, but never move past the end of the current line
+	static inline void skipBlanks(const char *&p, const char *end) {
+		while (p < end && isBlank(*p))
+			p++;
+	}
+
+	// move to the first character of the next line
+	static inline void skipLine(const char *&p, const char *end) {
+		while (p < end && *p != '\n')
+			p++;
+		if (p < end)
+			p++;
+	}
+
+	static int parseInt(const char *&p, const char *end) {
+		skipBlanks(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = (*p++ == '-');
+		int value = 0;
+		while (p < end && isDigit(*p))
+			value = value * 10 + (*p++ - '0');
+		return negative ? -value : value;
+	}
+
+	static GLfloat parseFloat(const char *&p, const char *end) {
+		skipBlanks(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = (*p++ == '-');
+
+		// gather up to 19 significant digits into an integer mantissa, and track
+		// the decimal exponent separately - only one rounding step at the very end
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		while (p < end && isDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digits++;
+			}
+			else
+				exponent++;
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && isDigit(*p)) {
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa) digits++;
+					exponent--;
+				}
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				negativeExp = (*p++ == '-');
+			int e = 0;
+			while (p < end && isDigit(*p))
+				e = e * 10 + (*p++ - '0');
+			exponent += negativeExp ? -e : e;
+		}
+
+		double value = (double) mantissa;
+		if (exponent < 0)
+			value /= (exponent >= -22) ? powersOfTen[-exponent] : std::pow(10.0, -exponent);
+		else if (exponent > 0)
+			value *= (exponent <= 22) ? powersOfTen[exponent] : std::pow(10.0, exponent);
+		return (GLfloat) (negative ? -value : value);
+	}
+
+	// find the end of the current whitespace delimited token
+	static inline const char* tokenEnd(const char *p, const char *end) {
+		while (p < end && !isBlank(*p) && *p != '\n')
+			p++;
+		return p;
+	}
+
+	int determineFaceFormat(const char *fString, const char *fEnd) {
+		const char *delim1 = nullptr;
+		const char *delim2 = nullptr;
+		for (const char *c = fString; c < fEnd; c++)
+			if (*c == '/') {
+				if (!delim1) delim1 = c;
+				delim2 = c;
+			}
+		if (!delim1)
+			return FORMAT_V;
+		if (delim1 == delim2)
+			return FORMAT_VT;
+		if (delim2 == (delim1+1))
+			return FORMAT_VN;
+		return FORMAT_VTN;
+	}
+
+	// parse a face corner in v, v/t, v//n or v/t/n form
+	// missing indices are returned as -1, as are all indices after converting to zero base
+	faceIndex getFace(const char *&p, const char *end) {
+		faceIndex f = { 0, 0, 0 };
+		f.v = parseInt(p, end);
+		if (p < end && *p == '/') {
+			p++;
+			if (p < end && *p != '/')
+				f.t = parseInt(p, end);
+			if (p < end && *p == '/') {
+				p++;
+				f.n = parseInt(p, end);
+			}
+		}
+		f.v--; f.t--, f.n--;
+		return f;
+	}
+
+
+	// Open addressing hash table mapping a parsed (v,t,n) face corner to its output index
+	// Replaces a std::map keyed on the face text - keys are three ints, so there is nothing
+	// to allocate per corner, and lookups are a hash plus a short linear probe
+	struct vertexIndexTable {
+		struct slot {
+			faceIndex key;
+			GLuint index;
+		};
+		static const GLuint EMPTY = 0xFFFFFFFF;
+		std::vector<slot> slots;
+		size_t mask = 0;
+		size_t count = 0;
+
+		// capacity is rounded up to a power of two, with room for expectedCount keys
+		// at a load factor of at most one half
+		void reset(size_t expectedCount) {
+			size_t capacity = 16;
+			while (capacity < expectedCount * 2)
+				capacity <<= 1;
+			slot emptySlot = { { 0, 0, 0 }, EMPTY };
+			slots.assign(capacity, emptySlot);
+			mask = capacity - 1;
+			count = 0;
+		}
+
+		static size_t hash(const faceIndex &f) {
+			unsigned long long h = (unsigned int) f.v * 0x9E3779B97F4A7C15ull;
+			h ^= (unsigned int) f.t * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+			h ^= (unsigned int) f.n * 0x165667B19E3779F9ull + (h >> 32);
+			return (size_t) (h ^ (h >> 31));
+		}
+
+		// returns the existing index for f, or stores newIndex and returns EMPTY
+		GLuint findOrInsert(const faceIndex &f, GLuint newIndex) {
+			if ((count + 1) * 2 > slots.size())
+				grow();
+			size_t i = hash(f) & mask;
+			while (slots[i].index != EMPTY) {
+				if (slots[i].key.v == f.v && slots[i].key.t == f.t && slots[i].key.n == f.n)
+					return slots[i].index;
+				i = (i + 1) & mask;
+			}
+			slots[i].key = f;
+			slots[i].index = newIndex;
+			count++;
+			return EMPTY;
+		}
+
+		void grow() {
+			std::vector<slot> old;
+			old.swap(slots);
+			reset(old.size());
+			for (size_t j = 0; j < old.size(); j++)
+				if (old[j].index != EMPTY)
+					findOrInsert(old[j].key, old[j].index);
+		}
+
+		size_t memoryUsed() const { return slots.size() * sizeof(slot); }
+	};
+
+
+	void addVertex(const char *&p, const char *end, vertexIndexTable &indexTable,
+                   std::vector<position> &inVerts, std::vector<position> &inCoords, std::vector<position> &inNorms,
+                   std::vector<GLfloat> &verts, std::vector<GLfloat> &texcoords, std::vector<GLfloat> &norms,
+                   std::vector<GLuint> &indices, int fFormat, int &index) {
+
+		faceIndex f = getFace(p, end);
+		GLuint existing = indexTable.findOrInsert(f, index);
+		if (existing == vertexIndexTable::EMPTY) {
+			verts.push_back(inVerts[f.v].x);
+			verts.push_back(inVerts[f.v].y);
+			verts.push_back(inVerts[f.v].z);
+			if (fFormat < FORMAT_VN) {
+				texcoords.push_back(inCoords[f.t].x);
+				texcoords.push_back(inCoords[f.t].y);
+			}
+			if (fFormat > FORMAT_VT) {
+				norms.push_back(inNorms[f.n].x);
+				norms.push_back(inNorms[f.n].y);
+				norms.push_back(inNorms[f.n].z);
+			}
+			indices.push_back(index++);
+		}
+		else {
+			indices.push_back( existing );
+		}
+	}
+
+
+
+	// Serial parse of the whole file - indices are assigned in order of first use of each corner
+	static void parseObj(const char *fileSource, const size_t fileLength, std::vector<GLfloat> &verts, std::vector<GLfloat> &norms,
+                 std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices) {
+
+		std::vector<position> inVerts;
+		std::vector<position> inNorms;
+		std::vector<position> inCoords;
+
+		int iCount = 0;
+		position tmp;
+		vertexIndexTable indexTable;
+		int fFormat = FORMAT_UNKNOWN;
+
+		const char *p = fileSource;
+		const char *end = fileSource + fileLength;
+		while (p < end) {
+			skipBlanks(p, end);
+			if (p == end)
+				break;
+			switch (*p) {
+				case 'v':
+					p++;
+					if (p < end && *p == 't') {
+						p++;
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						inCoords.push_back(tmp);
+					}
+					else if (p < end && *p == 'n') {
+						p++;
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						tmp.z = parseFloat(p, end);
+						inNorms.push_back(tmp);
+					}
+					else if (p < end && isBlank(*p)) {
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						tmp.z = parseFloat(p, end);
+						inVerts.push_back(tmp);
+					}
+					break;
+				case 'f':
+					p++;
+					if (!fFormat) {
+						skipBlanks(p, end);
+						fFormat = determineFaceFormat(p, tokenEnd(p, end));
+						// faces normally follow all of the vertex data, and most meshes end up
+						// with about one unique corner per position, so size the table from that
+						if (fFormat > FORMAT_V)
+							indexTable.reset(inVerts.size() > inCoords.size() ? inVerts.size() : inCoords.size());
+					}
+					if (fFormat > FORMAT_V) {
+						addVertex(p, end, indexTable, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
+						addVertex(p, end, indexTable, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
+						addVertex(p, end, indexTable, inVerts, inCoords, inNorms, verts, texcoords, norms, indices, fFormat, iCount);
+					}
+					else {
+						indices.push_back(parseInt(p, end)-1);
+						indices.push_back(parseInt(p, end)-1);
+						indices.push_back(parseInt(p, end)-1);
+					}
+					break;
+				default:
+					break; // comments and anything else we don't support are ignored
+			}
+			skipLine(p, end);
+		}
+
+		// copy vertex data to output vectors in case only single index was provided....
+		if (fFormat == FORMAT_V) {
+			for (int v = 0; v < inVerts.size(); v++) {
+				verts.push_back(inVerts[v].x);
+				verts.push_back(inVerts[v].y);
+				verts.push_back(inVerts[v].z);
+			}
+		}
+
+		if (fFormat > FORMAT_V)
+			std::cout << "vertex dedup: " << indexTable.count << " unique of " << indices.size() << " corners, table "
+				<< indexTable.slots.size() << " slots (" << indexTable.memoryUsed() / 1024 << " KB)" << std::endl;
+	}
+
+
+	// Everything read from one line aligned chunk of the file by the parallel loader.
+	// Face corners are kept raw here and only resolved once all chunks are parsed,
+	// as a face may refer to vertex data from any other chunk
+	struct objChunk {
+		const char *begin;
+		const char *end;
+		int fFormat;
+		std::vector<position> inVerts;
+		std::vector<position> inNorms;
+		std::vector<position> inCoords;
+		std::vector<faceIndex> corners;
+		// filled in by the local dedup step
+		std::vector<faceIndex> unique;		// distinct corners, in order of first use in this chunk
+		std::vector<GLuint> localIndices;	// per corner, index into unique
+		std::vector<GLuint> remap;			// per unique corner, its final output index
+	};
+
+	static void parseChunk(objChunk &chunk) {
+		position tmp;
+		chunk.fFormat = FORMAT_UNKNOWN;
+		const char *p = chunk.begin;
+		const char *end = chunk.end;
+		while (p < end) {
+			skipBlanks(p, end);
+			if (p == end)
+				break;
+			switch (*p) {
+				case 'v':
+					p++;
+					if (p < end && *p == 't') {
+						p++;
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						chunk.inCoords.push_back(tmp);
+					}
+					else if (p < end && *p == 'n') {
+						p++;
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						tmp.z = parseFloat(p, end);
+						chunk.inNorms.push_back(tmp);
+					}
+					else if (p < end && isBlank(*p)) {
+						tmp.x = parseFloat(p, end);
+						tmp.y = parseFloat(p, end);
+						tmp.z = parseFloat(p, end);
+						chunk.inVerts.push_back(tmp);
+					}
+					break;
+				case 'f':
+					p++;
+					if (!chunk.fFormat) {
+						skipBlanks(p, end);
+						chunk.fFormat = determineFaceFormat(p, tokenEnd(p, end));
+					}
+					chunk.corners.push_back(getFace(p, end));
+					chunk.corners.push_back(getFace(p, end));
+					chunk.corners.push_back(getFace(p, end));
+					break;
+				default:
+					break;
+			}
+			skipLine(p, end);
+		}
+	}
+
+	// number the distinct corners of a chunk in order of first use - doing this per chunk
+	// means the serial merge below only has to visit each chunk's unique corners
+	static void dedupChunk(objChunk &chunk) {
+		vertexIndexTable localTable;
+		localTable.reset(chunk.corners.size() / 4);
+		chunk.localIndices.resize(chunk.corners.size());
+		for (size_t i = 0; i < chunk.corners.size(); i++) {
+			GLuint existing = localTable.findOrInsert(chunk.corners[i], (GLuint) chunk.unique.size());
+			if (existing == vertexIndexTable::EMPTY) {
+				chunk.localIndices[i] = (GLuint) chunk.unique.size();
+				chunk.unique.push_back(chunk.corners[i]);
+			}
+			else
+				chunk.localIndices[i] = existing;
+		}
+	}
+
+	// run fn(0) .. fn(count-1) on the job system, a job each, and wait for them all
+	template <typename Fn>
+	static void forEachChunk(const size_t count, Fn fn) {
+		jobGroup group;
+		parallelFor(group, [](void *data, const GLuint begin, const GLuint end) {
+			for (GLuint i = begin; i < end; i++)
+				(*(Fn *) data)(i);
+		}, &fn, (GLuint) count, 1);
+		waitJobGroup(group);
+	}
+
+	// append each chunk's records to one array, at offsets given by a prefix sum over chunk sizes
+	static void gatherChunks(std::vector<objChunk> &chunks, std::vector<position> objChunk::*member,
+		std::vector<position> &out) {
+		std::vector<size_t> offsets(chunks.size() + 1, 0);
+		for (size_t c = 0; c < chunks.size(); c++)
+			offsets[c+1] = offsets[c] + (chunks[c].*member).size();
+		out.resize(offsets.back());
+		forEachChunk(chunks.size(), [&](size_t c) {
+			std::copy((chunks[c].*member).begin(), (chunks[c].*member).end(), out.begin() + offsets[c]);
+			std::vector<position>().swap(chunks[c].*member);
+		});
+	}
+
+	// Parallel parse - splits the file at line boundaries and parses the chunks concurrently,
+	// then merges so that the output is exactly the same as the serial parse
+	static void parseObjParallel(const char *fileSource, const size_t fileLength, const unsigned int numChunks,
+		std::vector<GLfloat> &verts, std::vector<GLfloat> &norms, std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices) {
+
+		const char *end = fileSource + fileLength;
+		std::vector<objChunk> chunks(numChunks);
+		const char *p = fileSource;
+		for (unsigned int c = 0; c < numChunks; c++) {
+			chunks[c].begin = p;
+			p = (c == numChunks - 1) ? end : fileSource + fileLength / numChunks * (c + 1);
+			if (p < chunks[c].begin)
+				p = chunks[c].begin;
+			skipLine(p, end); // chunks always end just after a newline
+			if (c == numChunks - 1)
+				p = end;
+			chunks[c].end = p;
+		}
+
+		forEachChunk(chunks.size(), [&](size_t c) { parseChunk(chunks[c]); });
+
+		// the face format is taken from the first face in the file, as in the serial parse
+		int fFormat = FORMAT_UNKNOWN;
+		for (size_t c = 0; c < chunks.size() && !fFormat; c++)
+			fFormat = chunks[c].fFormat;
+
+		std::vector<position> inVerts;
+		std::vector<position> inNorms;
+		std::vector<position> inCoords;
+		gatherChunks(chunks, &objChunk::inVerts, inVerts);
+		gatherChunks(chunks, &objChunk::inNorms, inNorms);
+		gatherChunks(chunks, &objChunk::inCoords, inCoords);
+
+		std::vector<size_t> cornerOffsets(chunks.size() + 1, 0);
+		for (size_t c = 0; c < chunks.size(); c++)
+			cornerOffsets[c+1] = cornerOffsets[c] + chunks[c].corners.size();
+		indices.resize(cornerOffsets.back());
+
+		// no faces - the serial parse gives no output at all
+		if (fFormat == FORMAT_UNKNOWN) {
+			indices.clear();
+			return;
+		}
+
+		if (fFormat == FORMAT_V) {
+			forEachChunk(chunks.size(), [&](size_t c) {
+				for (size_t i = 0; i < chunks[c].corners.size(); i++)
+					indices[cornerOffsets[c] + i] = chunks[c].corners[i].v;
+			});
+			verts.resize(inVerts.size() * 3);
+			for (size_t v = 0; v < inVerts.size(); v++) {
+				verts[v*3] = inVerts[v].x;
+				verts[v*3+1] = inVerts[v].y;
+				verts[v*3+2] = inVerts[v].z;
+			}
+			return;
+		}
+
+		forEachChunk(chunks.size(), [&](size_t c) { dedupChunk(chunks[c]); });
+
+		// merge in file order: a corner takes the next output index the first time it is seen
+		// in any chunk, which is exactly the numbering the serial parse produces
+		vertexIndexTable indexTable;
+		indexTable.reset(inVerts.size() > inCoords.size() ? inVerts.size() : inCoords.size());
+		std::vector<faceIndex> unique;
+		for (size_t c = 0; c < chunks.size(); c++) {
+			chunks[c].remap.resize(chunks[c].unique.size());
+			for (size_t u = 0; u < chunks[c].unique.size(); u++) {
+				GLuint existing = indexTable.findOrInsert(chunks[c].unique[u], (GLuint) unique.size());
+				if (existing == vertexIndexTable::EMPTY) {
+					chunks[c].remap[u] = (GLuint) unique.size();
+					unique.push_back(chunks[c].unique[u]);
+				}
+				else
+					chunks[c].remap[u] = existing;
+			}
+		}
+
+		forEachChunk(chunks.size(), [&](size_t c) {
+			for (size_t i = 0; i < chunks[c].localIndices.size(); i++)
+				indices[cornerOffsets[c] + i] = chunks[c].remap[chunks[c].localIndices[i]];
+		});
+
+		// finally expand the unique corners into the output arrays, in even slices per chunk
+		verts.resize(unique.size() * 3);
+		if (fFormat < FORMAT_VN)
+			texcoords.resize(unique.size() * 2);
+		if (fFormat > FORMAT_VT)
+			norms.resize(unique.size() * 3);
+		forEachChunk(chunks.size(), [&](size_t c) {
+			size_t first = unique.size() * c / chunks.size();
+			size_t last = unique.size() * (c + 1) / chunks.size();
+			for (size_t i = first; i < last; i++) {
+				const faceIndex &f = unique[i];
+				verts[i*3] = inVerts[f.v].x;
+				verts[i*3+1] = inVerts[f.v].y;
+				verts[i*3+2] = inVerts[f.v].z;
+				if (fFormat < FORMAT_VN) {
+					texcoords[i*2] = inCoords[f.t].x;
+					texcoords[i*2+1] = inCoords[f.t].y;
+				}
+				if (fFormat > FORMAT_VT) {
+					norms[i*3] = inNorms[f.n].x;
+					norms[i*3+1] = inNorms[f.n].y;
+					norms[i*3+2] = inNorms[f.n].z;
+				}
+			}
+		});
+
+		std::cout << "vertex dedup: " << unique.size() << " unique of " << indices.size() << " corners over "
+			<< numChunks << " chunks, table " << indexTable.slots.size() << " slots (" << indexTable.memoryUsed() / 1024 << " KB)" << std::endl;
+	}
+
+
+	void loadObj(const char* filename, std::vector<GLfloat> &verts, std::vector<GLfloat> &norms,
+                 std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices) {
+		loadObj(filename, verts, norms, texcoords, indices, 1);
+	}
+
+
+	void loadObj(const char* filename, std::vector<GLfloat> &verts, std::vector<GLfloat> &norms,
+                 std::vector<GLfloat> &texcoords, std::vector<GLuint> &indices, unsigned int numThreads) {
+
+		size_t fileLength;
+		const char *fileSource = mapFile(filename, fileLength);
+
+		if (fileSource == nullptr)
+			// should report error here too
+			return;
+
+		if (numThreads == 0)
+			numThreads = getJobThreads();
+		// don't bother splitting small files - merging the chunks would cost more than it saves
+		const size_t minChunkSize = 1024 * 1024;
+		if (numThreads > fileLength / minChunkSize)
+			numThreads = (unsigned int) (fileLength / minChunkSize);
+		if (numThreads < 1)
+			numThreads = 1;
+
+		std::cout << "started parsing obj image..." << std::endl;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		if (numThreads > 1)
+			parseObjParallel(fileSource, fileLength, numThreads, verts, norms, texcoords, indices);
+		else
+			parseObj(fileSource, fileLength, verts, norms, texcoords, indices);
+
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		unmapFile(fileSource, fileLength);
+
+		std::cout << "finished parsing obj image... (" << fileLength / (1024.0 * 1024.0) << " MB in "
+			<< seconds * 1000.0 << " ms, " << fileLength / (1024.0 * 1024.0) / seconds << " MB/s, "
+			<< numThreads << (numThreads > 1 ? " chunks)" : " chunk)") << std::endl;
+	}
+
+
+}
@@ -0,0 +1,267 @@
+// rt3dProfiler.cpp
+// Frame profiler - see rt3dProfiler.h
+
+#include "rt3dProfiler.h"
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace rt3d {
+
+	// trace tracks for the GPU timers and the frames - CPU threads are numbered from 0
+	#define RT3D_PROFILE_GPU_THREAD		0xFFFF
+	#define RT3D_PROFILE_FRAME_THREAD	0x10000
+
+	struct profileEvent {
+		const char *name;
+		Uint64 start;		// performance counter ticks - GPU timers start when they were issued
+		Uint64 duration;
+		GLuint frame;
+		GLuint thread;
+	};
+
+	struct frameRecord {
+		frameProfile profile;
+		Uint64 start;
+	};
+
+	struct gpuQuery {
+		const char *name;
+		GLuint query;
+		Uint64 issued;
+	};
+
+	// the queries issued in one frame, reused RT3D_PROFILE_GPU_FRAMES frames later
+	struct gpuFrame {
+		GLuint frame;
+		GLuint used;
+		std::vector<gpuQuery> queries;
+	};
+
+	static std::mutex eventLock;		// scopes can end on any thread
+	static std::deque<profileEvent> events;
+	static std::deque<frameRecord> frames;
+	static gpuFrame gpuFrames[RT3D_PROFILE_GPU_FRAMES];
+	static bool gpuTimerActive = false;
+	static GLuint currentFrame = 0;
+	static Uint64 frameStart = 0;
+	static frameProfile completeFrame;
+	static std::atomic<GLuint> threadCount(0);
+	static thread_local GLuint profileThread = 0xFFFFFFFF;
+
+	static double ticksToMs(const Uint64 ticks) {
+		return ticks * 1000.0 / SDL_GetPerformanceFrequency();
+	}
+
+	static GLuint getProfileThread() {
+		if (profileThread == 0xFFFFFFFF)
+			profileThread = threadCount++;
+		return profileThread;
+	}
+
+	profileScope::profileScope(const char *name) : name(name), start(SDL_GetPerformanceCounter()) {
+	}
+
+	profileScope::~profileScope() {
+		Uint64 end = SDL_GetPerformanceCounter();
+		GLuint thread = getProfileThread();
+		std::lock_guard<std::mutex> guard(eventLock);
+		profileEvent e = { name, start, end - start, currentFrame, thread };
+		events.push_back(e);
+	}
+
+	gpuProfileScope::gpuProfileScope(const char *name) {
+		beginGpuTimer(name);
+	}
+
+	gpuProfileScope::~gpuProfileScope() {
+		endGpuTimer();
+	}
+
+	void beginGpuTimer(const char *name) {
+		if (gpuTimerActive)
+			endGpuTimer();
+		gpuFrame &slot = gpuFrames[currentFrame % RT3D_PROFILE_GPU_FRAMES];
+		if (slot.used == slot.queries.size()) {
+			gpuQuery query = { nullptr, 0, 0 };
+			glGenQueries(1, &query.query);
+			slot.queries.push_back(query);
+		}
+		gpuQuery &query = slot.queries[slot.used++];
+		query.name = name;
+		query.issued = SDL_GetPerformanceCounter();
+		glBeginQuery(GL_TIME_ELAPSED, query.query);
+		gpuTimerActive = true;
+	}
+
+	void endGpuTimer() {
+		if (!gpuTimerActive)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuTimerActive = false;
+	}
+
+	// results the GPU hasn't finished yet are dropped rather than waited for
+	static void readGpuFrame(gpuFrame &slot) {
+		if (slot.used == 0)
+			return;
+		GLint available = 0;
+		glGetQueryObjectiv(slot.queries[slot.used - 1].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return;
+		double gpuMs = 0.0;
+		for (GLuint i = 0; i < slot.used; i++) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(slot.queries[i].query, GL_QUERY_RESULT, &ns);
+			gpuMs += ns / 1000000.0;
+			profileEvent e = { slot.queries[i].name, slot.queries[i].issued,
+				(Uint64) (ns / 1e9 * SDL_GetPerformanceFrequency()), slot.frame, RT3D_PROFILE_GPU_THREAD };
+			events.push_back(e);
+		}
+		for (size_t i = frames.size(); i-- > 0;) {
+			if (frames[i].profile.frame == slot.frame) {
+				frames[i].profile.gpuMs = gpuMs;
+				completeFrame = frames[i].profile;
+				break;
+			}
+		}
+	}
+
+	void endProfileFrame() {
+		endGpuTimer();
+		Uint64 now = SDL_GetPerformanceCounter();
+		if (frameStart == 0)
+			frameStart = now;
+		const renderStats &stats = getRenderStats();
+		std::lock_guard<std::mutex> guard(eventLock);
+
+		frameRecord record;
+		record.start = frameStart;
+		record.profile.frame = currentFrame;
+		record.profile.cpuMs = ticksToMs(now - frameStart);
+		record.profile.gpuMs = 0.0;
+		record.profile.drawCalls = stats.drawCalls;
+		record.profile.stateChanges = stats.stateChanges;
+		record.profile.uploadedBytes = stats.streamedBytes;
+		record.profile.uniformUploads = stats.uniformUploads + stats.uniformBlockUploads;
+		frames.push_back(record);
+		frameStart = now;
+
+		// the slot the next frame uses last held the queries from RT3D_PROFILE_GPU_FRAMES frames ago
+		currentFrame++;
+		gpuFrame &slot = gpuFrames[currentFrame % RT3D_PROFILE_GPU_FRAMES];
+		readGpuFrame(slot);
+		slot.frame = currentFrame;
+		slot.used = 0;
+
+		while (frames.size() > RT3D_PROFILE_FRAMES)
+			frames.pop_front();
+		while (!events.empty() && events.front().frame + RT3D_PROFILE_FRAMES <= currentFrame)
+			events.pop_front();
+	}
+
+	const frameProfile& getFrameProfile() {
+		return completeFrame;
+	}
+
+	struct scopeSummary {
+		double totalMs;
+		double maxFrameMs;
+		GLuint calls;
+		std::map<GLuint, double> frameMs;
+	};
+
+	void printProfileSummary(std::ostream &out) {
+		std::lock_guard<std::mutex> guard(eventLock);
+		if (frames.empty())
+			return;
+		double totalMs = 0.0, maxMs = 0.0, gpuMs = 0.0;
+		GLuint maxFrame = 0;
+		double drawCalls = 0.0, stateChanges = 0.0, uploadedBytes = 0.0, uniformUploads = 0.0;
+		for (size_t i = 0; i < frames.size(); i++) {
+			const frameProfile &f = frames[i].profile;
+			totalMs += f.cpuMs;
+			gpuMs += f.gpuMs;
+			if (f.cpuMs > maxMs) {
+				maxMs = f.cpuMs;
+				maxFrame = f.frame;
+			}
+			drawCalls += f.drawCalls;
+			stateChanges += f.stateChanges;
+			uploadedBytes += f.uploadedBytes;
+			uniformUploads += f.uniformUploads;
+		}
+		double n = (double) frames.size();
+		char line[256];
+		snprintf(line, sizeof(line), "profile of the last %u frames: %.2f ms per frame, worst %.2f ms (frame %u), GPU %.2f ms",
+			(GLuint) frames.size(), totalMs / n, maxMs, maxFrame, gpuMs / n);
+		out << line << std::endl;
+		snprintf(line, sizeof(line), "  per frame: %.0f draw calls, %.0f state changes, %.0f bytes uploaded, %.0f uniform uploads",
+			drawCalls / n, stateChanges / n, uploadedBytes / n, uniformUploads / n);
+		out << line << std::endl;
+
+		// GPU timers are listed after the CPU scopes
+		std::map<std::pair<bool, std::string>, scopeSummary> scopes;
+		for (size_t i = 0; i < events.size(); i++) {
+			const profileEvent &e = events[i];
+			scopeSummary &s = scopes[std::make_pair(e.thread == RT3D_PROFILE_GPU_THREAD, std::string(e.name))];
+			s.frameMs[e.frame] += ticksToMs(e.duration);
+			s.calls++;
+		}
+		for (auto i = scopes.begin(); i != scopes.end(); ++i) {
+			scopeSummary &s = i->second;
+			s.totalMs = s.maxFrameMs = 0.0;
+			for (auto f = s.frameMs.begin(); f != s.frameMs.end(); ++f) {
+				s.totalMs += f->second;
+				if (f->second > s.maxFrameMs)
+					s.maxFrameMs = f->second;
+			}
+			snprintf(line, sizeof(line), "  %s %-24s %8.3f ms per frame, worst %8.3f ms, %6.1f calls per frame",
+				i->first.first ? "gpu" : "cpu", i->first.second.c_str(), s.totalMs / n, s.maxFrameMs, s.calls / n);
+			out << line << std::endl;
+		}
+	}
+
+	static void writeEscaped(FILE *file, const char *text) {
+		for (; *text; text++) {
+			if (*text == '"' || *text == '\\')
+				fputc('\\', file);
+			fputc(*text, file);
+		}
+	}
+
+	bool writeProfileTrace(const char *filename) {
+		FILE *file = fopen(filename, "w");
+		if (!file)
+			return false;
+		std::lock_guard<std::mutex> guard(eventLock);
+		Uint64 origin = frames.empty() ? 0 : frames.front().start;
+		double usPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", RT3D_PROFILE_GPU_THREAD);
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"frames\"}}", RT3D_PROFILE_FRAME_THREAD);
+		for (size_t i = 0; i < frames.size(); i++) {
+			const frameProfile &f = frames[i].profile;
+			double ts = (frames[i].start - origin) * usPerTick;
+			fprintf(file, ",\n{\"name\":\"frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				f.frame, ts, f.cpuMs * 1000.0, RT3D_PROFILE_FRAME_THREAD);
+			fprintf(file, ",\n{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"draw calls\":%u,"
+				"\"state changes\":%u,\"bytes uploaded\":%u,\"uniform uploads\":%u}}",
+				ts, f.drawCalls, f.stateChanges, f.uploadedBytes, f.uniformUploads);
+		}
+		for (size_t i = 0; i < events.size(); i++) {
+			const profileEvent &e = events[i];
+			if (e.start < origin)
+				continue;	// began before the oldest frame kept
+			fprintf(file, ",\n{\"name\":\"");
+			writeEscaped(file, e.name);
+			fprintf(file, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				e.thread == RT3D_PROFILE_GPU_THREAD ? "gpu" : "cpu", (e.start - origin) * usPerTick, e.duration * usPerTick, e.thread);
+		}
+		fprintf(file, "\n]}\n");
+		return fclose(file) == 0;
+	}
+
+}
@@ -0,0 +1,66 @@
+// rt3dProfiler.h
+// Frame profiler - CPU scopes, GPU pass timers and per frame counters
+//
+// RT3D_PROFILE("name") times the rest of the enclosing block on the CPU, from any thread.
+// RT3D_PROFILE_GPU("name") does the same on the GPU with a GL_TIME_ELAPSED query. GL allows only
+// one such query at a time, so GPU timers must not nest - use them around whole passes.
+// Query results are read RT3D_PROFILE_GPU_FRAMES frames later, once the GPU has finished with
+// them, so timing never stalls the pipeline.
+// Call endProfileFrame once a frame (before resetRenderStats) - it closes the frame, adds the
+// render counters to it, and keeps the last RT3D_PROFILE_FRAMES frames for the rolling summary
+// and the trace. writeProfileTrace saves those frames in Chrome's trace event JSON format, for
+// chrome://tracing or ui.perfetto.dev.
+#ifndef RT3D_PROFILER
+#define RT3D_PROFILER
+
+#include "rt3d.h"
+#include <ostream>
+
+#define RT3D_PROFILE_FRAMES		300
+#define RT3D_PROFILE_GPU_FRAMES	4
+
+#define RT3D_PROFILE_JOIN2(a, b) a##b
+#define RT3D_PROFILE_JOIN(a, b) RT3D_PROFILE_JOIN2(a, b)
+#define RT3D_PROFILE(name) rt3d::profileScope RT3D_PROFILE_JOIN(profileScope, __LINE__)(name)
+#define RT3D_PROFILE_GPU(name) rt3d::gpuProfileScope RT3D_PROFILE_JOIN(gpuProfileScope, __LINE__)(name)
+
+namespace rt3d {
+
+	// Names must outlive the profiler - string literals are best
+	class profileScope {
+	public:
+		profileScope(const char *name);
+		~profileScope();
+	private:
+		const char *name;
+		Uint64 start;
+	};
+
+	class gpuProfileScope {
+	public:
+		gpuProfileScope(const char *name);
+		~gpuProfileScope();
+	};
+
+	struct frameProfile {
+		GLuint frame;
+		double cpuMs;			// start of one endProfileFrame to the next
+		double gpuMs;			// sum of the GPU timers, once their results are back
+		GLuint drawCalls;
+		GLuint stateChanges;
+		GLuint uploadedBytes;	// through the stream buffer
+		GLuint uniformUploads;
+	};
+
+	void beginGpuTimer(const char *name);
+	void endGpuTimer();
+	void endProfileFrame();
+	// the most recent frame whose GPU timers have all been read back
+	const frameProfile& getFrameProfile();
+	// averages and worst cases over the frames kept, for each scope and GPU timer
+	void printProfileSummary(std::ostream &out);
+	bool writeProfileTrace(const char *filename);
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+// rt3dRenderQueue.cpp
+// Sorted render queue - see rt3dRenderQueue.h
+
+#include "rt3dRenderQueue.h"
+#include "rt3dProfiler.h"
+#include "rt3dCulling.h"
+#include <algorithm>
+
+namespace rt3d {
+
+	// Key layout, most significant first:
+	// pass 4 bits | program 12 bits | texture 12 bits | mesh 12 bits | depth 24 bits
+	// except in back to front passes, where blending needs the whole pass in depth order:
+	// pass 4 bits | inverted depth 24 bits | program 12 bits | texture 12 bits | mesh 12 bits
+	// GL names above 4095 share bits with others - that only makes the grouping less perfect
+	#define RT3D_KEY_BITS(value, bits, shift) (((GLuint64) (value) & ((1ull << (bits)) - 1)) << (shift))
+	#define RT3D_QUEUE_MAX_DEPTH 1024.0f
+
+	struct passState {
+		GLenum cullFace;
+		GLboolean depthMask;
+		bool backToFront;
+	};
+
+	static const passState passes[RT3D_PASSES] = {
+		{ GL_FRONT, GL_FALSE, false },	// RT3D_PASS_SKY
+		{ GL_BACK, GL_TRUE, false },	// RT3D_PASS_OPAQUE
+		{ GL_BACK, GL_FALSE, true }		// RT3D_PASS_TRANSPARENT
+	};
+
+	static GLuint64 makeSortKey(const drawItem &item) {
+		// distance along the view direction to the object's origin, quantized to 24 bits
+		GLfloat depth = std::min(std::max(-item.modelview[14], 0.0f), RT3D_QUEUE_MAX_DEPTH);
+		GLuint quantized = (GLuint) (depth / RT3D_QUEUE_MAX_DEPTH * 0xFFFFFF);
+		if (item.pass < RT3D_PASSES && passes[item.pass].backToFront)
+			return RT3D_KEY_BITS(item.pass, 4, 60) | RT3D_KEY_BITS(0xFFFFFF - quantized, 24, 36)
+				| RT3D_KEY_BITS(item.program, 12, 24) | RT3D_KEY_BITS(item.texture, 12, 12) | RT3D_KEY_BITS(item.mesh, 12, 0);
+		return RT3D_KEY_BITS(item.pass, 4, 60) | RT3D_KEY_BITS(item.program, 12, 48)
+			| RT3D_KEY_BITS(item.texture, 12, 36) | RT3D_KEY_BITS(item.mesh, 12, 24) | quantized;
+	}
+
+	static bool compareEntries(const renderQueueEntry &a, const renderQueueEntry &b) {
+		return a.key < b.key || (a.key == b.key && a.item < b.item);
+	}
+
+	// program, texture and mesh changes needed to draw the items in the given order
+	static void countChanges(const renderQueue &queue, const bool sorted, GLuint &programs, GLuint &textures, GLuint &meshes) {
+		programs = textures = meshes = 0;
+		const drawItem *last = nullptr;
+		for (size_t i = 0; i < queue.items.size(); i++) {
+			const drawItem &item = queue.items[sorted ? queue.order[i].item : i];
+			if (!last || item.program != last->program)
+				programs++;
+			if (item.texture != 0 && (!last || item.texture != last->texture || item.textureTarget != last->textureTarget))
+				textures++;
+			if (!last || item.mesh != last->mesh)
+				meshes++;
+			last = &item;
+		}
+	}
+
+	void clearRenderQueue(renderQueue &queue) {
+		queue.items.clear();
+		queue.order.clear();
+	}
+
+	void queueDrawItem(renderQueue &queue, const drawItem &item) {
+		renderQueueEntry entry = { makeSortKey(item), (GLuint) queue.items.size() };
+		queue.items.push_back(item);
+		queue.order.push_back(entry);
+	}
+
+	GLuint cullRenderQueue(renderQueue &queue, const GLfloat *projection) {
+		RT3D_PROFILE("cullRenderQueue");
+		static boundingSpheres spheres;
+		static std::vector<GLuint> tested;		// the item behind each sphere
+		static std::vector<GLubyte> visible;
+		clearSpheres(spheres);
+		tested.clear();
+		meshBounds bounds;
+		for (size_t i = 0; i < queue.items.size(); i++) {
+			const drawItem &item = queue.items[i];
+			if (item.pass == RT3D_PASS_SKY)
+				continue;
+			if (item.bounds)
+				addSphere(spheres, *item.bounds, item.modelview);
+			else if (getMeshBounds(item.mesh, bounds))
+				addSphere(spheres, bounds, item.modelview);
+			else
+				continue;
+			tested.push_back((GLuint) i);
+		}
+		frustum view;
+		extractFrustum(projection, view);
+		GLuint kept = cullSpheres(view, spheres, visible);
+		if (kept == tested.size())
+			return 0;
+
+		// the order entries still match the items one for one, as nothing is sorted yet
+		size_t next = 0, out = 0;
+		for (size_t i = 0; i < queue.items.size(); i++) {
+			bool culled = next < tested.size() && tested[next] == i && !visible[next];
+			if (next < tested.size() && tested[next] == i)
+				next++;
+			if (culled)
+				continue;
+			queue.items[out] = queue.items[i];
+			queue.order[out].key = queue.order[i].key;
+			queue.order[out].item = (GLuint) out;
+			out++;
+		}
+		GLuint culled = (GLuint) (queue.items.size() - out);
+		queue.items.resize(out);
+		queue.order.resize(out);
+		return culled;
+	}
+
+	static const char *passNames[RT3D_PASSES] = { "sky pass", "opaque pass", "transparent pass" };
+
+	void drawRenderQueue(renderQueue &queue, renderQueueStats &stats) {
+		RT3D_PROFILE("drawRenderQueue");
+		std::sort(queue.order.begin(), queue.order.end(), compareEntries);
+
+		stats.items = (GLuint) queue.items.size();
+		countChanges(queue, true, stats.programChanges, stats.textureChanges, stats.meshChanges);
+		countChanges(queue, false, stats.unsortedProgramChanges, stats.unsortedTextureChanges, stats.unsortedMeshChanges);
+
+		// items are sorted by pass first, so each pass gets one GPU timer
+		GLuint timedPass = RT3D_PASSES;
+		for (size_t i = 0; i < queue.order.size(); i++) {
+			const drawItem &item = queue.items[queue.order[i].item];
+			if (item.pass < RT3D_PASSES && item.pass != timedPass) {
+				beginGpuTimer(passNames[item.pass]);
+				timedPass = item.pass;
+			}
+			if (item.pass < RT3D_PASSES) {
+				setCullFace(passes[item.pass].cullFace);
+				setDepthMask(passes[item.pass].depthMask);
+			}
+			useProgram(item.program);
+			if (item.texture != 0)
+				bindTexture(0, item.textureTarget, item.texture);
+			if (item.hasMaterial)
+				setMaterialBlock(item.material);
+			setUniformMatrix4fv(item.modelviewLocation, item.modelview);
+			setUniformMatrix4fv(item.modelMatrixLocation, item.modelMatrix);
+			if (item.indexed)
+				drawIndexedMesh(item.mesh, item.count, item.primitive, item.firstIndex);
+			else
+				drawMesh(item.mesh, item.count, item.primitive);
+		}
+		endGpuTimer();
+
+		// leave the default state behind for anything drawn outside the queue
+		setCullFace(GL_BACK);
+		setDepthMask(GL_TRUE);
+	}
+
+}
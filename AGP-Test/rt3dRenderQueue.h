@@ -0,0 +1,75 @@
+// rt3dRenderQueue.h
+// Sorted render queue
+//
+// Instead of drawing immediately, a frame's draws are recorded as drawItems. drawRenderQueue then
+// sorts them by a 64 bit key built from pass, program, texture, mesh and depth and submits them in
+// that order, so each program and texture is bound once per frame rather than once per object.
+// The transparent pass is the exception - it is sorted back to front across the whole pass, as
+// blending needs, and state is only grouped among items at the same depth.
+// Binds go through rt3d's state cache, so anything left unchanged between items costs nothing.
+// cullRenderQueue drops the items outside the view frustum first, using their meshes' bounds.
+#ifndef RT3D_RENDER_QUEUE
+#define RT3D_RENDER_QUEUE
+
+#include "rt3d.h"
+#include <vector>
+
+// Passes are drawn in this order
+#define RT3D_PASS_SKY			0	// no depth writes, front faces culled (drawn from the inside)
+#define RT3D_PASS_OPAQUE		1	// sorted front to back
+#define RT3D_PASS_TRANSPARENT	2	// no depth writes, sorted back to front
+#define RT3D_PASSES				3
+
+namespace rt3d {
+
+	// Everything needed to draw one mesh - fill in and pass to queueDrawItem
+	struct drawItem {
+		GLuint pass;
+		GLuint program;
+		GLint modelviewLocation;	// e.g. from programUniforms, -1 if not needed
+		GLint modelMatrixLocation;
+		GLuint mesh;
+		GLuint count;				// index count, or vertex count if not indexed
+		GLuint firstIndex;			// where the indices start, e.g. an LOD level's - 0 for the whole mesh
+		bool indexed;
+		GLenum primitive;
+		GLenum textureTarget;
+		GLuint texture;				// bound to unit 0, or 0 to leave the current texture alone
+		bool hasMaterial;
+		materialStruct material;	// uploaded to the material block if hasMaterial is set
+		GLfloat modelview[16];
+		GLfloat modelMatrix[16];
+		const meshBounds *bounds;	// in place of the mesh's own bounds (e.g. an MD2 animation's), or null
+	};
+
+	struct renderQueueStats {
+		GLuint items;
+		// changes made in sorted order, and those the same items would need in the order queued
+		GLuint programChanges;
+		GLuint textureChanges;
+		GLuint meshChanges;
+		GLuint unsortedProgramChanges;
+		GLuint unsortedTextureChanges;
+		GLuint unsortedMeshChanges;
+	};
+
+	struct renderQueueEntry {
+		GLuint64 key;
+		GLuint item;
+	};
+
+	struct renderQueue {
+		std::vector<drawItem> items;
+		std::vector<renderQueueEntry> order;
+	};
+
+	void clearRenderQueue(renderQueue &queue);
+	void queueDrawItem(renderQueue &queue, const drawItem &item);
+	// Call after queueing and before drawRenderQueue - projection is the one the modelviews are drawn
+	// with. Sky pass items and meshes without bounds are always kept. Returns the number culled
+	GLuint cullRenderQueue(renderQueue &queue, const GLfloat *projection);
+	void drawRenderQueue(renderQueue &queue, renderQueueStats &stats);
+
+}
+
+#endif
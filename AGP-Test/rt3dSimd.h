@@ -0,0 +1,43 @@
+// rt3dSimd.h
+// Shared support for the SSE2 and AVX kernels
+//
+// RT3D_X86_SIMD is defined, and the intrinsics included, when building for x86 - the kernels
+// only exist then, behind #ifdef RT3D_X86_SIMD, next to a scalar version that always does.
+// Mark AVX kernels with RT3D_TARGET_AVX so they compile without enabling AVX for the whole file.
+// getSimdLevel says which kernels the CPU can run. Pick one with it once, into a function local
+// static const, so the choice is made before any other thread can ask for it.
+#ifndef RT3D_SIMD
+#define RT3D_SIMD
+
+#include "rt3d.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define RT3D_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// GCC and clang only generate AVX code in functions marked for it; MSVC allows the intrinsics anywhere
+#if defined(__GNUC__)
+#define RT3D_TARGET_AVX __attribute__((target("avx")))
+#else
+#define RT3D_TARGET_AVX
+#endif
+
+namespace rt3d {
+
+	enum simdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX };
+
+	// The widest kernels this CPU can run - always SIMD_SCALAR when they weren't built
+	inline simdLevel getSimdLevel() {
+#ifdef RT3D_X86_SIMD
+		if (SDL_HasAVX())
+			return SIMD_AVX;
+		if (SDL_HasSSE2())
+			return SIMD_SSE2;
+#endif
+		return SIMD_SCALAR;
+	}
+
+}
+
+#endif
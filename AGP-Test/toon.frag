@@ -4,23 +4,22 @@
 // Some drivers require the following
 precision highp float;
 
-struct lightStruct
+layout(std140) uniform lightBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
-};
+	vec4 position;
+} light;
 
-struct materialStruct
+layout(std140) uniform materialBlock
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
 	float shininess;
-};
+} material;
 
-uniform lightStruct light;
-uniform materialStruct material;
 
 uniform float attConst;
 uniform float attLinear;
@@ -3,9 +3,22 @@
 // Calculates and passes on V, L, N vectors for use in fragment shader, phong2.frag
 #version 330
 
+// camera, light and material are shared by all programs through uniform buffers
+layout(std140) uniform cameraBlock
+{
+	mat4 projection;
+	vec4 cameraPos;
+};
+
+layout(std140) uniform lightBlock
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 position;
+} light;
+
 uniform mat4 modelview;
-uniform mat4 projection;
-uniform vec4 lightPosition;
 //uniform mat3 normalmatrix;
 
 
@@ -22,7 +35,7 @@ void main(void) {
 
 	// vertex into eye coordinates
 	vec4 vertexPosition = modelview * vec4(in_Position,1.0);
-	float ex_D = distance(vertexPosition,lightPosition);//Distance from light to vertex
+	float ex_D = distance(vertexPosition,light.position);//Distance from light to vertex
 	
 	// Find V - in eye coordinates, eye is at (0,0,0)
 	ex_V = normalize(-vertexPosition).xyz;
@@ -36,7 +49,7 @@ void main(void) {
 	ex_N = normalize(normalmatrix * in_Normal);
 
 	// L - to light source from vertex
-	ex_L = normalize(lightPosition.xyz - vertexPosition.xyz);
+	ex_L = normalize(light.position.xyz - vertexPosition.xyz);
 
     gl_Position = projection * vertexPosition;
 